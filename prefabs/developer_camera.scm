@@ -36,4 +36,7 @@
     (shadow-bias 0.1)
     (shadow-softness 1)
     (shadow-steps 48)
+    (shadow-downsample 2)
+    (temporal-shadows #t)
+    (quality high)
     (enabled #t)))
@@ -0,0 +1,33 @@
+#ifndef GBUFFER_GLSL
+#define GBUFFER_GLSL
+
+/* Normals are stored octahedrally encoded as two snorm16 values packed
+   into a single r32ui texel. */
+
+vec2
+gbuffer_sign_not_zero (vec2 v)
+{
+  return vec2 (v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+uint
+gbuffer_encode_normal (vec3 normal)
+{
+  vec3 n = normal / (abs (normal.x) + abs (normal.y) + abs (normal.z));
+  vec2 encoded = n.z >= 0.0
+                     ? n.xy
+                     : (1.0 - abs (n.yx)) * gbuffer_sign_not_zero (n.xy);
+  return packSnorm2x16 (encoded);
+}
+
+vec3
+gbuffer_decode_normal (uint packed)
+{
+  vec2 encoded = unpackSnorm2x16 (packed);
+  vec3 n = vec3 (encoded, 1.0 - abs (encoded.x) - abs (encoded.y));
+  if (n.z < 0.0)
+    n.xy = (1.0 - abs (n.yx)) * gbuffer_sign_not_zero (n.xy);
+  return normalize (n);
+}
+
+#endif
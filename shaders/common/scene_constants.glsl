@@ -1,23 +1,38 @@
 #ifndef SCENE_CONSTANTS_GLSL
 #define SCENE_CONSTANTS_GLSL
 
-const bool SCENE_HARD_SHADOWS_ENABLED = true;
-const bool SCENE_REFLECTION_ENABLED = false;
-const bool SCENE_FADE_ENABLED = true;
-const bool SCENE_NOISE_ENABLED = true;
-const bool SCENE_NEAR_LIGHT_ENABLED = false;
-const bool SCENE_AO_ENABLED = true;
+/* Quality knobs are specialization constants set per pipeline from
+   raymarch_quality_t; the defaults below match RAYMARCH_QUALITY_HIGH. */
+layout (constant_id = 0) const int SCENE_MAX_STEPS = 128;
+layout (constant_id = 1) const int SCENE_MAX_SHADOW_STEPS = 27;
+layout (constant_id = 2) const int SCENE_AO_SAMPLES = 6;
+layout (constant_id = 3) const int SCENE_REFLECTION_MAX_STEPS = 32;
+layout (constant_id = 4) const bool SCENE_AO_ENABLED = true;
+layout (constant_id = 5) const bool SCENE_HARD_SHADOWS_ENABLED = true;
+layout (constant_id = 6) const bool SCENE_REFLECTION_ENABLED = false;
+layout (constant_id = 7) const bool SCENE_FADE_ENABLED = true;
+layout (constant_id = 8) const bool SCENE_NOISE_ENABLED = true;
+layout (constant_id = 9) const bool SCENE_NEAR_LIGHT_ENABLED = false;
+
+/* Bit N set when shape type N is present in the loaded world. */
+layout (constant_id = 10) const uint SCENE_SHAPE_MASK = 0xffffffffu;
 
 const float SCENE_MAX_DISTANCE = 256.0;
 const float SCENE_RAYMARCH_HIT_EPSILON = 0.02;
 const float SCENE_RAYMARCH_HIT_EPSILON_FAR = 0.04;
 const float SCENE_EPSILON_DISTANCE_START = 0.0;
 const float SCENE_EPSILON_DISTANCE_FULL = SCENE_MAX_DISTANCE;
-const int SCENE_MAX_STEPS = 128;
+
+const uint SCENE_TILE_SIZE = 16u;
+const uint SCENE_TILE_MAX_OBJECTS = 64u;
+const uint SCENE_TILE_NONE = 0xffffffffu;
+const uint SCENE_CONE_BLOCK_SIZE = 8u;
+const uint SCENE_REPROJECT_EMPTY = 0xffffffffu;
+const float SCENE_REPROJECT_MARGIN = 0.25;
+const float SCENE_REPROJECT_MARGIN_SCALE = 0.05;
 
 const float SCENE_SHADOW_EPSILON = 0.03;
 const float SCENE_SHADOW_EPSILON_FAR = 0.05;
-const int SCENE_MAX_SHADOW_STEPS = 27;
 
 const float SCENE_FADE_START_FACTOR = 0.7;
 const float SCENE_FADE_END_FACTOR = 1.0;
@@ -43,8 +58,6 @@ const float SCENE_SHADOW_SOFT_POWER = 0.3;
 const float SCENE_FOV_ASPECT_CORRECTION = 1.0;
 const float SCENE_DEPTH_VALID_MIN = 0.0;
 
-const float SCENE_NORMAL_UNPACK_SCALE = 2.0;
-const float SCENE_NORMAL_UNPACK_BIAS = 1.0;
 const float SCENE_HIT_FLAG_THRESHOLD = 0.5;
 
 const vec3 SCENE_LUMINANCE_WEIGHTS = vec3 (0.299, 0.587, 0.114);
@@ -53,7 +66,6 @@ const float SCENE_SRGB_GAMMA = 1.0 / 3.2;
 const float SCENE_REFLECTION_STRENGTH = 0.45;
 const float SCENE_REFLECTION_FRESNEL_POWER = 4.0;
 const float SCENE_REFLECTION_MAX_DISTANCE = 64.0;
-const int SCENE_REFLECTION_MAX_STEPS = 32;
 const float SCENE_REFLECTION_SURFACE_BIAS = 0.05;
 const float SCENE_REFLECTION_MIN_STEP = 0.05;
 const float SCENE_REFLECTION_DISTANCE_ATTENUATION = 80.0;
@@ -65,7 +77,6 @@ const float SCENE_AO_BIAS = 0.04;
 const float SCENE_AO_STEP = 0.4;
 const float SCENE_AO_DISTANCE = 4.0;
 const float SCENE_AO_SCALE_DECAY = 0.6;
-const int SCENE_AO_SAMPLES = 6;
 
 float
 scene_epsilon_distance_factor (float distance_to_camera)
@@ -0,0 +1,29 @@
+#ifndef SDF_BVH_GLSL
+#define SDF_BVH_GLSL
+
+#include "sdf_bvh_constants.glsl"
+
+struct BVHNode
+{
+  vec3 bounds_min;
+  uint left_first;
+  vec3 bounds_max;
+  uint count;
+};
+
+/* Closest surface found so far at a point. */
+struct SceneSdfSample
+{
+  float distance;
+  vec3 color;
+  float alpha;
+};
+
+float
+sdf_bvh_box_distance (vec3 p, vec3 bounds_min, vec3 bounds_max)
+{
+  vec3 d = max (max (bounds_min - p, p - bounds_max), vec3 (0.0));
+  return length (d);
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef SDF_BVH_CONSTANTS_GLSL
+#define SDF_BVH_CONSTANTS_GLSL
+
+/* Shared with the C build (src/renderer/sdf_bvh.h). A closest-first walk
+   holds at most one sibling per level plus the two children it pushes,
+   so the stack is sized from the build's depth limit. */
+#define SDF_BVH_MAX_DEPTH 30
+#define SDF_BVH_STACK_SIZE (SDF_BVH_MAX_DEPTH + 2)
+
+#endif
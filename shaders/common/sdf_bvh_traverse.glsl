@@ -0,0 +1,79 @@
+#ifndef SDF_BVH_TRAVERSE_GLSL
+#define SDF_BVH_TRAVERSE_GLSL
+
+/* Closest-first BVH walk shared by the raymarch and lighting passes. The
+   includer provides the sdf_objects and sdf_nodes buffers and defines
+   SDF_BVH_VISIT (p, index, result) to evaluate one bounded object. */
+
+/* Leaves below a node cover one contiguous object range, bounded by the
+   leftmost and rightmost leaf. */
+void
+sdf_bvh_visit_subtree (vec3 p, uint node_index, inout SceneSdfSample result)
+{
+  uint first_node = node_index;
+  while (sdf_nodes.nodes[first_node].count == 0u)
+    first_node = sdf_nodes.nodes[first_node].left_first;
+
+  uint last_node = node_index;
+  while (sdf_nodes.nodes[last_node].count == 0u)
+    last_node = sdf_nodes.nodes[last_node].left_first + 1u;
+
+  BVHNode last = sdf_nodes.nodes[last_node];
+  uint end = last.left_first + last.count;
+  for (uint i = sdf_nodes.nodes[first_node].left_first; i < end; i++)
+    SDF_BVH_VISIT (p, i, result);
+}
+
+void
+sdf_bvh_traverse (vec3 p, inout SceneSdfSample result)
+{
+  if (sdf_objects.node_count == 0u)
+    return;
+
+  uint stack[SDF_BVH_STACK_SIZE];
+  uint stack_size = 0u;
+  stack[stack_size++] = 0u;
+
+  while (stack_size > 0u)
+    {
+      uint node_index = stack[--stack_size];
+      BVHNode node = sdf_nodes.nodes[node_index];
+      if (sdf_bvh_box_distance (p, node.bounds_min, node.bounds_max)
+          >= result.distance)
+        continue;
+
+      if (node.count > 0u)
+        {
+          for (uint i = 0u; i < node.count; i++)
+            SDF_BVH_VISIT (p, node.left_first + i, result);
+          continue;
+        }
+
+      /* Deeper than the build allows; evaluate rather than drop. */
+      if (stack_size + 2u > SDF_BVH_STACK_SIZE)
+        {
+          sdf_bvh_visit_subtree (p, node_index, result);
+          continue;
+        }
+
+      BVHNode left = sdf_nodes.nodes[node.left_first];
+      BVHNode right = sdf_nodes.nodes[node.left_first + 1u];
+      float left_dist
+          = sdf_bvh_box_distance (p, left.bounds_min, left.bounds_max);
+      float right_dist
+          = sdf_bvh_box_distance (p, right.bounds_min, right.bounds_max);
+
+      uint near_child = node.left_first;
+      uint far_child = node.left_first + 1u;
+      if (right_dist < left_dist)
+        {
+          near_child = far_child;
+          far_child = node.left_first;
+        }
+
+      stack[stack_size++] = far_child;
+      stack[stack_size++] = near_child;
+    }
+}
+
+#endif
@@ -0,0 +1,349 @@
+#ifndef LIGHTING_CORE_GLSL
+#define LIGHTING_CORE_GLSL
+
+#include "common/gbuffer.glsl"
+#include "common/scene_constants.glsl"
+
+const float MAX_SHADOW_DISTANCE = SCENE_MAX_DISTANCE;
+const int MAX_SHADOW_STEPS = SCENE_MAX_SHADOW_STEPS;
+
+const float RAYMARCH_MAX_DISTANCE = SCENE_MAX_DISTANCE;
+const float FADE_START_FACTOR = SCENE_FADE_START_FACTOR;
+const float FADE_END_FACTOR = SCENE_FADE_END_FACTOR;
+const bool FADE_ENABLED = SCENE_FADE_ENABLED;
+
+const float NOISE_MAX_DISTANCE = SCENE_NOISE_MAX_DISTANCE;
+const float NOISE_MAX_STRENGTH = SCENE_NOISE_MAX_STRENGTH;
+const float NOISE_SHADOW_MIN_BLEND = SCENE_NOISE_SHADOW_MIN_BLEND;
+const float NOISE_SHADOW_MAX_BLEND = SCENE_NOISE_SHADOW_MAX_BLEND;
+const float NOISE_SCALE = SCENE_NOISE_SCALE;
+const bool NOISE_ENABLED = SCENE_NOISE_ENABLED;
+
+const float NEAR_LIGHT_DISTANCE = SCENE_NEAR_LIGHT_DISTANCE;
+const float NEAR_LIGHT_STRENGTH = SCENE_NEAR_LIGHT_STRENGTH;
+const float NEAR_LIGHT_POWER = SCENE_NEAR_LIGHT_POWER;
+const bool NEAR_LIGHT_ENABLED = SCENE_NEAR_LIGHT_ENABLED;
+
+const float WHITE_SURFACE_LUMINANCE = SCENE_WHITE_SURFACE_LUMINANCE;
+const float WHITE_SURFACE_DEPTH_MAX = SCENE_WHITE_SURFACE_DEPTH_MAX;
+const float WHITE_SURFACE_DEPTH_REDUCE = SCENE_WHITE_SURFACE_DEPTH_REDUCE;
+
+const float SHADOW_MIN_HARD = SCENE_SHADOW_MIN_HARD;
+const float SHADOW_SOFT_BLEND = SCENE_SHADOW_SOFT_BLEND;
+const float SHADOW_SOFT_POWER = SCENE_SHADOW_SOFT_POWER;
+const bool HARD_SHADOWS_ENABLED = SCENE_HARD_SHADOWS_ENABLED;
+
+const float FOV_ASPECT_CORRECTION = SCENE_FOV_ASPECT_CORRECTION;
+const float DEPTH_VALID_MIN = SCENE_DEPTH_VALID_MIN;
+const float DEPTH_VALID_MAX = SCENE_MAX_DISTANCE;
+
+const float HIT_FLAG_THRESHOLD = SCENE_HIT_FLAG_THRESHOLD;
+
+const vec3 LUMINANCE_WEIGHTS = SCENE_LUMINANCE_WEIGHTS;
+const float SRGB_GAMMA = SCENE_SRGB_GAMMA;
+
+const bool REFLECTION_ENABLED = SCENE_REFLECTION_ENABLED;
+const float REFLECTION_STRENGTH = SCENE_REFLECTION_STRENGTH;
+const float REFLECTION_FRESNEL_POWER = SCENE_REFLECTION_FRESNEL_POWER;
+const float REFLECTION_MAX_DISTANCE = SCENE_REFLECTION_MAX_DISTANCE;
+const int REFLECTION_MAX_STEPS = SCENE_REFLECTION_MAX_STEPS;
+const float REFLECTION_SURFACE_BIAS = SCENE_REFLECTION_SURFACE_BIAS;
+const float REFLECTION_MIN_STEP = SCENE_REFLECTION_MIN_STEP;
+const float REFLECTION_DISTANCE_ATTENUATION
+    = SCENE_REFLECTION_DISTANCE_ATTENUATION;
+const float REFLECTION_EPSILON_SCALE = SCENE_REFLECTION_EPSILON_SCALE;
+const vec3 REFLECTION_TINT = SCENE_REFLECTION_TINT;
+
+const float AO_STRENGTH = SCENE_AO_STRENGTH;
+const float AO_BIAS = SCENE_AO_BIAS;
+const float AO_STEP = SCENE_AO_STEP;
+const float AO_DISTANCE = SCENE_AO_DISTANCE;
+const float AO_SCALE_DECAY = SCENE_AO_SCALE_DECAY;
+const int AO_SAMPLES = SCENE_AO_SAMPLES;
+const bool AO_ENABLED = SCENE_AO_ENABLED;
+
+layout (binding = 0) uniform LightingUniforms
+{
+  vec4 sun_direction;
+  vec4 sun_color;
+  vec4 camera_position;
+  vec4 camera_direction;
+  vec4 resolution;
+  vec4 background_color;
+  float time;
+  float ambient_strength;
+  float diffuse_strength;
+  float shadow_bias;
+  float shadow_softness;
+  uint shadow_steps;
+  uint shadow_ao_scale;
+  uint shadow_ao_pass;
+  uint temporal_shadows;
+  uint frame_index;
+  uint history_valid;
+  vec4 prev_camera_position;
+  vec4 prev_camera_direction;
+}
+lighting_ubo;
+
+layout (binding = 1, rgba8) uniform readonly image2D input_color;
+layout (binding = 2, r32ui) uniform readonly uimage2D input_normal;
+layout (binding = 3, r32f) uniform readonly image2D input_depth;
+
+struct SDFObject
+{
+  vec4 position;
+  vec4 color;
+  vec4 dimensions;
+  vec4 params;
+};
+
+layout (std430, binding = 5) buffer SDFObjects
+{
+  uint object_count;
+  uint unbounded_count;
+  uint node_count;
+  uint _reserved;
+  SDFObject objects[];
+}
+sdf_objects;
+
+#include "common/sdf_bvh.glsl"
+
+layout (std430, binding = 6) buffer SDFNodes
+{
+  BVHNode nodes[];
+}
+sdf_nodes;
+
+#include "shapes/registry.glsl"
+
+void
+scene_sdf_sample_object (vec3 p, uint index, inout SceneSdfSample result)
+{
+  SDFObject obj = sdf_objects.objects[index];
+  if (obj.dimensions.w < HIT_FLAG_THRESHOLD)
+    return;
+
+  vec3 local_p = p - obj.position.xyz;
+  vec3 dynamic_color;
+  bool has_dynamic_color;
+  float dist
+      = eval_shape (local_p, obj.position, obj.dimensions, obj.params,
+                    lighting_ubo.time, dynamic_color, has_dynamic_color);
+
+  if (dist < result.distance)
+    {
+      result.distance = dist;
+      vec3 base_color = has_dynamic_color ? dynamic_color : obj.color.rgb;
+      if (has_dynamic_color)
+        {
+          base_color *= obj.color.rgb;
+        }
+      result.color = base_color;
+      result.alpha = obj.color.a;
+    }
+}
+
+#define SDF_BVH_VISIT scene_sdf_sample_object
+#include "common/sdf_bvh_traverse.glsl"
+
+SceneSdfSample
+scene_sdf_sample (vec3 p)
+{
+  SceneSdfSample result;
+  result.distance = SCENE_MAX_DISTANCE;
+  result.color = vec3 (0.0);
+  result.alpha = 1.0;
+
+  for (uint i = 0u; i < sdf_objects.unbounded_count; i++)
+    scene_sdf_sample_object (p, i, result);
+
+  sdf_bvh_traverse (p, result);
+  return result;
+}
+
+float
+scene_sdf_shadow (vec3 p)
+{
+  return scene_sdf_sample (p).distance;
+}
+
+bool
+trace_reflection (vec3 origin, vec3 direction, out vec3 color)
+{
+  float travel = 0.0;
+  color = vec3 (0.0);
+  vec3 camera_pos = lighting_ubo.camera_position.xyz;
+
+  for (int step = 0;
+       step < REFLECTION_MAX_STEPS && travel < REFLECTION_MAX_DISTANCE; step++)
+    {
+      vec3 pos = origin + direction * travel;
+      SceneSdfSample hit = scene_sdf_sample (pos);
+
+      float epsilon = scene_raymarch_epsilon (distance (camera_pos, pos))
+                      * REFLECTION_EPSILON_SCALE;
+
+      if (hit.distance < epsilon)
+        {
+          color = hit.color;
+          return true;
+        }
+
+      float remaining = REFLECTION_MAX_DISTANCE - travel;
+      float step_size = min (hit.distance, remaining);
+      step_size = max (step_size, REFLECTION_MIN_STEP);
+      travel += step_size;
+    }
+
+  return false;
+}
+
+/* Evaluates every stride-th AO sample starting at first, scaled so that
+   averaging all phases over time matches the full estimate. */
+float
+ambient_occlusion_interleaved (vec3 position, vec3 normal, int first,
+                               int stride)
+{
+  if (!AO_ENABLED || AO_SAMPLES <= 0 || AO_STRENGTH <= 0.0)
+    return 1.0;
+
+  float occlusion = 0.0;
+  for (int i = first; i < AO_SAMPLES; i += stride)
+    {
+      float step_length = AO_STEP * float (i + 1);
+      if (step_length > AO_DISTANCE)
+        break;
+
+      vec3 sample_pos = position + normal * (step_length + AO_BIAS);
+      SceneSdfSample sample_hit = scene_sdf_sample (sample_pos);
+      float delta = step_length - sample_hit.distance;
+      occlusion += max (delta, 0.0) * pow (AO_SCALE_DECAY, float (i));
+    }
+  occlusion *= float (stride);
+
+  float ao = 1.0 - clamp (occlusion * AO_STRENGTH, 0.0, 1.0);
+  return clamp (ao, 0.0, 1.0);
+}
+
+float
+ambient_occlusion (vec3 position, vec3 normal)
+{
+  return ambient_occlusion_interleaved (position, normal, 0, 1);
+}
+
+float
+shadow_raymarch_from (vec3 p, vec3 light_dir, float start)
+{
+  if (!HARD_SHADOWS_ENABLED)
+    {
+      return 1.0;
+    }
+
+  float t = start;
+  float shadow = 1.0;
+  float min_dist_to_obstacle = MAX_SHADOW_DISTANCE;
+  vec3 camera_pos = lighting_ubo.camera_position.xyz;
+
+  int steps = int (lighting_ubo.shadow_steps);
+  steps = min (steps, MAX_SHADOW_STEPS);
+
+  for (int i = 0; i < steps; i++)
+    {
+      vec3 pos = p + light_dir * t;
+      float dist = scene_sdf_shadow (pos);
+      float shadow_epsilon = scene_shadow_epsilon (distance (camera_pos, pos));
+
+      if (dist < shadow_epsilon)
+        {
+          shadow = 0.0;
+          break;
+        }
+
+      min_dist_to_obstacle = min (min_dist_to_obstacle, dist);
+      t += max (dist, 0.01);
+      if (t >= MAX_SHADOW_DISTANCE)
+        break;
+    }
+
+  if (shadow > 0.0 && min_dist_to_obstacle < MAX_SHADOW_DISTANCE)
+    {
+      float softness = clamp (
+          min_dist_to_obstacle / lighting_ubo.shadow_softness, 0.0, 1.0);
+      shadow = pow (softness, SHADOW_SOFT_POWER);
+    }
+
+  return shadow;
+}
+
+float
+shadow_raymarch (vec3 p, vec3 light_dir)
+{
+  return shadow_raymarch_from (p, light_dir, lighting_ubo.shadow_bias);
+}
+
+void
+lighting_camera_basis (vec3 direction, out vec3 forward, out vec3 right,
+                       out vec3 up)
+{
+  forward = normalize (direction);
+  right = normalize (cross (forward, vec3 (0.0, 1.0, 0.0)));
+  up = cross (right, forward);
+}
+
+vec3
+lighting_view_dir (ivec2 pixel_coords)
+{
+  vec2 uv = (vec2 (pixel_coords.x, lighting_ubo.resolution.y - pixel_coords.y)
+             - lighting_ubo.resolution.xy * 0.5)
+            / lighting_ubo.resolution.y;
+
+  vec3 forward, right, up;
+  lighting_camera_basis (lighting_ubo.camera_direction.xyz, forward, right,
+                         up);
+
+  return normalize (forward + uv.x * right * FOV_ASPECT_CORRECTION
+                    + uv.y * up * FOV_ASPECT_CORRECTION);
+}
+
+/* Inverse of lighting_view_dir for last frame's camera. */
+bool
+lighting_project_previous (vec3 world_pos, out vec2 pixel)
+{
+  vec3 forward, right, up;
+  lighting_camera_basis (lighting_ubo.prev_camera_direction.xyz, forward,
+                         right, up);
+
+  vec3 view = world_pos - lighting_ubo.prev_camera_position.xyz;
+  float z = dot (view, forward);
+  if (z <= 0.0)
+    return false;
+
+  vec2 uv = vec2 (dot (view, right), dot (view, up))
+            / (z * FOV_ASPECT_CORRECTION);
+  pixel = vec2 (uv.x * lighting_ubo.resolution.y
+                    + lighting_ubo.resolution.x * 0.5,
+                lighting_ubo.resolution.y * 0.5
+                    - uv.y * lighting_ubo.resolution.y);
+  return true;
+}
+
+/* Interleaved gradient noise, decorrelated per frame. */
+float
+lighting_frame_noise (ivec2 pixel)
+{
+  vec2 p = vec2 (pixel) + 5.588238 * float (lighting_ubo.frame_index % 64u);
+  return fract (52.9829189 * fract (dot (p, vec2 (0.06711056, 0.00583715))));
+}
+
+/* Full-resolution pixel a reduced-resolution shadow/AO texel is shaded at. */
+ivec2
+lighting_shadow_ao_source (ivec2 texel)
+{
+  int scale = int (lighting_ubo.shadow_ao_scale);
+  ivec2 source = texel * scale + ivec2 (scale / 2);
+  return min (source, ivec2 (lighting_ubo.resolution.xy) - 1);
+}
+
+#endif
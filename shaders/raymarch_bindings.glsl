@@ -0,0 +1,50 @@
+#ifndef RAYMARCH_BINDINGS_GLSL
+#define RAYMARCH_BINDINGS_GLSL
+
+#include "raymarch_uniforms.glsl"
+
+layout (binding = 1, rgba8) uniform writeonly image2D output_color;
+layout (binding = 3, r32ui) uniform writeonly uimage2D output_normal;
+layout (binding = 7, r32f) uniform image2D cone_depth;
+layout (binding = 8, r32ui) uniform readonly uimage2D reproject_depth;
+layout (binding = 9, r32f) uniform writeonly image2D output_depth;
+
+struct SDFObject
+{
+  vec4 position;
+  vec4 color;
+  vec4 dimensions;
+  vec4 params;
+};
+
+layout (std430, binding = 2) buffer SDFObjects
+{
+  uint object_count;
+  uint unbounded_count;
+  uint node_count;
+  uint _reserved;
+  SDFObject objects[];
+}
+sdf_objects;
+
+#include "common/sdf_bvh.glsl"
+
+layout (std430, binding = 4) buffer SDFNodes
+{
+  BVHNode nodes[];
+}
+sdf_nodes;
+
+layout (std430, binding = 5) readonly buffer TileCounts
+{
+  uint counts[];
+}
+tile_counts;
+
+layout (std430, binding = 6) readonly buffer TileObjects
+{
+  uint indices[];
+}
+tile_objects;
+
+#endif
@@ -7,36 +7,61 @@
 const int MAX_STEPS = SCENE_MAX_STEPS;
 const float MAX_DIST = SCENE_MAX_DISTANCE;
 
-float
-scene_sdf (vec3 p, out vec4 color)
-{
-  float min_dist = MAX_DIST;
-  color = vec4 (0.1, 0.1, 0.1, 1.0);
+uint scene_tile_index = SCENE_TILE_NONE;
 
-  for (uint i = 0u; i < ubo.object_count; i++)
-    {
-      SDFObject obj = sdf_objects.objects[i];
-      vec3 local_p = p - obj.position.xyz;
+void
+scene_sdf_object (vec3 p, uint index, inout SceneSdfSample result)
+{
+  SDFObject obj = sdf_objects.objects[index];
+  vec3 local_p = p - obj.position.xyz;
 
-      vec3 dynamic_color;
-      bool has_dynamic_color;
-      float dist
-          = eval_shape (local_p, obj.position, obj.dimensions, obj.params,
-                        ubo.time, dynamic_color, has_dynamic_color);
+  vec3 dynamic_color;
+  bool has_dynamic_color;
+  float dist = eval_shape (local_p, obj.position, obj.dimensions, obj.params,
+                           ubo.time, dynamic_color, has_dynamic_color);
 
-      if (dist < min_dist)
+  if (dist < result.distance)
+    {
+      result.distance = dist;
+      vec3 base_color = has_dynamic_color ? dynamic_color : obj.color.rgb;
+      if (has_dynamic_color)
         {
-          min_dist = dist;
-          vec3 base_color = has_dynamic_color ? dynamic_color : obj.color.rgb;
-          if (has_dynamic_color)
-            {
-              base_color *= obj.color.rgb;
-            }
-          color = vec4 (base_color, obj.color.a);
+          base_color *= obj.color.rgb;
         }
+      result.color = base_color;
+      result.alpha = obj.color.a;
+    }
+}
+
+#define SDF_BVH_VISIT scene_sdf_object
+#include "common/sdf_bvh_traverse.glsl"
+
+float
+scene_sdf (vec3 p, out vec4 color)
+{
+  SceneSdfSample result;
+  result.distance = MAX_DIST;
+  result.color = vec3 (0.1);
+  result.alpha = 1.0;
+
+  for (uint i = 0u; i < sdf_objects.unbounded_count; i++)
+    scene_sdf_object (p, i, result);
+
+  if (scene_tile_index != SCENE_TILE_NONE
+      && tile_counts.counts[scene_tile_index] <= SCENE_TILE_MAX_OBJECTS)
+    {
+      uint tile_count = tile_counts.counts[scene_tile_index];
+      uint base = scene_tile_index * SCENE_TILE_MAX_OBJECTS;
+      for (uint i = 0u; i < tile_count; i++)
+        scene_sdf_object (p, tile_objects.indices[base + i], result);
+    }
+  else
+    {
+      sdf_bvh_traverse (p, result);
     }
 
-  return min_dist;
+  color = vec4 (result.color, result.alpha);
+  return result.distance;
 }
 
 vec3
@@ -54,14 +79,16 @@ calculate_normal (vec3 p, vec3 camera_pos)
 
 struct RaymarchResult
 {
-  vec4 color;
-  vec4 normal_pos;
+  vec3 color;
+  float depth;
+  vec3 normal;
+  bool hit;
 };
 
 RaymarchResult
-raymarch (vec3 ro, vec3 rd, vec3 camera_pos)
+raymarch (vec3 ro, vec3 rd, vec3 camera_pos, float start_depth)
 {
-  float depth = 0.0;
+  float depth = start_depth;
   vec4 color = vec4 (0.0);
   RaymarchResult result;
 
@@ -73,12 +100,10 @@ raymarch (vec3 ro, vec3 rd, vec3 camera_pos)
 
       if (dist < epsilon)
         {
-          vec3 normal = calculate_normal (p, camera_pos);
-          vec3 hit_pos = p;
-
-          result.color = vec4 (color.rgb, depth);
-
-          result.normal_pos = vec4 (normal * 0.5 + 0.5, 1.0);
+          result.color = color.rgb;
+          result.depth = depth;
+          result.normal = calculate_normal (p, camera_pos);
+          result.hit = true;
           return result;
         }
 
@@ -95,9 +120,32 @@ raymarch (vec3 ro, vec3 rd, vec3 camera_pos)
         break;
     }
 
-  result.color = vec4 (ubo.background_color.rgb, MAX_DIST);
-  result.normal_pos = vec4 (0.5, 0.5, 1.0, 0.0);
+  result.color = ubo.background_color.rgb;
+  result.depth = MAX_DIST;
+  result.normal = vec3 (0.0, 0.0, 1.0);
+  result.hit = false;
   return result;
 }
 
+float
+cone_march (vec3 ro, vec3 rd, float cone_slope, float start_depth)
+{
+  vec4 dummy_color;
+  float depth = start_depth;
+
+  for (int i = 0; i < MAX_STEPS; i++)
+    {
+      float radius = depth * cone_slope;
+      float dist = scene_sdf (ro + rd * depth, dummy_color);
+      if (dist <= radius)
+        return max (depth - radius, 0.0);
+
+      depth += dist - radius;
+      if (depth >= MAX_DIST)
+        return MAX_DIST;
+    }
+
+  return max (depth - depth * cone_slope, 0.0);
+}
+
 #endif
@@ -0,0 +1,46 @@
+#ifndef RAYMARCH_UNIFORMS_GLSL
+#define RAYMARCH_UNIFORMS_GLSL
+
+layout (binding = 0) uniform Uniforms
+{
+  mat4 view_matrix;
+  mat4 projection_matrix;
+  vec4 camera_position;
+  vec4 camera_direction;
+  vec4 resolution;
+  vec4 background_color;
+  float time;
+  uint tile_culling;
+  uint cone_prepass;
+  uint history_valid;
+  vec4 prev_camera_position;
+  vec4 prev_camera_direction;
+}
+ubo;
+
+void
+camera_basis (vec3 direction, out vec3 forward, out vec3 right, out vec3 up)
+{
+  forward = normalize (direction);
+  right = normalize (cross (forward, vec3 (0.0, 1.0, 0.0)));
+  up = cross (right, forward);
+}
+
+vec3
+camera_ray (vec2 pixel, vec3 forward, vec3 right, vec3 up)
+{
+  vec2 uv = (vec2 (pixel.x, ubo.resolution.y - pixel.y)
+             - ubo.resolution.xy * 0.5)
+            / ubo.resolution.y;
+  return normalize (forward + uv.x * right + uv.y * up);
+}
+
+vec2
+camera_project (vec3 view)
+{
+  vec2 uv = view.xy / view.z;
+  return vec2 (uv.x * ubo.resolution.y + ubo.resolution.x * 0.5,
+               ubo.resolution.y * 0.5 - uv.y * ubo.resolution.y);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SHAPES_REGISTRY_GLSL
 #define SHAPES_REGISTRY_GLSL
 
+#include "../common/scene_constants.glsl"
 #include "box.glsl"
 #include "citadel.glsl"
 #include "plane.glsl"
@@ -10,6 +11,14 @@
 #include "torus.glsl"
 #include "town.glsl"
 
+/* Folds to false for types absent from SCENE_SHAPE_MASK, so their
+   evaluators are compiled out of the variant. */
+bool
+shape_present (uint t, uint type)
+{
+  return (SCENE_SHAPE_MASK & (1u << type)) != 0u && t == type;
+}
+
 float
 eval_shape (vec3 local_p, vec4 position, vec4 dimensions, vec4 params,
             float time, out vec3 dynamic_color, out bool has_dynamic_color)
@@ -19,17 +28,17 @@ eval_shape (vec3 local_p, vec4 position, vec4 dimensions, vec4 params,
 
   uint t = uint (dimensions.w);
 
-  if (t == 0u)
+  if (shape_present (t, 0u))
     return shape_sphere_eval (local_p, position.w, time);
-  if (t == 1u)
+  if (shape_present (t, 1u))
     return shape_box_eval (local_p, dimensions.xyz, time);
-  if (t == 2u)
+  if (shape_present (t, 2u))
     return shape_torus_eval (local_p, dimensions.xy, time);
-  if (t == 3u)
+  if (shape_present (t, 3u))
     return shape_plane_eval (local_p, dimensions.xyz, dimensions.w, time);
-  if (t == 7u)
+  if (shape_present (t, 7u))
     return shape_terrain_eval (local_p, params.x, time);
-  if (t == 8u)
+  if (shape_present (t, 8u))
     {
       vec3 orbit_color;
       float distance
@@ -39,7 +48,7 @@ eval_shape (vec3 local_p, vec4 position, vec4 dimensions, vec4 params,
       dynamic_color = orbit_color * intensity;
       return distance;
     }
-  if (t == 9u)
+  if (shape_present (t, 9u))
     return shape_town_eval (local_p, params.x, time);
 
   return 1e9;
@@ -1,17 +1,112 @@
 #include "developer_overlay_component.h"
+#include "../core/allocator.h"
 #include "../core/logger.h"
+#include "../core/profiler.h"
 #include "camera_component.h"
 #include "component_registry.h"
 #include "transform_component.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define DEVELOPER_OVERLAY_LINE_START 0.02f
+#define DEVELOPER_OVERLAY_LINE_SPACING 0.035f
+#define DEVELOPER_OVERLAY_DEFAULT_BUDGET_MS (1000.0f / 60.0f)
+
 static result_t
 developer_overlay_add_text (developer_overlay_component_t *overlay,
                             const char *text, float x, float y, float size,
                             vec4_t color);
 
+static float
+overlay_line_y (size_t line)
+{
+  return DEVELOPER_OVERLAY_LINE_START
+         + (float)line * DEVELOPER_OVERLAY_LINE_SPACING;
+}
+
+static int
+compare_floats (const void *a, const void *b)
+{
+  float fa = *(const float *)a;
+  float fb = *(const float *)b;
+  return (fa > fb) - (fa < fb);
+}
+
+static void
+developer_overlay_compute_percentiles (developer_overlay_component_t *overlay)
+{
+  uint32_t count = overlay->frame_time_count;
+  if (count == 0)
+    return;
+
+  float sorted[DEVELOPER_OVERLAY_HISTORY];
+  memcpy (sorted, overlay->frame_times_ms, count * sizeof (float));
+  qsort (sorted, count, sizeof (float), compare_floats);
+
+  overlay->frame_p50_ms = sorted[(count - 1) / 2];
+  overlay->frame_p99_ms = sorted[((count - 1) * 99 + 99) / 100];
+  overlay->frame_max_ms = sorted[count - 1];
+}
+
+static void
+developer_overlay_update_cpu_lines (developer_overlay_component_t *overlay)
+{
+  profiler_zone_stats_t zones[PROFILER_MAX_ZONE_STATS];
+  size_t zone_count = profiler_get_zone_stats (zones, PROFILER_MAX_ZONE_STATS);
+
+  for (size_t i = 0; i < overlay->cpu_text_count; i++)
+    {
+      developer_overlay_text_element_t *element
+          = &overlay->text_elements[overlay->cpu_text_indices[i]];
+
+      if (i >= zone_count)
+        {
+          element->active = false;
+          continue;
+        }
+
+      char zone_text[128];
+      snprintf (zone_text, sizeof (zone_text), "CPU %-28.28s %6.2f MS",
+                zones[i].name, zones[i].avg_ms);
+      developer_overlay_update_text (overlay, overlay->cpu_text_indices[i],
+                                     zone_text);
+      element->active = true;
+    }
+}
+
+static void
+developer_overlay_update_mem_line (developer_overlay_component_t *overlay)
+{
+  char mem_text[256];
+  size_t offset = 0;
+  for (int i = MEM_TAG_GENERAL + 1; i < MEM_TAG_COUNT; i++)
+    {
+      mem_tag_stats_t stats;
+      mem_get_tag_stats ((mem_tag_t)i, &stats);
+
+      int written = snprintf (mem_text + offset, sizeof (mem_text) - offset,
+                              "%s %s %.1f", offset ? "," : "MEM:", stats.name,
+                              (double)stats.live_bytes / (1024.0 * 1024.0));
+      if (written < 0 || (size_t)written >= sizeof (mem_text) - offset)
+        break;
+      offset += (size_t)written;
+    }
+
+  uint64_t allocs = mem_total_alloc_count ();
+  double per_frame
+      = overlay->frame_count
+            ? (double)(allocs - overlay->mem_allocs_at_update)
+                  / overlay->frame_count
+            : 0.0;
+  overlay->mem_allocs_at_update = allocs;
+
+  snprintf (mem_text + offset, sizeof (mem_text) - offset,
+            " MB (%.1f allocs/frame)", per_frame);
+  developer_overlay_update_text (overlay, overlay->mem_text_index, mem_text);
+}
+
 static result_t
 developer_overlay_component_start (ecs_world_t *world, entity_id_t entity,
                                    void *component_data)
@@ -36,11 +131,24 @@ developer_overlay_component_start (ecs_world_t *world, entity_id_t entity,
   overlay->fps_update_interval = 0.5f;
   overlay->fps_text_initialized = false;
   overlay->camera_pos_text_initialized = false;
+  overlay->gpu_text_initialized = false;
+  overlay->frame_stats_text_initialized = false;
+  overlay->mem_text_initialized = false;
+  overlay->mem_allocs_at_update = mem_total_alloc_count ();
+  overlay->cpu_text_count = 0;
+  overlay->frame_time_head = 0;
+  overlay->frame_time_count = 0;
+  overlay->frame_p50_ms = 0.0f;
+  overlay->frame_p99_ms = 0.0f;
+  overlay->frame_max_ms = 0.0f;
+  if (overlay->frame_budget_ms <= 0.0f)
+    overlay->frame_budget_ms = DEVELOPER_OVERLAY_DEFAULT_BUDGET_MS;
   overlay->enabled = true;
 
   vec4_t white = { 1.0f, 1.0f, 1.0f, 1.0f };
-  result_t result = developer_overlay_add_text (overlay, "FPS: --", 0.02f,
-                                                0.02f, 1.0f, white);
+  vec4_t grey = { 0.75f, 0.75f, 0.75f, 1.0f };
+  result_t result = developer_overlay_add_text (
+      overlay, "FPS: --", 0.02f, overlay_line_y (0), 1.0f, white);
 
   if (result.code == RESULT_OK)
     {
@@ -52,6 +160,42 @@ developer_overlay_component_start (ecs_world_t *world, entity_id_t entity,
       LOG_WARNING ("DevOverlay", "Failed to add FPS text: %s", result.message);
     }
 
+  result = developer_overlay_add_text (overlay, "FRAME: --", 0.02f,
+                                       overlay_line_y (1), 1.0f, white);
+  if (result.code == RESULT_OK)
+    {
+      overlay->frame_stats_text_index = overlay->text_element_count - 1;
+      overlay->frame_stats_text_initialized = true;
+    }
+
+  result = developer_overlay_add_text (overlay, "GPU: --", 0.02f,
+                                       overlay_line_y (2), 1.0f, white);
+  if (result.code == RESULT_OK)
+    {
+      overlay->gpu_text_index = overlay->text_element_count - 1;
+      overlay->gpu_text_initialized = true;
+    }
+
+  result = developer_overlay_add_text (overlay, "MEM: --", 0.02f,
+                                       overlay_line_y (3), 1.0f, white);
+  if (result.code == RESULT_OK)
+    {
+      overlay->mem_text_index = overlay->text_element_count - 1;
+      overlay->mem_text_initialized = true;
+    }
+
+  for (size_t i = 0; i < DEVELOPER_OVERLAY_MAX_CPU_LINES; i++)
+    {
+      result = developer_overlay_add_text (overlay, "", 0.02f,
+                                           overlay_line_y (4 + i), 1.0f, grey);
+      if (result.code != RESULT_OK)
+        break;
+
+      overlay->cpu_text_indices[i] = overlay->text_element_count - 1;
+      overlay->text_elements[overlay->cpu_text_indices[i]].active = false;
+      overlay->cpu_text_count++;
+    }
+
   LOG_INFO ("DevOverlay",
             "Developer overlay started for entity %u (camera: %u)", entity,
             camera_entity);
@@ -92,6 +236,13 @@ developer_overlay_component_update (ecs_world_t *world, entity_id_t entity,
   overlay->frame_count++;
   overlay->frame_time_accumulator += time->delta_time;
 
+  overlay->frame_times_ms[overlay->frame_time_head]
+      = time->delta_time * 1000.0f;
+  overlay->frame_time_head
+      = (overlay->frame_time_head + 1) % DEVELOPER_OVERLAY_HISTORY;
+  if (overlay->frame_time_count < DEVELOPER_OVERLAY_HISTORY)
+    overlay->frame_time_count++;
+
   if (overlay->frame_time_accumulator >= overlay->fps_update_interval)
     {
       overlay->current_fps
@@ -111,6 +262,54 @@ developer_overlay_component_update (ecs_world_t *world, entity_id_t entity,
                          * 1000.0f);
         }
 
+      developer_overlay_compute_percentiles (overlay);
+
+      if (overlay->frame_stats_text_initialized)
+        {
+          char frame_text[128];
+          snprintf (frame_text, sizeof (frame_text),
+                    "FRAME P50 %.2f P99 %.2f MAX %.2f MS",
+                    overlay->frame_p50_ms, overlay->frame_p99_ms,
+                    overlay->frame_max_ms);
+          developer_overlay_update_text (
+              overlay, overlay->frame_stats_text_index, frame_text);
+        }
+
+      developer_overlay_update_cpu_lines (overlay);
+
+      profiler_zone_stats_t gpu_zones[PROFILER_MAX_GPU_ZONES];
+      size_t gpu_zone_count
+          = profiler_get_gpu_zone_stats (gpu_zones, PROFILER_MAX_GPU_ZONES);
+      if (overlay->gpu_text_initialized && gpu_zone_count > 0)
+        {
+          char gpu_text[256];
+          size_t offset = 0;
+          double total_ms = 0.0;
+          for (size_t i = 0; i < gpu_zone_count; i++)
+            {
+              const char *name = gpu_zones[i].name;
+              if (strncmp (name, "gpu_", 4) == 0)
+                name += 4;
+              total_ms += gpu_zones[i].avg_ms;
+              int written = snprintf (gpu_text + offset,
+                                      sizeof (gpu_text) - offset,
+                                      "%s %s %.2f", i ? "," : "GPU:", name,
+                                      gpu_zones[i].avg_ms);
+              if (written < 0 || (size_t)written >= sizeof (gpu_text) - offset)
+                break;
+              offset += (size_t)written;
+            }
+          snprintf (gpu_text + offset, sizeof (gpu_text) - offset,
+                    " (%.2f ms)", total_ms);
+          developer_overlay_update_text (overlay, overlay->gpu_text_index,
+                                         gpu_text);
+
+          LOG_DEBUG ("DevOverlay", "%s", gpu_text);
+        }
+
+      if (overlay->mem_text_initialized)
+        developer_overlay_update_mem_line (overlay);
+
       component_id_t transform_id = ecs_get_component_id (world, "transform");
       entity_id_t camera_entity = INVALID_ENTITY;
       camera_component_t *camera = camera_find_active (world, &camera_entity);
@@ -144,31 +343,6 @@ developer_overlay_component_update (ecs_world_t *world, entity_id_t entity,
   return RESULT_SUCCESS;
 }
 
-static result_t
-developer_overlay_component_render (ecs_world_t *world, entity_id_t entity,
-                                    const void *component_data)
-{
-  (void)world;
-  (void)entity;
-
-  const developer_overlay_component_t *overlay
-      = (const developer_overlay_component_t *)component_data;
-
-  if (!overlay->enabled)
-    return RESULT_SUCCESS;
-
-  for (size_t i = 0; i < overlay->text_element_count; i++)
-    {
-      const developer_overlay_text_element_t *element
-          = &overlay->text_elements[i];
-      if (element->active)
-        {
-        }
-    }
-
-  return RESULT_SUCCESS;
-}
-
 static void
 developer_overlay_component_destroy (void *component_data)
 {
@@ -182,8 +356,49 @@ developer_overlay_component_register (ecs_world_t *world)
   REGISTER_COMPONENT (
       world, "developer_overlay", developer_overlay_component_t,
       developer_overlay_component_start, developer_overlay_component_update,
-      developer_overlay_component_render, developer_overlay_component_destroy,
-      "DevOverlay", 64, dependencies);
+      NULL, developer_overlay_component_destroy, "DevOverlay", 64,
+      dependencies);
+}
+
+developer_overlay_component_t *
+developer_overlay_find_active (ecs_world_t *world)
+{
+  if (!world)
+    return NULL;
+
+  component_id_t overlay_id
+      = ecs_get_component_id (world, "developer_overlay");
+  if (overlay_id == INVALID_ENTITY)
+    return NULL;
+
+  component_array_t *array = NULL;
+  for (size_t i = 0; i < world->component_count; i++)
+    {
+      if (world->component_arrays[i].id == overlay_id)
+        {
+          array = &world->component_arrays[i];
+          break;
+        }
+    }
+
+  if (!array)
+    return NULL;
+
+  for (size_t i = 0; i < array->count; i++)
+    {
+      if (!array->active[i])
+        continue;
+
+      developer_overlay_component_t *overlay
+          = (developer_overlay_component_t *)((char *)array->data
+                                              + i
+                                                    * array->descriptor
+                                                          .data_size);
+      if (overlay->enabled)
+        return overlay;
+    }
+
+  return NULL;
 }
 
 static result_t
@@ -5,6 +5,8 @@
 #include "../core/types.h"
 
 #define DEVELOPER_OVERLAY_MAX_TEXT_ELEMENTS 32
+#define DEVELOPER_OVERLAY_HISTORY 240
+#define DEVELOPER_OVERLAY_MAX_CPU_LINES 12
 
 typedef struct
 {
@@ -29,16 +31,36 @@ typedef struct
   float current_fps;
   float fps_update_interval;
 
+  float frame_times_ms[DEVELOPER_OVERLAY_HISTORY];
+  uint32_t frame_time_head;
+  uint32_t frame_time_count;
+  float frame_p50_ms;
+  float frame_p99_ms;
+  float frame_max_ms;
+  float frame_budget_ms;
+
   size_t fps_text_index;
   bool fps_text_initialized;
   size_t camera_pos_text_index;
   bool camera_pos_text_initialized;
+  size_t gpu_text_index;
+  bool gpu_text_initialized;
+  size_t frame_stats_text_index;
+  bool frame_stats_text_initialized;
+  size_t mem_text_index;
+  bool mem_text_initialized;
+  uint64_t mem_allocs_at_update;
+  size_t cpu_text_indices[DEVELOPER_OVERLAY_MAX_CPU_LINES];
+  size_t cpu_text_count;
 
   bool enabled;
 } ALIGN_64 developer_overlay_component_t;
 
 void developer_overlay_component_register (ecs_world_t *world);
 
+developer_overlay_component_t *
+developer_overlay_find_active (ecs_world_t *world);
+
 result_t developer_overlay_update_text (developer_overlay_component_t *overlay,
                                         size_t index, const char *text);
 
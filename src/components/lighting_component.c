@@ -30,6 +30,10 @@ lighting_create_default (void)
   lighting.shadow_bias = 0.01f;
   lighting.shadow_softness = 0.5f;
   lighting.shadow_steps = 32;
+  lighting.shadow_downsample = 2;
+  lighting.temporal_shadows = true;
+
+  lighting.quality = LIGHTING_QUALITY_HIGH;
 
   lighting.enabled = true;
 
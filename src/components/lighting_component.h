@@ -4,6 +4,15 @@
 #include "../core/ecs.h"
 #include "../core/types.h"
 
+/* Shader quality presets, in the same order as raymarch_quality_preset_t. */
+typedef enum
+{
+  LIGHTING_QUALITY_LOW,
+  LIGHTING_QUALITY_MEDIUM,
+  LIGHTING_QUALITY_HIGH,
+  LIGHTING_QUALITY_ULTRA
+} lighting_quality_t;
+
 typedef struct
 {
 
@@ -18,6 +27,10 @@ typedef struct
   float shadow_bias;
   float shadow_softness;
   int shadow_steps;
+  int shadow_downsample;
+  bool temporal_shadows;
+
+  lighting_quality_t quality;
 
   bool enabled;
 } ALIGN_64 lighting_component_t;
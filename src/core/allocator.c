@@ -0,0 +1,256 @@
+#include "allocator.h"
+#include "logger.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_HEADER_MAGIC 0x4d45
+#define MEM_DEFAULT_ALIGNMENT 16
+
+typedef struct
+{
+  uint64_t size;
+  uint32_t offset;
+  uint8_t tag;
+  uint8_t alignment_log2;
+  uint16_t magic;
+} mem_header_t;
+
+_Static_assert (sizeof (mem_header_t) == MEM_DEFAULT_ALIGNMENT,
+                "Allocation header must preserve 16-byte alignment");
+
+typedef struct
+{
+  _Atomic int64_t live_bytes;
+  _Atomic int64_t peak_bytes;
+  _Atomic uint64_t alloc_count;
+  _Atomic uint64_t free_count;
+  _Atomic uint64_t total_bytes;
+} mem_tag_counters_t;
+
+static const char *tag_names[MEM_TAG_COUNT]
+    = { "general", "ecs", "events", "prefabs", "scheme", "world", "renderer" };
+
+static mem_tag_counters_t g_tags[MEM_TAG_COUNT];
+
+static void
+track_alloc (mem_tag_t tag, size_t size)
+{
+  mem_tag_counters_t *counters = &g_tags[tag];
+
+  int64_t live
+      = atomic_fetch_add_explicit (&counters->live_bytes, (int64_t)size,
+                                   memory_order_relaxed)
+        + (int64_t)size;
+  atomic_fetch_add_explicit (&counters->alloc_count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit (&counters->total_bytes, size,
+                             memory_order_relaxed);
+
+  int64_t peak
+      = atomic_load_explicit (&counters->peak_bytes, memory_order_relaxed);
+  while (live > peak
+         && !atomic_compare_exchange_weak_explicit (
+             &counters->peak_bytes, &peak, live, memory_order_relaxed,
+             memory_order_relaxed))
+    {
+    }
+}
+
+static void
+track_free (mem_tag_t tag, size_t size)
+{
+  mem_tag_counters_t *counters = &g_tags[tag];
+
+  atomic_fetch_sub_explicit (&counters->live_bytes, (int64_t)size,
+                             memory_order_relaxed);
+  atomic_fetch_add_explicit (&counters->free_count, 1, memory_order_relaxed);
+}
+
+static mem_header_t *
+header_from_ptr (void *ptr)
+{
+  mem_header_t *header = (mem_header_t *)ptr - 1;
+  if (header->magic != MEM_HEADER_MAGIC || header->tag >= MEM_TAG_COUNT)
+    return NULL;
+
+  return header;
+}
+
+void *
+mem_aligned_alloc (mem_tag_t tag, size_t alignment, size_t size)
+{
+  if (tag >= MEM_TAG_COUNT)
+    tag = MEM_TAG_GENERAL;
+  if (alignment < MEM_DEFAULT_ALIGNMENT)
+    alignment = MEM_DEFAULT_ALIGNMENT;
+  if ((alignment & (alignment - 1)) != 0)
+    return NULL;
+
+  size_t padding = alignment > MEM_DEFAULT_ALIGNMENT ? alignment : 0;
+  char *raw = malloc (sizeof (mem_header_t) + padding + size);
+  if (!raw)
+    return NULL;
+
+  uintptr_t user = (uintptr_t)raw + sizeof (mem_header_t);
+  user = (user + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+  mem_header_t *header = (mem_header_t *)user - 1;
+  header->size = size;
+  header->offset = (uint32_t)(user - (uintptr_t)raw);
+  header->tag = (uint8_t)tag;
+  header->alignment_log2 = (uint8_t)__builtin_ctzll (alignment);
+  header->magic = MEM_HEADER_MAGIC;
+
+  track_alloc (tag, size);
+
+  return (void *)user;
+}
+
+void *
+mem_alloc (mem_tag_t tag, size_t size)
+{
+  return mem_aligned_alloc (tag, MEM_DEFAULT_ALIGNMENT, size);
+}
+
+void *
+mem_calloc (mem_tag_t tag, size_t count, size_t size)
+{
+  if (size != 0 && count > SIZE_MAX / size)
+    return NULL;
+
+  void *ptr = mem_alloc (tag, count * size);
+  if (ptr)
+    memset (ptr, 0, count * size);
+  return ptr;
+}
+
+void *
+mem_realloc (void *ptr, size_t size)
+{
+  if (!ptr)
+    return mem_alloc (MEM_TAG_GENERAL, size);
+
+  mem_header_t *header = header_from_ptr (ptr);
+  if (!header)
+    {
+      LOG_ERROR ("Allocator", "mem_realloc on untracked pointer %p", ptr);
+      return NULL;
+    }
+
+  mem_tag_t tag = (mem_tag_t)header->tag;
+  size_t old_size = header->size;
+  size_t alignment = (size_t)1 << header->alignment_log2;
+
+  /* realloc only keeps malloc's own alignment and the header in front. */
+  if (alignment > MEM_DEFAULT_ALIGNMENT
+      || header->offset != sizeof (mem_header_t))
+    {
+      void *moved = mem_aligned_alloc (tag, alignment, size);
+      if (!moved)
+        return NULL;
+
+      memcpy (moved, ptr, old_size < size ? old_size : size);
+      mem_free (ptr);
+      return moved;
+    }
+
+  mem_header_t *resized = realloc (header, sizeof (mem_header_t) + size);
+  if (!resized)
+    return NULL;
+
+  resized->size = size;
+  track_free (tag, old_size);
+  track_alloc (tag, size);
+
+  return resized + 1;
+}
+
+char *
+mem_strdup (mem_tag_t tag, const char *text)
+{
+  if (!text)
+    return NULL;
+
+  size_t length = strlen (text) + 1;
+  char *copy = mem_alloc (tag, length);
+  if (copy)
+    memcpy (copy, text, length);
+  return copy;
+}
+
+void
+mem_free (void *ptr)
+{
+  if (!ptr)
+    return;
+
+  mem_header_t *header = header_from_ptr (ptr);
+  if (!header)
+    {
+      LOG_ERROR ("Allocator", "mem_free on untracked pointer %p", ptr);
+      return;
+    }
+
+  track_free ((mem_tag_t)header->tag, header->size);
+
+  header->magic = 0;
+  free ((char *)ptr - header->offset);
+}
+
+const char *
+mem_tag_name (mem_tag_t tag)
+{
+  if (tag >= MEM_TAG_COUNT)
+    return "unknown";
+
+  return tag_names[tag];
+}
+
+void
+mem_get_tag_stats (mem_tag_t tag, mem_tag_stats_t *out_stats)
+{
+  if (!out_stats)
+    return;
+
+  memset (out_stats, 0, sizeof (mem_tag_stats_t));
+  if (tag >= MEM_TAG_COUNT)
+    return;
+
+  mem_tag_counters_t *counters = &g_tags[tag];
+  out_stats->name = tag_names[tag];
+  out_stats->live_bytes
+      = atomic_load_explicit (&counters->live_bytes, memory_order_relaxed);
+  out_stats->peak_bytes
+      = atomic_load_explicit (&counters->peak_bytes, memory_order_relaxed);
+  out_stats->alloc_count
+      = atomic_load_explicit (&counters->alloc_count, memory_order_relaxed);
+  out_stats->free_count
+      = atomic_load_explicit (&counters->free_count, memory_order_relaxed);
+  out_stats->total_bytes
+      = atomic_load_explicit (&counters->total_bytes, memory_order_relaxed);
+}
+
+uint64_t
+mem_total_alloc_count (void)
+{
+  uint64_t total = 0;
+  for (int i = 0; i < MEM_TAG_COUNT; i++)
+    {
+      total += atomic_load_explicit (&g_tags[i].alloc_count,
+                                     memory_order_relaxed);
+    }
+  return total;
+}
+
+void *
+mem_scheme_alloc (size_t size)
+{
+  return mem_alloc (MEM_TAG_SCHEME, size);
+}
+
+void
+mem_scheme_free (void *ptr)
+{
+  mem_free (ptr);
+}
@@ -0,0 +1,42 @@
+#ifndef HITE_ALLOCATOR_H
+#define HITE_ALLOCATOR_H
+
+#include "types.h"
+
+typedef enum
+{
+  MEM_TAG_GENERAL = 0,
+  MEM_TAG_ECS,
+  MEM_TAG_EVENTS,
+  MEM_TAG_PREFABS,
+  MEM_TAG_SCHEME,
+  MEM_TAG_WORLD,
+  MEM_TAG_RENDERER,
+  MEM_TAG_COUNT
+} mem_tag_t;
+
+typedef struct
+{
+  const char *name;
+  int64_t live_bytes;
+  int64_t peak_bytes;
+  uint64_t alloc_count;
+  uint64_t free_count;
+  uint64_t total_bytes;
+} mem_tag_stats_t;
+
+void *mem_alloc (mem_tag_t tag, size_t size);
+void *mem_calloc (mem_tag_t tag, size_t count, size_t size);
+void *mem_realloc (void *ptr, size_t size);
+void *mem_aligned_alloc (mem_tag_t tag, size_t alignment, size_t size);
+char *mem_strdup (mem_tag_t tag, const char *text);
+void mem_free (void *ptr);
+
+const char *mem_tag_name (mem_tag_t tag);
+void mem_get_tag_stats (mem_tag_t tag, mem_tag_stats_t *out_stats);
+uint64_t mem_total_alloc_count (void);
+
+void *mem_scheme_alloc (size_t size);
+void mem_scheme_free (void *ptr);
+
+#endif
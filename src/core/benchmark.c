@@ -0,0 +1,145 @@
+#include "benchmark.h"
+#include "logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static result_t
+benchmark_start_step (benchmark_t *bench, render_system_t *render_system)
+{
+  bench->frame = 0;
+  bench->cpu_ms_sum = 0.0;
+  bench->cpu_ms_max = 0.0;
+  bench->gpu_raymarch_sum = 0.0;
+  bench->gpu_lighting_sum = 0.0;
+
+  LOG_INFO ("Benchmark", "Step %u/%u: %u objects", bench->step + 1,
+            bench->step_count, bench->counts[bench->step]);
+
+  return render_system_set_benchmark_objects (render_system,
+                                              bench->counts[bench->step]);
+}
+
+result_t
+benchmark_init (benchmark_t *bench, render_system_t *render_system,
+                const char *counts, uint32_t measure_frames)
+{
+  if (!bench || !render_system || !counts)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Invalid parameters");
+    }
+
+  memset (bench, 0, sizeof (benchmark_t));
+  bench->measure_frames
+      = measure_frames > 0 ? measure_frames : BENCHMARK_DEFAULT_FRAMES;
+
+  const char *cursor = counts;
+  while (*cursor)
+    {
+      char *end = NULL;
+      unsigned long value = strtoul (cursor, &end, 10);
+      if (end == cursor || value == 0 || value > UINT32_MAX
+          || (*end != ',' && *end != '\0'))
+        {
+          return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                               "Invalid benchmark object count list");
+        }
+      if (bench->step_count >= BENCHMARK_MAX_STEPS)
+        {
+          return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                               "Too many benchmark steps");
+        }
+
+      bench->counts[bench->step_count++] = (uint32_t)value;
+      cursor = *end == ',' ? end + 1 : end;
+    }
+
+  if (bench->step_count == 0)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Empty benchmark object count list");
+    }
+
+  bench->active = true;
+
+  return benchmark_start_step (bench, render_system);
+}
+
+bool
+benchmark_frame (benchmark_t *bench, render_system_t *render_system,
+                 float delta_time)
+{
+  if (!bench || !bench->active)
+    return false;
+
+  bench->frame++;
+  if (bench->frame <= BENCHMARK_WARMUP_FRAMES)
+    return true;
+
+  double frame_ms = (double)delta_time * 1000.0;
+  bench->cpu_ms_sum += frame_ms;
+  if (frame_ms > bench->cpu_ms_max)
+    bench->cpu_ms_max = frame_ms;
+  bench->gpu_raymarch_sum += render_system_get_gpu_time_ms (
+      render_system, GPU_TIMER_PASS_RAYMARCH);
+  bench->gpu_lighting_sum += render_system_get_gpu_time_ms (
+      render_system, GPU_TIMER_PASS_LIGHTING);
+
+  uint32_t measured = bench->frame - BENCHMARK_WARMUP_FRAMES;
+  if (measured < bench->measure_frames)
+    return true;
+
+  benchmark_result_t *result = &bench->results[bench->step];
+  result->object_count = bench->counts[bench->step];
+  result->frames = measured;
+  result->cpu_ms_avg = bench->cpu_ms_sum / measured;
+  result->cpu_ms_max = bench->cpu_ms_max;
+  result->gpu_raymarch_ms = bench->gpu_raymarch_sum / measured;
+  result->gpu_lighting_ms = bench->gpu_lighting_sum / measured;
+
+  LOG_INFO ("Benchmark",
+            "%u objects: frame %.2f ms avg / %.2f ms max, GPU raymarch %.2f "
+            "ms, lighting %.2f ms",
+            result->object_count, result->cpu_ms_avg, result->cpu_ms_max,
+            result->gpu_raymarch_ms, result->gpu_lighting_ms);
+
+  bench->step++;
+  if (bench->step >= bench->step_count)
+    {
+      bench->active = false;
+      render_system_set_benchmark_objects (render_system, 0);
+      benchmark_report (bench);
+      return false;
+    }
+
+  result_t step_result = benchmark_start_step (bench, render_system);
+  if (step_result.code != RESULT_OK)
+    {
+      LOG_ERROR ("Benchmark", "Failed to start step: %s",
+                 step_result.message);
+      bench->active = false;
+      benchmark_report (bench);
+      return false;
+    }
+
+  return true;
+}
+
+void
+benchmark_report (const benchmark_t *bench)
+{
+  if (!bench)
+    return;
+
+  LOG_INFO ("Benchmark", "%10s %8s %12s %12s %12s %12s", "objects", "frames",
+            "frame avg", "frame max", "gpu march", "gpu light");
+  for (uint32_t i = 0; i < bench->step_count && i < bench->step; i++)
+    {
+      const benchmark_result_t *result = &bench->results[i];
+      LOG_INFO ("Benchmark", "%10u %8u %9.2f ms %9.2f ms %9.2f ms %9.2f ms",
+                result->object_count, result->frames, result->cpu_ms_avg,
+                result->cpu_ms_max, result->gpu_raymarch_ms,
+                result->gpu_lighting_ms);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef HITE_BENCHMARK_H
+#define HITE_BENCHMARK_H
+
+#include "../renderer/render_system.h"
+#include "types.h"
+
+#define BENCHMARK_MAX_STEPS 8
+#define BENCHMARK_DEFAULT_COUNTS "1000,10000,100000"
+#define BENCHMARK_DEFAULT_FRAMES 240
+#define BENCHMARK_WARMUP_FRAMES 30
+
+typedef struct
+{
+  uint32_t object_count;
+  uint32_t frames;
+  double cpu_ms_avg;
+  double cpu_ms_max;
+  double gpu_raymarch_ms;
+  double gpu_lighting_ms;
+} benchmark_result_t;
+
+typedef struct
+{
+  bool active;
+
+  uint32_t counts[BENCHMARK_MAX_STEPS];
+  uint32_t step_count;
+  uint32_t step;
+
+  uint32_t frame;
+  uint32_t measure_frames;
+
+  double cpu_ms_sum;
+  double cpu_ms_max;
+  double gpu_raymarch_sum;
+  double gpu_lighting_sum;
+
+  benchmark_result_t results[BENCHMARK_MAX_STEPS];
+} benchmark_t;
+
+result_t benchmark_init (benchmark_t *bench, render_system_t *render_system,
+                         const char *counts, uint32_t measure_frames);
+
+bool benchmark_frame (benchmark_t *bench, render_system_t *render_system,
+                      float delta_time);
+
+void benchmark_report (const benchmark_t *bench);
+
+#endif
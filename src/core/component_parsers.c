@@ -527,6 +527,7 @@ parse_developer_overlay_component (
           PARSE_BOOL ("enabled", out_component->enabled)
           else PARSE_FLOAT ("fps-update-interval",
                             out_component->fps_update_interval)
+          else PARSE_FLOAT ("frame-budget-ms", out_component->frame_budget_ms)
         }
       current = scheme_cdr_wrapper (state, current);
     }
@@ -589,6 +590,31 @@ apply_component_override (scheme_state_t *state, const char *component_name,
     }
 }
 
+static void
+parse_lighting_quality (scheme_state_t *state, pointer sexp,
+                        lighting_quality_t *out_quality)
+{
+  static const char *names[] = { "low", "medium", "high", "ultra" };
+
+  const char *name = NULL;
+  if (scheme_is_string_wrapper (state, sexp))
+    name = scheme_string_wrapper (state, sexp);
+  else if (scheme_is_symbol_wrapper (state, sexp))
+    name = scheme_symbol_name_wrapper (state, sexp);
+
+  for (int i = 0; name && i < (int)(sizeof (names) / sizeof (names[0])); i++)
+    {
+      if (strcmp (name, names[i]) == 0)
+        {
+          *out_quality = (lighting_quality_t)i;
+          return;
+        }
+    }
+
+  LOG_WARNING ("Component Parser", "Unknown lighting quality '%s'",
+               name ? name : "?");
+}
+
 result_t
 parse_lighting_component (scheme_state_t *state, pointer sexp,
                           lighting_component_t *out_component)
@@ -636,6 +662,11 @@ parse_lighting_component (scheme_state_t *state, pointer sexp,
               if (scheme_is_pair_wrapper (state, value))
                 scheme_parse_vec3 (state, value, &out_component->sun_color);
             }
+          else if (strcmp (field_name, "quality") == 0)
+            {
+              pointer value = scheme_cadr_wrapper (state, field);
+              parse_lighting_quality (state, value, &out_component->quality);
+            }
           else
             PARSE_FLOAT ("ambient-strength", out_component->ambient_strength)
           else PARSE_FLOAT ("diffuse-strength", out_component->diffuse_strength) else PARSE_FLOAT (
@@ -645,7 +676,7 @@ parse_lighting_component (scheme_state_t *state, pointer sexp,
                                                    out_component
                                                        ->shadow_softness) else PARSE_INT ("shadow-steps",
                                                                                           out_component
-                                                                                              ->shadow_steps) else PARSE_BOOL ("enabled",
+                                                                                              ->shadow_steps) else PARSE_INT ("shadow-downsample", out_component->shadow_downsample) else PARSE_BOOL ("temporal-shadows", out_component->temporal_shadows) else PARSE_BOOL ("enabled",
                                                                                                                                out_component
                                                                                                                                    ->enabled)
         }
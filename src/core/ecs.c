@@ -1,36 +1,32 @@
 #include "ecs.h"
+#include "allocator.h"
+#include "metrics.h"
+#include "profiler.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define INITIAL_COMPONENT_CAPACITY 1024
 
-static void *
-aligned_alloc_wrapper (size_t alignment, size_t size)
-{
-  void *ptr = NULL;
-  if (posix_memalign (&ptr, alignment, size) != 0)
-    {
-      return NULL;
-    }
-  return ptr;
-}
-
 ecs_world_t *
 ecs_world_create (void)
 {
-  ecs_world_t *world = calloc (1, sizeof (ecs_world_t));
+  ecs_world_t *world = mem_calloc (MEM_TAG_ECS, 1, sizeof (ecs_world_t));
   if (!world)
     return NULL;
 
-  world->entity_versions = calloc (MAX_ENTITIES, sizeof (entity_id_t));
-  world->free_entities = calloc (MAX_ENTITIES, sizeof (entity_id_t));
+  world->entity_versions
+      = mem_calloc (MEM_TAG_ECS, MAX_ENTITIES, sizeof (entity_id_t));
+  world->free_entities
+      = mem_calloc (MEM_TAG_ECS, MAX_ENTITIES, sizeof (entity_id_t));
   world->component_arrays
-      = calloc (MAX_COMPONENT_TYPES, sizeof (component_array_t));
+      = mem_calloc (MEM_TAG_ECS, MAX_COMPONENT_TYPES,
+                    sizeof (component_array_t));
   world->component_lookup.names
-      = calloc (MAX_COMPONENT_TYPES, sizeof (char *));
+      = mem_calloc (MEM_TAG_ECS, MAX_COMPONENT_TYPES, sizeof (char *));
   world->component_lookup.ids
-      = calloc (MAX_COMPONENT_TYPES, sizeof (component_id_t));
+      = mem_calloc (MEM_TAG_ECS, MAX_COMPONENT_TYPES, sizeof (component_id_t));
 
   if (!world->entity_versions || !world->free_entities
       || !world->component_arrays || !world->component_lookup.names)
@@ -63,17 +59,35 @@ ecs_world_destroy (ecs_world_t *world)
               array->descriptor.destroy (data);
             }
         }
-      free (array->data);
-      free (array->entities);
-      free (array->active);
+      metrics_gauge_add (METRIC_GAUGE_ECS_COMPONENT_CAPACITY,
+                         -(int64_t)array->capacity);
+      metrics_gauge_add (
+          METRIC_GAUGE_ECS_COMPONENT_BYTES,
+          -(int64_t)(array->capacity * array->descriptor.data_size));
+      for (size_t j = 0; j < array->count; j++)
+        {
+          if (array->active[j])
+            metrics_gauge_add (METRIC_GAUGE_ECS_COMPONENTS_ACTIVE, -1);
+        }
+
+      mem_free (array->data);
+      mem_free (array->entities);
+      mem_free (array->active);
+    }
+
+  if (world->next_entity_id > 0)
+    {
+      metrics_gauge_add (METRIC_GAUGE_ECS_ENTITIES_ALIVE,
+                         -(int64_t)(world->next_entity_id - 1
+                                    - world->free_entity_count));
     }
 
-  free (world->component_arrays);
-  free (world->entity_versions);
-  free (world->free_entities);
-  free (world->component_lookup.names);
-  free (world->component_lookup.ids);
-  free (world);
+  mem_free (world->component_arrays);
+  mem_free (world->entity_versions);
+  mem_free (world->free_entities);
+  mem_free (world->component_lookup.names);
+  mem_free (world->component_lookup.ids);
+  mem_free (world);
 }
 
 result_t
@@ -110,11 +124,17 @@ ecs_register_component (ecs_world_t *world,
   array->id = id;
   array->capacity = INITIAL_COMPONENT_CAPACITY;
 
+  metrics_gauge_add (METRIC_GAUGE_ECS_COMPONENT_CAPACITY,
+                     (int64_t)array->capacity);
+  metrics_gauge_add (METRIC_GAUGE_ECS_COMPONENT_BYTES,
+                     (int64_t)(array->capacity * descriptor->data_size));
+
   size_t alignment = descriptor->alignment > 0 ? descriptor->alignment : 16;
-  array->data = aligned_alloc_wrapper (alignment, descriptor->data_size
-                                                      * array->capacity);
-  array->entities = calloc (array->capacity, sizeof (entity_id_t));
-  array->active = calloc (array->capacity, sizeof (bool));
+  array->data = mem_aligned_alloc (MEM_TAG_ECS, alignment,
+                                   descriptor->data_size * array->capacity);
+  array->entities
+      = mem_calloc (MEM_TAG_ECS, array->capacity, sizeof (entity_id_t));
+  array->active = mem_calloc (MEM_TAG_ECS, array->capacity, sizeof (bool));
 
   if (!array->data || !array->entities || !array->active)
     {
@@ -166,6 +186,10 @@ ecs_entity_create (ecs_world_t *world)
     }
 
   world->entity_versions[id]++;
+
+  metrics_counter_add (METRIC_COUNTER_ECS_ENTITIES_CREATED, 1);
+  metrics_gauge_add (METRIC_GAUGE_ECS_ENTITIES_ALIVE, 1);
+
   return id;
 }
 
@@ -220,22 +244,31 @@ ecs_add_component (ecs_world_t *world, entity_id_t entity,
       size_t alignment
           = array->descriptor.alignment > 0 ? array->descriptor.alignment : 16;
 
-      void *new_data = aligned_alloc_wrapper (
-          alignment, array->descriptor.data_size * new_capacity);
+      void *new_data
+          = mem_aligned_alloc (MEM_TAG_ECS, alignment,
+                               array->descriptor.data_size * new_capacity);
       entity_id_t *new_entities
-          = realloc (array->entities, new_capacity * sizeof (entity_id_t));
-      bool *new_active = realloc (array->active, new_capacity * sizeof (bool));
+          = mem_realloc (array->entities, new_capacity * sizeof (entity_id_t));
+      bool *new_active
+          = mem_realloc (array->active, new_capacity * sizeof (bool));
 
       if (!new_data || !new_entities || !new_active)
         {
-          free (new_data);
+          mem_free (new_data);
           return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
                                "Failed to grow component array");
         }
 
       memcpy (new_data, array->data,
               array->descriptor.data_size * array->count);
-      free (array->data);
+      mem_free (array->data);
+
+      metrics_counter_add (METRIC_COUNTER_ECS_ARRAY_GROWTHS, 1);
+      metrics_gauge_add (METRIC_GAUGE_ECS_COMPONENT_CAPACITY,
+                         (int64_t)(new_capacity - array->capacity));
+      metrics_gauge_add (METRIC_GAUGE_ECS_COMPONENT_BYTES,
+                         (int64_t)((new_capacity - array->capacity)
+                                   * array->descriptor.data_size));
 
       array->data = new_data;
       array->entities = new_entities;
@@ -269,6 +302,8 @@ ecs_add_component (ecs_world_t *world, entity_id_t entity,
         }
     }
 
+  metrics_gauge_add (METRIC_GAUGE_ECS_COMPONENTS_ACTIVE, 1);
+
   return RESULT_SUCCESS;
 }
 
@@ -296,6 +331,7 @@ ecs_remove_component (ecs_world_t *world, entity_id_t entity,
             }
 
           array->active[i] = false;
+          metrics_gauge_add (METRIC_GAUGE_ECS_COMPONENTS_ACTIVE, -1);
           return RESULT_SUCCESS;
         }
     }
@@ -383,6 +419,8 @@ ecs_system_update (ecs_world_t *world)
       if (!array->descriptor.update)
         continue;
 
+      PROFILE_BEGIN (array->descriptor.name);
+
       for (size_t j = 0; j < array->count; j++)
         {
           if (!array->active[j])
@@ -392,8 +430,13 @@ ecs_system_update (ecs_world_t *world)
           result_t result = array->descriptor.update (
               world, array->entities[j], data, &world->time);
           if (result.code != RESULT_OK)
-            return result;
+            {
+              PROFILE_END ();
+              return result;
+            }
         }
+
+      PROFILE_END ();
     }
 
   return RESULT_SUCCESS;
@@ -1,4 +1,7 @@
 #include "events.h"
+#include "allocator.h"
+#include "metrics.h"
+
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -6,12 +9,16 @@
 event_system_t *
 event_system_create (void)
 {
-  event_system_t *system = calloc (1, sizeof (event_system_t));
+  event_system_t *system
+      = mem_calloc (MEM_TAG_EVENTS, 1, sizeof (event_system_t));
   if (!system)
     return NULL;
 
-  system->queue = calloc (EVENT_QUEUE_SIZE, sizeof (event_t));
-  system->listeners = calloc (MAX_EVENT_LISTENERS, sizeof (event_listener_t));
+  system->queue
+      = mem_calloc (MEM_TAG_EVENTS, EVENT_QUEUE_SIZE, sizeof (event_t));
+  system->listeners
+      = mem_calloc (MEM_TAG_EVENTS, MAX_EVENT_LISTENERS,
+                    sizeof (event_listener_t));
   system->listener_capacity = MAX_EVENT_LISTENERS;
 
   if (!system->queue || !system->listeners)
@@ -28,9 +35,9 @@ event_system_destroy (event_system_t *system)
 {
   if (!system)
     return;
-  free (system->queue);
-  free (system->listeners);
-  free (system);
+  mem_free (system->queue);
+  mem_free (system->listeners);
+  mem_free (system);
 }
 
 result_t
@@ -44,6 +51,7 @@ event_emit (event_system_t *system, const event_t *event)
 
   if (system->queue_count >= EVENT_QUEUE_SIZE)
     {
+      metrics_counter_add (METRIC_COUNTER_EVENTS_DROPPED, 1);
       return RESULT_ERROR (RESULT_ERROR_ALLOCATION, "Event queue overflow");
     }
 
@@ -53,6 +61,12 @@ event_emit (event_system_t *system, const event_t *event)
 
   system->queue_count++;
 
+  metrics_counter_add (METRIC_COUNTER_EVENTS_EMITTED, 1);
+  metrics_gauge_set (METRIC_GAUGE_EVENT_QUEUE_DEPTH,
+                     (int64_t)system->queue_count);
+  metrics_gauge_max (METRIC_GAUGE_EVENT_QUEUE_PEAK,
+                     (int64_t)system->queue_count);
+
   return RESULT_SUCCESS;
 }
 
@@ -65,6 +79,8 @@ event_broadcast (event_system_t *system, const event_t *event)
                            "Invalid parameters");
     }
 
+  metrics_counter_add (METRIC_COUNTER_EVENTS_BROADCAST, 1);
+
   event_t broadcast_event = *event;
   broadcast_event.entity = INVALID_ENTITY;
   broadcast_event.timestamp = (double)clock () / CLOCKS_PER_SEC;
@@ -90,6 +106,8 @@ event_process (event_system_t *system)
   if (!system)
     return;
 
+  size_t processed = 0;
+
   while (system->queue_count > 0)
     {
 
@@ -115,7 +133,12 @@ event_process (event_system_t *system)
 
       system->queue_head = (system->queue_head + 1) % EVENT_QUEUE_SIZE;
       system->queue_count--;
+      processed++;
     }
+
+  metrics_counter_add (METRIC_COUNTER_EVENTS_DISPATCHED, processed);
+  metrics_histogram_record (METRIC_HISTOGRAM_EVENTS_PER_FRAME, processed);
+  metrics_gauge_set (METRIC_GAUGE_EVENT_QUEUE_DEPTH, 0);
 }
 
 listener_id_t
@@ -8,7 +8,9 @@
 #include "../components/shape_component.h"
 #include "../components/transform_component.h"
 #include "logger.h"
+#include "metrics.h"
 #include "prefab.h"
+#include "profiler.h"
 #include "world_loader.h"
 
 #include <math.h>
@@ -17,6 +19,8 @@
 #define DEFAULT_WINDOW_WIDTH 1280
 #define DEFAULT_WINDOW_HEIGHT 720
 #define DEFAULT_WINDOW_TITLE "HitE"
+#define HEADLESS_DEFAULT_FRAMES 1
+#define HEADLESS_FRAME_TIME (1.0 / 60.0)
 
 engine_config_t
 engine_config_default (void)
@@ -29,6 +33,11 @@ engine_config_default (void)
   config.initial_world_path = "worlds/example.scm";
   config.prefabs_directory = "prefabs";
   config.worlds_directory = "worlds";
+  config.metrics_path = "hite_metrics.jsonl";
+  config.metrics_interval = METRICS_DEFAULT_INTERVAL;
+  config.benchmark_objects = NULL;
+  config.benchmark_frames = BENCHMARK_DEFAULT_FRAMES;
+  config.target_frame_ms = DYNAMIC_RESOLUTION_DEFAULT_TARGET_MS;
   return config;
 }
 
@@ -41,34 +50,57 @@ engine_init (engine_state_t *state, const engine_config_t *config)
   state->window_height = config->window_height;
   state->window_title = config->window_title;
   state->enable_validation = config->enable_validation;
+  state->headless = config->headless;
+  state->frame_limit = config->frame_limit;
 
-  if (!glfwInit ())
+  /* Without a window nothing else would end the main loop. */
+  if (state->headless && state->frame_limit == 0
+      && !config->benchmark_objects)
+    state->frame_limit = HEADLESS_DEFAULT_FRAMES;
+
+  profiler_init ();
+
+  result_t metrics_result
+      = metrics_init (config->metrics_path, config->metrics_interval);
+  if (metrics_result.code != RESULT_OK)
     {
-      return RESULT_ERROR (RESULT_ERROR_VULKAN, "Failed to initialize GLFW");
+      LOG_WARNING ("Engine", "Metrics disabled: %s", metrics_result.message);
     }
 
-  glfwInitHint (GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
+  if (!state->headless)
+    {
+      if (!glfwInit ())
+        {
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to initialize GLFW");
+        }
 
-  glfwWindowHint (GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint (GLFW_RESIZABLE, GLFW_FALSE);
+      glfwInitHint (GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
 
-  state->window = glfwCreateWindow (state->window_width, state->window_height,
-                                    state->window_title, NULL, NULL);
-  if (!state->window)
-    {
-      glfwTerminate ();
-      return RESULT_ERROR (RESULT_ERROR_VULKAN, "Failed to create window");
-    }
+      glfwWindowHint (GLFW_CLIENT_API, GLFW_NO_API);
+      glfwWindowHint (GLFW_RESIZABLE, GLFW_FALSE);
 
-  glfwSetWindowUserPointer (state->window, state);
-  glfwSetInputMode (state->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+      state->window
+          = glfwCreateWindow (state->window_width, state->window_height,
+                              state->window_title, NULL, NULL);
+      if (!state->window)
+        {
+          glfwTerminate ();
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to create window");
+        }
+
+      glfwSetWindowUserPointer (state->window, state);
+      glfwSetInputMode (state->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
   state->first_mouse = true;
   state->camera_yaw = -M_PI;
   state->camera_pitch = -0.3f;
   memset (state->keys, 0, sizeof (state->keys));
 
-  result_t result = vulkan_init (&state->vk_context, state->enable_validation);
+  result_t result = vulkan_init (&state->vk_context, state->enable_validation,
+                                 state->headless);
   if (result.code != RESULT_OK)
     return result;
 
@@ -81,10 +113,39 @@ engine_init (engine_state_t *state, const engine_config_t *config)
   if (result.code != RESULT_OK)
     return result;
 
-  result = input_handler_init (&state->input_handler, state->event_system,
-                               state->window);
-  if (result.code != RESULT_OK)
-    return result;
+  /* Benchmarks and headless captures need a fixed workload, so never
+     rescale under them. */
+  render_system_set_frame_budget (&state->render_system,
+                                  config->benchmark_objects || state->headless
+                                      ? 0.0f
+                                      : config->target_frame_ms);
+  render_system_set_shader_hot_reload (&state->render_system,
+                                       config->shader_hot_reload);
+
+  if (config->capture_path)
+    {
+      result = render_system_set_capture (&state->render_system,
+                                          config->capture_path);
+      if (result.code != RESULT_OK)
+        return result;
+    }
+
+  if (!state->headless)
+    {
+      result = input_handler_init (&state->input_handler,
+                                   state->event_system, state->window);
+      if (result.code != RESULT_OK)
+        return result;
+    }
+
+  if (config->benchmark_objects)
+    {
+      result = benchmark_init (&state->benchmark, &state->render_system,
+                               config->benchmark_objects,
+                               config->benchmark_frames);
+      if (result.code != RESULT_OK)
+        return result;
+    }
 
   LOG_INFO ("Engine", "Initialized successfully");
 
@@ -106,7 +167,11 @@ engine_cleanup (engine_state_t *state)
     {
       glfwDestroyWindow (state->window);
     }
-  glfwTerminate ();
+  if (!state->headless)
+    glfwTerminate ();
+
+  metrics_shutdown ();
+  profiler_shutdown ();
 
   LOG_INFO ("Engine", "Cleaned up");
 }
@@ -140,9 +205,11 @@ engine_load_world (engine_state_t *state, const engine_config_t *config,
 
   ecs_world_set_event_system (state->world_manager->active_world,
                               (struct event_system_t *)state->event_system);
+  /* Headless runs never initialize the input handler. */
   ecs_world_set_input_handler (
       state->world_manager->active_world,
-      (struct input_handler_t *)&state->input_handler);
+      state->headless ? NULL
+                      : (struct input_handler_t *)&state->input_handler);
 
   LOG_INFO ("Engine", "Registering components...");
   register_all_components (state->world_manager->active_world);
@@ -210,36 +277,77 @@ update_camera_from_component (engine_state_t *state)
 void
 engine_run (engine_state_t *state)
 {
-  state->last_time = glfwGetTime ();
+  state->last_time = state->headless ? 0.0 : glfwGetTime ();
 
   LOG_INFO ("Engine", "Starting main loop...");
 
-  while (state->running && !glfwWindowShouldClose (state->window))
+  while (state->running
+         && (state->headless || !glfwWindowShouldClose (state->window)))
     {
-      double current_time = glfwGetTime ();
+      double current_time
+          = state->headless ? (double)(state->frame_count + 1)
+                                  * HEADLESS_FRAME_TIME
+                            : glfwGetTime ();
       float delta_time = (float)(current_time - state->last_time);
       state->last_time = current_time;
 
-      glfwPollEvents ();
+      metrics_histogram_record (METRIC_HISTOGRAM_FRAME_TIME_US,
+                                (uint64_t)(delta_time * 1.0e6f));
+
+      PROFILE_BEGIN ("frame");
+
+      if (!state->headless)
+        {
+          PROFILE_BEGIN ("glfwPollEvents");
+          glfwPollEvents ();
+          PROFILE_END ();
+        }
+
+      PROFILE_BEGIN ("event_process");
       event_process (state->event_system);
+      PROFILE_END ();
 
       if (state->world_manager->active_world)
         {
+          PROFILE_BEGIN ("world_update");
           world_update (state->world_manager, delta_time);
+          PROFILE_END ();
 
           update_camera_from_component (state);
 
+          PROFILE_BEGIN ("render_system_collect_shapes");
           render_system_collect_shapes (&state->render_system,
                                         state->world_manager->active_world);
+          PROFILE_END ();
         }
 
+      PROFILE_BEGIN ("render_system_render_frame");
       render_system_render_frame (&state->render_system,
                                   state->world_manager->active_world,
                                   (float)current_time);
+      PROFILE_END ();
 
       if (state->world_manager->active_world)
         {
+          PROFILE_BEGIN ("ecs_system_render");
           ecs_system_render (state->world_manager->active_world);
+          PROFILE_END ();
+        }
+
+      PROFILE_END ();
+      PROFILE_FRAME_MARK ();
+
+      if (state->benchmark.active
+          && !benchmark_frame (&state->benchmark, &state->render_system,
+                               delta_time))
+        {
+          state->running = false;
         }
+
+      state->frame_count++;
+      if (state->frame_limit && state->frame_count >= state->frame_limit)
+        state->running = false;
+
+      metrics_tick (current_time);
     }
 }
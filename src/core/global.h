@@ -3,6 +3,7 @@
 
 #include "../renderer/render_system.h"
 #include "../renderer/vulkan_core.h"
+#include "benchmark.h"
 #include "events.h"
 #include "input_handler.h"
 #include "types.h"
@@ -20,6 +21,7 @@ typedef struct
   world_manager_t *world_manager;
   event_system_t *event_system;
   input_handler_t input_handler;
+  benchmark_t benchmark;
 
   bool running;
   double last_time;
@@ -35,6 +37,10 @@ typedef struct
   int window_height;
   const char *window_title;
   bool enable_validation;
+
+  bool headless;
+  uint32_t frame_limit;
+  uint64_t frame_count;
 } engine_state_t;
 
 #include "prefab.h"
@@ -48,6 +54,18 @@ typedef struct
   const char *initial_world_path;
   const char *prefabs_directory;
   const char *worlds_directory;
+  const char *metrics_path;
+  double metrics_interval;
+  const char *benchmark_objects;
+  uint32_t benchmark_frames;
+  float target_frame_ms;
+  bool shader_hot_reload;
+  /* No window or swapchain; time advances by a fixed step per frame so
+     runs are reproducible. */
+  bool headless;
+  /* Stops after this many frames; 0 runs until the window closes. */
+  uint32_t frame_limit;
+  const char *capture_path;
 } engine_config_t;
 
 engine_config_t engine_config_default (void);
@@ -1,6 +1,7 @@
 #include "input_handler.h"
 #include "global.h"
 #include "logger.h"
+#include "profiler.h"
 
 #include <GLFW/glfw3.h>
 
@@ -20,6 +21,12 @@ key_callback (GLFWwindow *window, int key, int scancode, int action, int mods)
       return;
     }
 
+  if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+    {
+      profiler_request_dump ();
+      return;
+    }
+
   if (!state->event_system)
     return;
 
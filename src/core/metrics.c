@@ -0,0 +1,330 @@
+#include "metrics.h"
+#include "allocator.h"
+#include "logger.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+  _Atomic uint64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+  _Atomic uint64_t count;
+  _Atomic uint64_t sum;
+  _Atomic uint64_t max;
+} metrics_histogram_data_t;
+
+typedef struct
+{
+  uint64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+} metrics_histogram_snapshot_t;
+
+static const char *counter_names[METRIC_COUNTER_COUNT] = {
+  "ecs.entities_created",   "ecs.array_growths",
+  "events.emitted",         "events.dropped",
+  "events.dispatched",      "events.broadcast",
+  "render.frames",          "render.upload_bytes",
+};
+
+static const char *gauge_names[METRIC_GAUGE_COUNT] = {
+  "ecs.entities_alive",    "ecs.components_active",
+  "ecs.component_capacity", "ecs.component_bytes",
+  "events.queue_depth",    "events.queue_peak",
+  "render.sdf_objects",    "render.scale_percent",
+};
+
+static const char *histogram_names[METRIC_HISTOGRAM_COUNT] = {
+  "frame.time_us",
+  "render.upload_bytes_per_frame",
+  "events.per_frame",
+};
+
+static _Atomic uint64_t g_counters[METRIC_COUNTER_COUNT];
+static _Atomic int64_t g_gauges[METRIC_GAUGE_COUNT];
+static metrics_histogram_data_t g_histograms[METRIC_HISTOGRAM_COUNT];
+
+static FILE *g_output = NULL;
+static double g_interval = METRICS_DEFAULT_INTERVAL;
+static double g_last_flush = -1.0;
+static uint64_t g_flush_count = 0;
+
+static uint64_t g_mem_allocs_at_flush[MEM_TAG_COUNT];
+static double g_mem_flush_time = -1.0;
+
+result_t
+metrics_init (const char *output_path, double interval_seconds)
+{
+  if (g_output)
+    return RESULT_SUCCESS;
+
+  g_interval
+      = interval_seconds > 0.0 ? interval_seconds : METRICS_DEFAULT_INTERVAL;
+  g_last_flush = -1.0;
+  g_flush_count = 0;
+
+  if (!output_path || !output_path[0])
+    return RESULT_SUCCESS;
+
+  g_output = fopen (output_path, "a");
+  if (!g_output)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to open metrics output file");
+    }
+
+  fprintf (g_output,
+           "{\"event\":\"start\",\"wall_time\":%lld,\"build\":\"%s %s\","
+           "\"interval\":%.3f}\n",
+           (long long)time (NULL), __DATE__, __TIME__, g_interval);
+  fflush (g_output);
+
+  LOG_INFO ("Metrics", "Writing metrics to %s every %.2fs", output_path,
+            g_interval);
+
+  return RESULT_SUCCESS;
+}
+
+void
+metrics_shutdown (void)
+{
+  if (!g_output)
+    return;
+
+  metrics_flush (g_last_flush + g_interval);
+  fclose (g_output);
+  g_output = NULL;
+}
+
+void
+metrics_counter_add (metric_counter_t counter, uint64_t value)
+{
+  if (counter >= METRIC_COUNTER_COUNT)
+    return;
+
+  atomic_fetch_add_explicit (&g_counters[counter], value,
+                             memory_order_relaxed);
+}
+
+uint64_t
+metrics_counter_get (metric_counter_t counter)
+{
+  if (counter >= METRIC_COUNTER_COUNT)
+    return 0;
+
+  return atomic_load_explicit (&g_counters[counter], memory_order_relaxed);
+}
+
+void
+metrics_gauge_set (metric_gauge_t gauge, int64_t value)
+{
+  if (gauge >= METRIC_GAUGE_COUNT)
+    return;
+
+  atomic_store_explicit (&g_gauges[gauge], value, memory_order_relaxed);
+}
+
+void
+metrics_gauge_add (metric_gauge_t gauge, int64_t delta)
+{
+  if (gauge >= METRIC_GAUGE_COUNT)
+    return;
+
+  atomic_fetch_add_explicit (&g_gauges[gauge], delta, memory_order_relaxed);
+}
+
+void
+metrics_gauge_max (metric_gauge_t gauge, int64_t value)
+{
+  if (gauge >= METRIC_GAUGE_COUNT)
+    return;
+
+  int64_t current
+      = atomic_load_explicit (&g_gauges[gauge], memory_order_relaxed);
+  while (value > current
+         && !atomic_compare_exchange_weak_explicit (
+             &g_gauges[gauge], &current, value, memory_order_relaxed,
+             memory_order_relaxed))
+    {
+    }
+}
+
+int64_t
+metrics_gauge_get (metric_gauge_t gauge)
+{
+  if (gauge >= METRIC_GAUGE_COUNT)
+    return 0;
+
+  return atomic_load_explicit (&g_gauges[gauge], memory_order_relaxed);
+}
+
+static uint32_t
+histogram_bucket (uint64_t value)
+{
+  if (value == 0)
+    return 0;
+
+  uint32_t bucket = 64 - (uint32_t)__builtin_clzll (value);
+  return bucket < METRICS_HISTOGRAM_BUCKETS ? bucket
+                                            : METRICS_HISTOGRAM_BUCKETS - 1;
+}
+
+void
+metrics_histogram_record (metric_histogram_t histogram, uint64_t value)
+{
+  if (histogram >= METRIC_HISTOGRAM_COUNT)
+    return;
+
+  metrics_histogram_data_t *data = &g_histograms[histogram];
+  atomic_fetch_add_explicit (&data->buckets[histogram_bucket (value)], 1,
+                             memory_order_relaxed);
+  atomic_fetch_add_explicit (&data->count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit (&data->sum, value, memory_order_relaxed);
+
+  uint64_t current = atomic_load_explicit (&data->max, memory_order_relaxed);
+  while (value > current
+         && !atomic_compare_exchange_weak_explicit (
+             &data->max, &current, value, memory_order_relaxed,
+             memory_order_relaxed))
+    {
+    }
+}
+
+static void
+histogram_take_snapshot (metrics_histogram_data_t *data,
+                         metrics_histogram_snapshot_t *out_snapshot)
+{
+  for (uint32_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+      out_snapshot->buckets[i] = atomic_exchange_explicit (
+          &data->buckets[i], 0, memory_order_relaxed);
+    }
+  out_snapshot->count
+      = atomic_exchange_explicit (&data->count, 0, memory_order_relaxed);
+  out_snapshot->sum
+      = atomic_exchange_explicit (&data->sum, 0, memory_order_relaxed);
+  out_snapshot->max
+      = atomic_exchange_explicit (&data->max, 0, memory_order_relaxed);
+}
+
+static uint64_t
+histogram_percentile (const metrics_histogram_snapshot_t *snapshot,
+                      double percentile)
+{
+  if (snapshot->count == 0)
+    return 0;
+
+  uint64_t target = (uint64_t)((double)snapshot->count * percentile);
+  if (target >= snapshot->count)
+    target = snapshot->count - 1;
+
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+      seen += snapshot->buckets[i];
+      if (seen > target)
+        {
+          uint64_t upper = (1ull << i) - 1;
+          return upper < snapshot->max ? upper : snapshot->max;
+        }
+    }
+
+  return snapshot->max;
+}
+
+result_t
+metrics_flush (double now)
+{
+  if (!g_output)
+    return RESULT_SUCCESS;
+
+  fprintf (g_output, "{\"t\":%.3f,\"seq\":%llu", now,
+           (unsigned long long)g_flush_count++);
+
+  fprintf (g_output, ",\"counters\":{");
+  for (int i = 0; i < METRIC_COUNTER_COUNT; i++)
+    {
+      fprintf (g_output, "%s\"%s\":%llu", i ? "," : "", counter_names[i],
+               (unsigned long long)metrics_counter_get ((metric_counter_t)i));
+    }
+
+  fprintf (g_output, "},\"gauges\":{");
+  for (int i = 0; i < METRIC_GAUGE_COUNT; i++)
+    {
+      fprintf (g_output, "%s\"%s\":%lld", i ? "," : "", gauge_names[i],
+               (long long)metrics_gauge_get ((metric_gauge_t)i));
+    }
+
+  fprintf (g_output, "},\"histograms\":{");
+  for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++)
+    {
+      metrics_histogram_snapshot_t snapshot;
+      histogram_take_snapshot (&g_histograms[i], &snapshot);
+
+      double mean = snapshot.count
+                        ? (double)snapshot.sum / (double)snapshot.count
+                        : 0.0;
+      fprintf (g_output,
+               "%s\"%s\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,"
+               "\"p99\":%llu,\"max\":%llu}",
+               i ? "," : "", histogram_names[i],
+               (unsigned long long)snapshot.count, mean,
+               (unsigned long long)histogram_percentile (&snapshot, 0.50),
+               (unsigned long long)histogram_percentile (&snapshot, 0.99),
+               (unsigned long long)snapshot.max);
+    }
+
+  double elapsed = g_mem_flush_time >= 0.0 ? now - g_mem_flush_time : 0.0;
+  fprintf (g_output, "},\"memory\":{");
+  for (int i = 0; i < MEM_TAG_COUNT; i++)
+    {
+      mem_tag_stats_t stats;
+      mem_get_tag_stats ((mem_tag_t)i, &stats);
+
+      uint64_t allocs = stats.alloc_count - g_mem_allocs_at_flush[i];
+      g_mem_allocs_at_flush[i] = stats.alloc_count;
+
+      fprintf (g_output,
+               "%s\"%s\":{\"live\":%lld,\"peak\":%lld,\"allocs\":%llu,"
+               "\"frees\":%llu,\"allocs_per_sec\":%.1f}",
+               i ? "," : "", stats.name, (long long)stats.live_bytes,
+               (long long)stats.peak_bytes,
+               (unsigned long long)stats.alloc_count,
+               (unsigned long long)stats.free_count,
+               elapsed > 0.0 ? (double)allocs / elapsed : 0.0);
+    }
+  g_mem_flush_time = now;
+
+  fprintf (g_output, "}}\n");
+  fflush (g_output);
+
+  metrics_gauge_set (METRIC_GAUGE_EVENT_QUEUE_PEAK, 0);
+
+  return RESULT_SUCCESS;
+}
+
+void
+metrics_tick (double now)
+{
+  if (!g_output)
+    return;
+
+  if (g_last_flush < 0.0)
+    {
+      g_last_flush = now;
+      return;
+    }
+
+  if (now - g_last_flush < g_interval)
+    return;
+
+  g_last_flush = now;
+  result_t result = metrics_flush (now);
+  if (result.code != RESULT_OK)
+    {
+      LOG_WARNING ("Metrics", "Flush failed: %s", result.message);
+    }
+}
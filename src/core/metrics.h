@@ -0,0 +1,59 @@
+#ifndef HITE_METRICS_H
+#define HITE_METRICS_H
+
+#include "types.h"
+
+#define METRICS_HISTOGRAM_BUCKETS 64
+#define METRICS_DEFAULT_INTERVAL 1.0
+
+typedef enum
+{
+  METRIC_COUNTER_ECS_ENTITIES_CREATED = 0,
+  METRIC_COUNTER_ECS_ARRAY_GROWTHS,
+  METRIC_COUNTER_EVENTS_EMITTED,
+  METRIC_COUNTER_EVENTS_DROPPED,
+  METRIC_COUNTER_EVENTS_DISPATCHED,
+  METRIC_COUNTER_EVENTS_BROADCAST,
+  METRIC_COUNTER_RENDER_FRAMES,
+  METRIC_COUNTER_RENDER_UPLOAD_BYTES,
+  METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+typedef enum
+{
+  METRIC_GAUGE_ECS_ENTITIES_ALIVE = 0,
+  METRIC_GAUGE_ECS_COMPONENTS_ACTIVE,
+  METRIC_GAUGE_ECS_COMPONENT_CAPACITY,
+  METRIC_GAUGE_ECS_COMPONENT_BYTES,
+  METRIC_GAUGE_EVENT_QUEUE_DEPTH,
+  METRIC_GAUGE_EVENT_QUEUE_PEAK,
+  METRIC_GAUGE_RENDER_SDF_OBJECTS,
+  METRIC_GAUGE_RENDER_SCALE_PERCENT,
+  METRIC_GAUGE_COUNT
+} metric_gauge_t;
+
+typedef enum
+{
+  METRIC_HISTOGRAM_FRAME_TIME_US = 0,
+  METRIC_HISTOGRAM_RENDER_UPLOAD_BYTES,
+  METRIC_HISTOGRAM_EVENTS_PER_FRAME,
+  METRIC_HISTOGRAM_COUNT
+} metric_histogram_t;
+
+result_t metrics_init (const char *output_path, double interval_seconds);
+void metrics_shutdown (void);
+
+void metrics_counter_add (metric_counter_t counter, uint64_t value);
+uint64_t metrics_counter_get (metric_counter_t counter);
+
+void metrics_gauge_set (metric_gauge_t gauge, int64_t value);
+void metrics_gauge_add (metric_gauge_t gauge, int64_t delta);
+void metrics_gauge_max (metric_gauge_t gauge, int64_t value);
+int64_t metrics_gauge_get (metric_gauge_t gauge);
+
+void metrics_histogram_record (metric_histogram_t histogram, uint64_t value);
+
+void metrics_tick (double now);
+result_t metrics_flush (double now);
+
+#endif
@@ -1,5 +1,6 @@
 #include "prefab.h"
 #include "../components/developer_overlay_component.h"
+#include "allocator.h"
 #include "component_parsers.h"
 #include "logger.h"
 #include "scheme_parser.h"
@@ -15,15 +16,18 @@ static scheme_state_t *g_scheme_state = NULL;
 prefab_system_t *
 prefab_system_create (void)
 {
-  prefab_system_t *system = calloc (1, sizeof (prefab_system_t));
+  prefab_system_t *system
+      = mem_calloc (MEM_TAG_PREFABS, 1, sizeof (prefab_system_t));
   if (!system)
     return NULL;
 
   system->prefab_capacity = 32;
-  system->prefabs = calloc (system->prefab_capacity, sizeof (prefab_t));
+  system->prefabs
+      = mem_calloc (MEM_TAG_PREFABS, system->prefab_capacity,
+                    sizeof (prefab_t));
   if (!system->prefabs)
     {
-      free (system);
+      mem_free (system);
       return NULL;
     }
 
@@ -47,10 +51,10 @@ prefab_system_destroy (prefab_system_t *system)
       prefab_cleanup (&system->prefabs[i]);
     }
 
-  free (system->prefabs);
+  mem_free (system->prefabs);
   if (system->prefabs_directory)
-    free ((void *)system->prefabs_directory);
-  free (system);
+    mem_free ((void *)system->prefabs_directory);
+  mem_free (system);
 
   if (g_scheme_state)
     {
@@ -75,12 +79,12 @@ prefab_add_component (prefab_t *prefab, const char *component_name,
     }
 
   prefab_component_data_t *comp = &prefab->components[prefab->component_count];
-  comp->component_name = strdup (component_name);
+  comp->component_name = mem_strdup (MEM_TAG_PREFABS, component_name);
   comp->data_size = data_size;
-  comp->data = malloc (data_size);
+  comp->data = mem_alloc (MEM_TAG_PREFABS, data_size);
   if (!comp->data)
     {
-      free ((void *)comp->component_name);
+      mem_free ((void *)comp->component_name);
       return RESULT_ERROR (RESULT_ERROR_ALLOCATION, "Failed to allocate data");
     }
 
@@ -97,16 +101,16 @@ prefab_cleanup (prefab_t *prefab)
     return;
 
   if (prefab->name)
-    free ((void *)prefab->name);
+    mem_free ((void *)prefab->name);
   if (prefab->description)
-    free ((void *)prefab->description);
+    mem_free ((void *)prefab->description);
 
   for (size_t i = 0; i < prefab->component_count; i++)
     {
       if (prefab->components[i].component_name)
-        free ((void *)prefab->components[i].component_name);
+        mem_free ((void *)prefab->components[i].component_name);
       if (prefab->components[i].data)
-        free (prefab->components[i].data);
+        mem_free (prefab->components[i].data);
     }
 
   if (prefab->child_prefab_paths)
@@ -114,9 +118,9 @@ prefab_cleanup (prefab_t *prefab)
       for (size_t i = 0; i < prefab->child_count; i++)
         {
           if (prefab->child_prefab_paths[i])
-            free ((void *)prefab->child_prefab_paths[i]);
+            mem_free ((void *)prefab->child_prefab_paths[i]);
         }
-      free ((void *)prefab->child_prefab_paths);
+      mem_free ((void *)prefab->child_prefab_paths);
     }
 }
 
@@ -166,7 +170,7 @@ prefab_load (prefab_system_t *system, const char *filepath,
     {
       size_t new_capacity = system->prefab_capacity * 2;
       prefab_t *new_prefabs
-          = realloc (system->prefabs, new_capacity * sizeof (prefab_t));
+          = mem_realloc (system->prefabs, new_capacity * sizeof (prefab_t));
       if (!new_prefabs)
         {
           return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
@@ -210,7 +214,7 @@ prefab_load (prefab_system_t *system, const char *filepath,
                   const char *name
                       = scheme_string_wrapper (g_scheme_state, value);
                   if (name)
-                    prefab->name = strdup (name);
+                    prefab->name = mem_strdup (MEM_TAG_PREFABS, name);
                 }
             }
 
@@ -222,7 +226,7 @@ prefab_load (prefab_system_t *system, const char *filepath,
                   const char *desc
                       = scheme_string_wrapper (g_scheme_state, value);
                   if (desc)
-                    prefab->description = strdup (desc);
+                    prefab->description = mem_strdup (MEM_TAG_PREFABS, desc);
                 }
             }
 
@@ -496,10 +500,10 @@ prefab_system_set_directory (prefab_system_t *system,
     return;
 
   if (system->prefabs_directory)
-    free ((void *)system->prefabs_directory);
+    mem_free ((void *)system->prefabs_directory);
 
   if (directory_path)
-    system->prefabs_directory = strdup (directory_path);
+    system->prefabs_directory = mem_strdup (MEM_TAG_PREFABS, directory_path);
   else
     system->prefabs_directory = NULL;
 }
@@ -0,0 +1,456 @@
+#include "profiler.h"
+#include "logger.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROFILER_DEFAULT_DUMP_PATH "hite_trace.json"
+#define PROFILER_STATS_SMOOTHING 0.1
+/* Stack entry for a zone begun while disabled, so its end pops in step. */
+#define PROFILER_SKIPPED_ZONE UINT64_MAX
+
+typedef struct
+{
+  const char *name;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  uint32_t depth;
+} profiler_event_t;
+
+typedef struct
+{
+  uint32_t thread_id;
+  bool is_main;
+
+  profiler_event_t *events;
+  uint64_t event_total;
+
+  uint64_t stack[PROFILER_MAX_DEPTH];
+  uint32_t depth;
+} profiler_thread_buffer_t;
+
+typedef struct
+{
+  const char *name;
+  uint64_t frame_ns;
+  uint32_t frame_calls;
+  profiler_zone_stats_t stats;
+} profiler_zone_accumulator_t;
+
+static pthread_mutex_t g_profiler_mutex = PTHREAD_MUTEX_INITIALIZER;
+static profiler_thread_buffer_t *g_thread_buffers[PROFILER_MAX_THREADS];
+static uint32_t g_thread_count = 0;
+
+static _Thread_local profiler_thread_buffer_t *t_buffer = NULL;
+static _Thread_local bool t_registration_failed = false;
+
+static bool g_initialized = false;
+static bool g_enabled = true;
+static uint64_t g_start_ns = 0;
+static pthread_t g_main_thread;
+
+static profiler_zone_accumulator_t g_zones[PROFILER_MAX_ZONE_STATS];
+static size_t g_zone_count = 0;
+
+static profiler_zone_stats_t g_gpu_zones[PROFILER_MAX_GPU_ZONES];
+static size_t g_gpu_zone_count = 0;
+
+static bool g_dump_requested = false;
+static char g_dump_path[512] = PROFILER_DEFAULT_DUMP_PATH;
+
+uint64_t
+profiler_now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static profiler_thread_buffer_t *
+profiler_thread_buffer (void)
+{
+  if (t_buffer)
+    return t_buffer;
+  if (t_registration_failed)
+    return NULL;
+
+  pthread_mutex_lock (&g_profiler_mutex);
+
+  profiler_thread_buffer_t *buffer = NULL;
+  if (g_thread_count < PROFILER_MAX_THREADS)
+    {
+      buffer = calloc (1, sizeof (profiler_thread_buffer_t));
+      if (buffer)
+        {
+          buffer->events
+              = calloc (PROFILER_EVENTS_PER_THREAD, sizeof (profiler_event_t));
+          if (!buffer->events)
+            {
+              free (buffer);
+              buffer = NULL;
+            }
+        }
+    }
+
+  if (buffer)
+    {
+      buffer->thread_id = g_thread_count;
+      buffer->is_main = g_initialized
+                        && pthread_equal (pthread_self (), g_main_thread);
+      g_thread_buffers[g_thread_count++] = buffer;
+    }
+
+  pthread_mutex_unlock (&g_profiler_mutex);
+
+  if (!buffer)
+    {
+      t_registration_failed = true;
+      LOG_WARNING ("Profiler", "Failed to register thread buffer");
+      return NULL;
+    }
+
+  t_buffer = buffer;
+  return buffer;
+}
+
+void
+profiler_init (void)
+{
+  if (g_initialized)
+    return;
+
+  g_main_thread = pthread_self ();
+  g_start_ns = profiler_now_ns ();
+  g_zone_count = 0;
+  g_gpu_zone_count = 0;
+  g_dump_requested = false;
+  g_initialized = true;
+
+  profiler_thread_buffer ();
+
+  LOG_INFO ("Profiler", "Initialized (%u events per thread)",
+            PROFILER_EVENTS_PER_THREAD);
+}
+
+void
+profiler_shutdown (void)
+{
+  if (!g_initialized)
+    return;
+
+  pthread_mutex_lock (&g_profiler_mutex);
+  for (uint32_t i = 0; i < g_thread_count; i++)
+    {
+      free (g_thread_buffers[i]->events);
+      free (g_thread_buffers[i]);
+      g_thread_buffers[i] = NULL;
+    }
+  g_thread_count = 0;
+  pthread_mutex_unlock (&g_profiler_mutex);
+
+  t_buffer = NULL;
+  g_initialized = false;
+}
+
+void
+profiler_set_enabled (bool enabled)
+{
+  g_enabled = enabled;
+}
+
+bool
+profiler_is_enabled (void)
+{
+  return g_initialized && g_enabled;
+}
+
+void
+profiler_zone_begin (const char *name)
+{
+  if (!g_initialized)
+    return;
+
+  profiler_thread_buffer_t *buffer
+      = g_enabled ? profiler_thread_buffer () : t_buffer;
+  if (!buffer)
+    return;
+
+  if (buffer->depth >= PROFILER_MAX_DEPTH)
+    {
+      buffer->depth++;
+      return;
+    }
+
+  if (!g_enabled)
+    {
+      buffer->stack[buffer->depth++] = PROFILER_SKIPPED_ZONE;
+      return;
+    }
+
+  uint64_t index = buffer->event_total++;
+  profiler_event_t *event
+      = &buffer->events[index % PROFILER_EVENTS_PER_THREAD];
+  event->name = name;
+  event->depth = buffer->depth;
+  event->end_ns = 0;
+  event->start_ns = profiler_now_ns ();
+
+  buffer->stack[buffer->depth++] = index;
+}
+
+static profiler_zone_accumulator_t *
+profiler_find_zone (const char *name, bool create)
+{
+  for (size_t i = 0; i < g_zone_count; i++)
+    {
+      if (g_zones[i].name == name || strcmp (g_zones[i].name, name) == 0)
+        return &g_zones[i];
+    }
+
+  if (!create || g_zone_count >= PROFILER_MAX_ZONE_STATS)
+    return NULL;
+
+  profiler_zone_accumulator_t *zone = &g_zones[g_zone_count++];
+  memset (zone, 0, sizeof (*zone));
+  zone->name = name;
+  zone->stats.name = name;
+  return zone;
+}
+
+void
+profiler_zone_end (void)
+{
+  if (!g_initialized)
+    return;
+
+  profiler_thread_buffer_t *buffer = t_buffer;
+  if (!buffer || buffer->depth == 0)
+    return;
+
+  buffer->depth--;
+  if (buffer->depth >= PROFILER_MAX_DEPTH)
+    return;
+
+  uint64_t index = buffer->stack[buffer->depth];
+  if (index == PROFILER_SKIPPED_ZONE)
+    return;
+
+  uint64_t end_ns = profiler_now_ns ();
+
+  /* The slot may have been recycled if the zone outlived a full ring. */
+  if (buffer->event_total - index > PROFILER_EVENTS_PER_THREAD)
+    return;
+
+  profiler_event_t *event
+      = &buffer->events[index % PROFILER_EVENTS_PER_THREAD];
+  event->end_ns = end_ns;
+
+  if (buffer->is_main)
+    {
+      profiler_zone_accumulator_t *zone
+          = profiler_find_zone (event->name, true);
+      if (zone)
+        {
+          zone->frame_ns += end_ns - event->start_ns;
+          zone->frame_calls++;
+        }
+    }
+}
+
+void
+profiler_frame_mark (void)
+{
+  if (!g_initialized)
+    return;
+
+  for (size_t i = 0; i < g_zone_count; i++)
+    {
+      profiler_zone_accumulator_t *zone = &g_zones[i];
+      double frame_ms = (double)zone->frame_ns / 1.0e6;
+
+      zone->stats.last_ms = frame_ms;
+      zone->stats.calls = zone->frame_calls;
+      zone->stats.avg_ms
+          = zone->stats.avg_ms
+            + (frame_ms - zone->stats.avg_ms) * PROFILER_STATS_SMOOTHING;
+
+      zone->frame_ns = 0;
+      zone->frame_calls = 0;
+    }
+
+  if (g_dump_requested)
+    {
+      g_dump_requested = false;
+      result_t result = profiler_dump_chrome_trace (g_dump_path);
+      if (result.code != RESULT_OK)
+        {
+          LOG_ERROR ("Profiler", "Trace dump failed: %s", result.message);
+        }
+    }
+}
+
+void
+profiler_set_dump_path (const char *path)
+{
+  if (!path)
+    return;
+
+  strncpy (g_dump_path, path, sizeof (g_dump_path) - 1);
+  g_dump_path[sizeof (g_dump_path) - 1] = '\0';
+}
+
+void
+profiler_request_dump (void)
+{
+  g_dump_requested = true;
+}
+
+static void
+write_json_string (FILE *file, const char *text)
+{
+  fputc ('"', file);
+  for (const char *c = text ? text : "?"; *c; c++)
+    {
+      if (*c == '"' || *c == '\\')
+        fputc ('\\', file);
+      if ((unsigned char)*c < 0x20)
+        continue;
+      fputc (*c, file);
+    }
+  fputc ('"', file);
+}
+
+result_t
+profiler_dump_chrome_trace (const char *path)
+{
+  if (!g_initialized || !path)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Profiler not initialized");
+    }
+
+  FILE *file = fopen (path, "w");
+  if (!file)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to open trace file");
+    }
+
+  size_t written = 0;
+  fprintf (file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  pthread_mutex_lock (&g_profiler_mutex);
+
+  for (uint32_t t = 0; t < g_thread_count; t++)
+    {
+      const profiler_thread_buffer_t *buffer = g_thread_buffers[t];
+
+      fprintf (file,
+               "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+               written++ ? ",\n" : "", buffer->thread_id,
+               buffer->is_main ? "main" : "worker", buffer->thread_id);
+
+      uint64_t first = buffer->event_total > PROFILER_EVENTS_PER_THREAD
+                           ? buffer->event_total - PROFILER_EVENTS_PER_THREAD
+                           : 0;
+
+      for (uint64_t i = first; i < buffer->event_total; i++)
+        {
+          const profiler_event_t *event
+              = &buffer->events[i % PROFILER_EVENTS_PER_THREAD];
+          if (event->end_ns == 0 || event->start_ns < g_start_ns)
+            continue;
+
+          fprintf (file, ",\n{\"name\":");
+          write_json_string (file, event->name);
+          fprintf (file,
+                   ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                   "\"ts\":%.3f,\"dur\":%.3f}",
+                   buffer->thread_id,
+                   (double)(event->start_ns - g_start_ns) / 1000.0,
+                   (double)(event->end_ns - event->start_ns) / 1000.0);
+          written++;
+        }
+    }
+
+  pthread_mutex_unlock (&g_profiler_mutex);
+
+  fprintf (file, "\n]}\n");
+  fclose (file);
+
+  LOG_INFO ("Profiler", "Wrote %zu trace events to %s", written, path);
+
+  return RESULT_SUCCESS;
+}
+
+size_t
+profiler_get_zone_stats (profiler_zone_stats_t *out_stats, size_t max_stats)
+{
+  if (!out_stats)
+    return 0;
+
+  size_t count = g_zone_count < max_stats ? g_zone_count : max_stats;
+  for (size_t i = 0; i < count; i++)
+    {
+      out_stats[i] = g_zones[i].stats;
+    }
+  return count;
+}
+
+double
+profiler_get_zone_ms (const char *name)
+{
+  if (!name)
+    return 0.0;
+
+  profiler_zone_accumulator_t *zone = profiler_find_zone (name, false);
+  return zone ? zone->stats.last_ms : 0.0;
+}
+
+void
+profiler_report_gpu_zone (const char *name, double ms)
+{
+  if (!name)
+    return;
+
+  profiler_zone_stats_t *zone = NULL;
+  for (size_t i = 0; i < g_gpu_zone_count; i++)
+    {
+      if (strcmp (g_gpu_zones[i].name, name) == 0)
+        {
+          zone = &g_gpu_zones[i];
+          break;
+        }
+    }
+
+  if (!zone)
+    {
+      if (g_gpu_zone_count >= PROFILER_MAX_GPU_ZONES)
+        return;
+
+      zone = &g_gpu_zones[g_gpu_zone_count++];
+      memset (zone, 0, sizeof (*zone));
+      zone->name = name;
+      zone->avg_ms = ms;
+    }
+
+  zone->last_ms = ms;
+  zone->avg_ms = zone->avg_ms + (ms - zone->avg_ms) * PROFILER_STATS_SMOOTHING;
+  zone->calls++;
+}
+
+size_t
+profiler_get_gpu_zone_stats (profiler_zone_stats_t *out_stats,
+                             size_t max_stats)
+{
+  if (!out_stats)
+    return 0;
+
+  size_t count = g_gpu_zone_count < max_stats ? g_gpu_zone_count : max_stats;
+  memcpy (out_stats, g_gpu_zones, count * sizeof (profiler_zone_stats_t));
+  return count;
+}
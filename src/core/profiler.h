@@ -0,0 +1,55 @@
+#ifndef HITE_PROFILER_H
+#define HITE_PROFILER_H
+
+#include "types.h"
+
+#define PROFILER_MAX_THREADS 16
+#define PROFILER_EVENTS_PER_THREAD 65536
+#define PROFILER_MAX_DEPTH 64
+#define PROFILER_MAX_ZONE_STATS 128
+#define PROFILER_MAX_GPU_ZONES 16
+
+typedef struct
+{
+  const char *name;
+  double last_ms;
+  double avg_ms;
+  uint32_t calls;
+} profiler_zone_stats_t;
+
+void profiler_init (void);
+void profiler_shutdown (void);
+
+void profiler_set_enabled (bool enabled);
+bool profiler_is_enabled (void);
+
+uint64_t profiler_now_ns (void);
+
+void profiler_zone_begin (const char *name);
+void profiler_zone_end (void);
+
+void profiler_frame_mark (void);
+
+void profiler_set_dump_path (const char *path);
+void profiler_request_dump (void);
+result_t profiler_dump_chrome_trace (const char *path);
+
+size_t profiler_get_zone_stats (profiler_zone_stats_t *out_stats,
+                                size_t max_stats);
+double profiler_get_zone_ms (const char *name);
+
+void profiler_report_gpu_zone (const char *name, double ms);
+size_t profiler_get_gpu_zone_stats (profiler_zone_stats_t *out_stats,
+                                    size_t max_stats);
+
+#ifdef HITE_ENABLE_PROFILER
+#define PROFILE_BEGIN(name) profiler_zone_begin (name)
+#define PROFILE_END() profiler_zone_end ()
+#define PROFILE_FRAME_MARK() profiler_frame_mark ()
+#else
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#define PROFILE_FRAME_MARK() ((void)0)
+#endif
+
+#endif
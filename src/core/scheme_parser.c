@@ -1,6 +1,7 @@
 #include "scheme_parser.h"
 #include "../../external/tinyscheme/scheme-private.h"
 #include "../../external/tinyscheme/scheme.h"
+#include "allocator.h"
 #include "logger.h"
 
 #include <stdio.h>
@@ -10,14 +11,16 @@
 scheme_state_t *
 hite_scheme_init (void)
 {
-  scheme_state_t *state = calloc (1, sizeof (scheme_state_t));
+  scheme_state_t *state
+      = mem_calloc (MEM_TAG_SCHEME, 1, sizeof (scheme_state_t));
   if (!state)
     return NULL;
 
-  state->sc = scheme_init_new ();
+  state->sc
+      = scheme_init_new_custom_alloc (mem_scheme_alloc, mem_scheme_free);
   if (!state->sc)
     {
-      free (state);
+      mem_free (state);
       return NULL;
     }
 
@@ -38,10 +41,10 @@ hite_scheme_shutdown (scheme_state_t *state)
   if (state->sc)
     {
       scheme_deinit (state->sc);
-      free (state->sc);
+      mem_free (state->sc);
     }
 
-  free (state);
+  mem_free (state);
 }
 
 result_t
@@ -63,7 +66,7 @@ hite_scheme_load_file (scheme_state_t *state, const char *filepath,
   long size = ftell (file);
   fseek (file, 0, SEEK_SET);
 
-  char *source = malloc (size + 1);
+  char *source = mem_alloc (MEM_TAG_SCHEME, size + 1);
   if (!source)
     {
       fclose (file);
@@ -75,10 +78,10 @@ hite_scheme_load_file (scheme_state_t *state, const char *filepath,
   source[bytes_read] = '\0';
   fclose (file);
 
-  char *wrapper = malloc (strlen (source) + 20);
+  char *wrapper = mem_alloc (MEM_TAG_SCHEME, strlen (source) + 20);
   if (!wrapper)
     {
-      free (source);
+      mem_free (source);
       return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
                            "Failed to allocate memory");
     }
@@ -89,8 +92,8 @@ hite_scheme_load_file (scheme_state_t *state, const char *filepath,
 
   pointer result = state->sc->value;
 
-  free (wrapper);
-  free (source);
+  mem_free (wrapper);
+  mem_free (source);
 
   if (out_result)
     *out_result = result;
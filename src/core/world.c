@@ -1,4 +1,5 @@
 #include "world.h"
+#include "allocator.h"
 #include "component_parsers.h"
 #include "logger.h"
 #include "prefab.h"
@@ -10,14 +11,16 @@
 world_manager_t *
 world_manager_create (void)
 {
-  world_manager_t *manager = calloc (1, sizeof (world_manager_t));
+  world_manager_t *manager
+      = mem_calloc (MEM_TAG_WORLD, 1, sizeof (world_manager_t));
   if (!manager)
     return NULL;
 
-  manager->loaded_worlds = calloc (32, sizeof (world_definition_t *));
+  manager->loaded_worlds
+      = mem_calloc (MEM_TAG_WORLD, 32, sizeof (world_definition_t *));
   if (!manager->loaded_worlds)
     {
-      free (manager);
+      mem_free (manager);
       return NULL;
     }
 
@@ -35,8 +38,8 @@ world_manager_destroy (world_manager_t *manager)
       ecs_world_destroy (manager->active_world);
     }
 
-  free (manager->loaded_worlds);
-  free (manager);
+  mem_free (manager->loaded_worlds);
+  mem_free (manager);
 }
 
 result_t
@@ -228,7 +231,7 @@ world_instantiate_templates (ecs_world_t *world,
                                                "from override: %s",
                                                comp_name, add_res.message);
                                 }
-                              free (parsed_data);
+                              mem_free (parsed_data);
                             }
                           else
                             {
@@ -239,7 +242,7 @@ world_instantiate_templates (ecs_world_t *world,
                                            res.message ? res.message
                                                        : "unknown error");
                               if (parsed_data)
-                                free (parsed_data);
+                                mem_free (parsed_data);
                             }
                         }
                       else
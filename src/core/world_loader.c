@@ -1,4 +1,5 @@
 #include "world_loader.h"
+#include "allocator.h"
 #include "component_parsers.h"
 #include "logger.h"
 #include "scheme_parser.h"
@@ -39,11 +40,12 @@ world_loader_parse_component (scheme_state_t *state, pointer comp_sexp,
 
   if (strcmp (comp_name, "shape") == 0)
     {
-      shape_component_t *shape_data = malloc (sizeof (shape_component_t));
+      shape_component_t *shape_data
+          = mem_alloc (MEM_TAG_WORLD, sizeof (shape_component_t));
       result_t res = parse_shape_component (state, comp_sexp, shape_data);
       if (res.code != RESULT_OK)
         {
-          free (shape_data);
+          mem_free (shape_data);
           return res;
         }
       *out_data = shape_data;
@@ -51,11 +53,12 @@ world_loader_parse_component (scheme_state_t *state, pointer comp_sexp,
     }
   else if (strcmp (comp_name, "camera") == 0)
     {
-      camera_component_t *camera_data = malloc (sizeof (camera_component_t));
+      camera_component_t *camera_data
+          = mem_alloc (MEM_TAG_WORLD, sizeof (camera_component_t));
       result_t res = parse_camera_component (state, comp_sexp, camera_data);
       if (res.code != RESULT_OK)
         {
-          free (camera_data);
+          mem_free (camera_data);
           return res;
         }
       *out_data = camera_data;
@@ -64,12 +67,12 @@ world_loader_parse_component (scheme_state_t *state, pointer comp_sexp,
   else if (strcmp (comp_name, "camera_movement") == 0)
     {
       camera_movement_component_t *movement_data
-          = malloc (sizeof (camera_movement_component_t));
+          = mem_alloc (MEM_TAG_WORLD, sizeof (camera_movement_component_t));
       result_t res
           = parse_camera_movement_component (state, comp_sexp, movement_data);
       if (res.code != RESULT_OK)
         {
-          free (movement_data);
+          mem_free (movement_data);
           return res;
         }
       *out_data = movement_data;
@@ -78,12 +81,12 @@ world_loader_parse_component (scheme_state_t *state, pointer comp_sexp,
   else if (strcmp (comp_name, "camera_rotation") == 0)
     {
       camera_rotation_component_t *rotation_data
-          = malloc (sizeof (camera_rotation_component_t));
+          = mem_alloc (MEM_TAG_WORLD, sizeof (camera_rotation_component_t));
       result_t res
           = parse_camera_rotation_component (state, comp_sexp, rotation_data);
       if (res.code != RESULT_OK)
         {
-          free (rotation_data);
+          mem_free (rotation_data);
           return res;
         }
       *out_data = rotation_data;
@@ -92,12 +95,12 @@ world_loader_parse_component (scheme_state_t *state, pointer comp_sexp,
   else if (strcmp (comp_name, "transform") == 0)
     {
       transform_component_t *transform_data
-          = malloc (sizeof (transform_component_t));
+          = mem_alloc (MEM_TAG_WORLD, sizeof (transform_component_t));
       result_t res
           = parse_transform_component (state, comp_sexp, transform_data);
       if (res.code != RESULT_OK)
         {
-          free (transform_data);
+          mem_free (transform_data);
           return res;
         }
       *out_data = transform_data;
@@ -143,7 +146,8 @@ parse_entity_template (scheme_state_t *state, pointer entity_sexp,
                       = scheme_cadr_wrapper (state, first_elem);
                   if (scheme_is_string_wrapper (state, prefab_name_obj))
                     {
-                      out_template->prefab_name = strdup (
+                      out_template->prefab_name = mem_strdup (
+                          MEM_TAG_WORLD,
                           scheme_string_wrapper (state, prefab_name_obj));
                     }
 
@@ -158,7 +162,7 @@ parse_entity_template (scheme_state_t *state, pointer entity_sexp,
       static int entity_counter = 0;
       char name_buf[32];
       snprintf (name_buf, sizeof (name_buf), "entity_%d", entity_counter++);
-      out_template->name = strdup (name_buf);
+      out_template->name = mem_strdup (MEM_TAG_WORLD, name_buf);
     }
 
   size_t component_count = 0;
@@ -184,7 +188,8 @@ parse_entity_template (scheme_state_t *state, pointer entity_sexp,
   if (component_count > 0)
     {
       out_template->components
-          = calloc (component_count, sizeof (*out_template->components));
+          = mem_calloc (MEM_TAG_WORLD, component_count,
+                        sizeof (*out_template->components));
       out_template->component_count = 0;
     }
 
@@ -209,7 +214,8 @@ parse_entity_template (scheme_state_t *state, pointer entity_sexp,
                     }
 
                   char *comp_name
-                      = strdup (scheme_string_wrapper (state, comp_name_obj));
+                      = mem_strdup (MEM_TAG_WORLD, scheme_string_wrapper (
+                                                       state, comp_name_obj));
                   if (!comp_name)
                     {
                       current = scheme_cdr_wrapper (state, current);
@@ -332,14 +338,16 @@ world_load_from_file (const char *filepath, world_definition_t *out_definition)
   if (prefab_count > 0)
     {
       out_definition->prefab_instances
-          = calloc (prefab_count, sizeof (prefab_instance_t));
+          = mem_calloc (MEM_TAG_WORLD, prefab_count,
+                        sizeof (prefab_instance_t));
       out_definition->prefab_instance_count = 0;
     }
 
   if (entity_count > 0)
     {
       out_definition->entity_templates
-          = calloc (entity_count, sizeof (entity_template_t));
+          = mem_calloc (MEM_TAG_WORLD, entity_count,
+                        sizeof (entity_template_t));
       out_definition->entity_template_count = 0;
     }
 
@@ -374,7 +382,7 @@ world_load_from_file (const char *filepath, world_definition_t *out_definition)
                   const char *name
                       = scheme_string_wrapper (g_world_scheme_state, value);
                   if (name)
-                    out_definition->name = strdup (name);
+                    out_definition->name = mem_strdup (MEM_TAG_WORLD, name);
                 }
             }
 
@@ -411,7 +419,7 @@ world_load_from_file (const char *filepath, world_definition_t *out_definition)
                           g_world_scheme_state, prefab_name_obj);
                       size_t idx = out_definition->prefab_instance_count++;
                       out_definition->prefab_instances[idx].prefab_name
-                          = strdup (prefab_name);
+                          = mem_strdup (MEM_TAG_WORLD, prefab_name);
                       LOG_DEBUG ("World Loader", "Found prefab reference: %s",
                                  prefab_name);
                     }
@@ -463,7 +471,7 @@ world_definition_free (world_definition_t *definition)
     return;
 
   if (definition->name)
-    free ((void *)definition->name);
+    mem_free ((void *)definition->name);
 
   if (definition->prefab_instances)
     {
@@ -471,20 +479,20 @@ world_definition_free (world_definition_t *definition)
         {
           prefab_instance_t *inst = &definition->prefab_instances[i];
           if (inst->prefab_name)
-            free ((void *)inst->prefab_name);
+            mem_free ((void *)inst->prefab_name);
           if (inst->instance_name)
-            free ((void *)inst->instance_name);
+            mem_free ((void *)inst->instance_name);
 
           if (inst->overrides)
             {
               for (size_t j = 0; j < inst->override_count; j++)
                 {
                   if (inst->overrides[j].component_name)
-                    free ((void *)inst->overrides[j].component_name);
+                    mem_free ((void *)inst->overrides[j].component_name);
                   if (inst->overrides[j].override_data)
-                    free (inst->overrides[j].override_data);
+                    mem_free (inst->overrides[j].override_data);
                 }
-              free (inst->overrides);
+              mem_free (inst->overrides);
             }
 
           if (inst->additional_components)
@@ -492,15 +500,15 @@ world_definition_free (world_definition_t *definition)
               for (size_t j = 0; j < inst->additional_component_count; j++)
                 {
                   if (inst->additional_components[j].component_name)
-                    free (
+                    mem_free (
                         (void *)inst->additional_components[j].component_name);
                   if (inst->additional_components[j].override_data)
-                    free (inst->additional_components[j].override_data);
+                    mem_free (inst->additional_components[j].override_data);
                 }
-              free (inst->additional_components);
+              mem_free (inst->additional_components);
             }
         }
-      free (definition->prefab_instances);
+      mem_free (definition->prefab_instances);
     }
 
   if (definition->entity_templates)
@@ -509,22 +517,22 @@ world_definition_free (world_definition_t *definition)
         {
           entity_template_t *tmpl = &definition->entity_templates[i];
           if (tmpl->name)
-            free ((void *)tmpl->name);
+            mem_free ((void *)tmpl->name);
           if (tmpl->prefab_name)
-            free ((void *)tmpl->prefab_name);
+            mem_free ((void *)tmpl->prefab_name);
           if (tmpl->components)
             {
               for (size_t j = 0; j < tmpl->component_count; j++)
                 {
                   if (tmpl->components[j].component_name)
-                    free ((void *)tmpl->components[j].component_name);
+                    mem_free ((void *)tmpl->components[j].component_name);
                   if (tmpl->components[j].data)
-                    free (tmpl->components[j].data);
+                    mem_free (tmpl->components[j].data);
                 }
-              free (tmpl->components);
+              mem_free (tmpl->components);
             }
         }
-      free (definition->entity_templates);
+      mem_free (definition->entity_templates);
     }
 }
 
@@ -4,18 +4,70 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+static bool
+parse_arguments (int argc, char **argv, engine_config_t *config)
+{
+  for (int i = 1; i < argc; i++)
+    {
+      if (strcmp (argv[i], "--benchmark") == 0)
+        {
+          config->benchmark_objects = BENCHMARK_DEFAULT_COUNTS;
+        }
+      else if (strcmp (argv[i], "--benchmark-objects") == 0 && i + 1 < argc)
+        {
+          config->benchmark_objects = argv[++i];
+        }
+      else if (strcmp (argv[i], "--benchmark-frames") == 0 && i + 1 < argc)
+        {
+          config->benchmark_frames = (uint32_t)strtoul (argv[++i], NULL, 10);
+        }
+      else if (strcmp (argv[i], "--target-frame-ms") == 0 && i + 1 < argc)
+        {
+          config->target_frame_ms = strtof (argv[++i], NULL);
+        }
+      else if (strcmp (argv[i], "--hot-reload") == 0)
+        {
+          config->shader_hot_reload = true;
+        }
+      else if (strcmp (argv[i], "--headless") == 0)
+        {
+          config->headless = true;
+        }
+      else if (strcmp (argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+          config->frame_limit = (uint32_t)strtoul (argv[++i], NULL, 10);
+        }
+      else if (strcmp (argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+          config->capture_path = argv[++i];
+        }
+      else
+        {
+          fprintf (stderr,
+                   "Usage: %s [--benchmark] [--benchmark-objects N[,N...]] "
+                   "[--benchmark-frames N] [--target-frame-ms MS] "
+                   "[--hot-reload] [--headless] [--frames N] "
+                   "[--capture PATH_####.png|.ppm|.exr]\n",
+                   argv[0]);
+          return false;
+        }
+    }
+
+  return true;
+}
 
 int
 main (int argc, char **argv)
 {
-  (void)argc;
-  (void)argv;
+  engine_config_t config = engine_config_default ();
+  if (!parse_arguments (argc, argv, &config))
+    return 1;
 
   logger_init ();
   logger_set_level (LOG_LEVEL_DEBUG);
 
-  engine_config_t config = engine_config_default ();
-
   engine_state_t state;
   prefab_system_t *prefab_system = NULL;
 
@@ -0,0 +1,73 @@
+#include "dynamic_resolution.h"
+
+#include <math.h>
+#include <string.h>
+
+#define DYNAMIC_RESOLUTION_SMOOTHING 0.2f
+#define DYNAMIC_RESOLUTION_HEADROOM 0.8f
+#define DYNAMIC_RESOLUTION_MAX_DROP 0.15f
+
+void
+dynamic_resolution_init (dynamic_resolution_t *controller, float target_ms)
+{
+  if (!controller)
+    return;
+
+  memset (controller, 0, sizeof (dynamic_resolution_t));
+  controller->enabled = target_ms > 0.0f;
+  controller->target_ms = target_ms;
+  controller->scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+  controller->smoothed_ms = target_ms;
+  controller->settle_frames = DYNAMIC_RESOLUTION_SETTLE_FRAMES;
+}
+
+bool
+dynamic_resolution_update (dynamic_resolution_t *controller, double gpu_ms)
+{
+  if (!controller || !controller->enabled || gpu_ms <= 0.0)
+    return false;
+
+  controller->smoothed_ms
+      += ((float)gpu_ms - controller->smoothed_ms)
+         * DYNAMIC_RESOLUTION_SMOOTHING;
+
+  /* GPU timings lag a few frames behind, so let a change show up in the
+     measurements before reacting again. */
+  if (controller->settle_frames > 0)
+    {
+      controller->settle_frames--;
+      return false;
+    }
+
+  float ratio = controller->smoothed_ms / controller->target_ms;
+  float scale = controller->scale;
+
+  if (ratio > 1.0f)
+    {
+      /* Cost scales with pixel count, i.e. with the square of the scale. */
+      float drop = scale - scale / sqrtf (ratio);
+      if (drop < DYNAMIC_RESOLUTION_SCALE_STEP && ratio > 1.05f)
+        drop = DYNAMIC_RESOLUTION_SCALE_STEP;
+      if (drop > DYNAMIC_RESOLUTION_MAX_DROP)
+        drop = DYNAMIC_RESOLUTION_MAX_DROP;
+      scale -= drop;
+    }
+  else if (ratio < DYNAMIC_RESOLUTION_HEADROOM)
+    {
+      scale += DYNAMIC_RESOLUTION_SCALE_STEP;
+    }
+
+  scale = roundf (scale / DYNAMIC_RESOLUTION_SCALE_STEP)
+          * DYNAMIC_RESOLUTION_SCALE_STEP;
+  if (scale < DYNAMIC_RESOLUTION_MIN_SCALE)
+    scale = DYNAMIC_RESOLUTION_MIN_SCALE;
+  if (scale > DYNAMIC_RESOLUTION_MAX_SCALE)
+    scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+
+  if (fabsf (scale - controller->scale) < DYNAMIC_RESOLUTION_SCALE_STEP * 0.5f)
+    return false;
+
+  controller->scale = scale;
+  controller->settle_frames = DYNAMIC_RESOLUTION_SETTLE_FRAMES;
+  return true;
+}
@@ -0,0 +1,27 @@
+#ifndef HITE_DYNAMIC_RESOLUTION_H
+#define HITE_DYNAMIC_RESOLUTION_H
+
+#include "../core/types.h"
+
+#define DYNAMIC_RESOLUTION_DEFAULT_TARGET_MS 16.0f
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0f
+#define DYNAMIC_RESOLUTION_SCALE_STEP 0.025f
+#define DYNAMIC_RESOLUTION_SETTLE_FRAMES 8
+
+typedef struct
+{
+  bool enabled;
+  float target_ms;
+  float scale;
+  float smoothed_ms;
+  uint32_t settle_frames;
+} dynamic_resolution_t;
+
+void dynamic_resolution_init (dynamic_resolution_t *controller,
+                              float target_ms);
+
+bool dynamic_resolution_update (dynamic_resolution_t *controller,
+                                double gpu_ms);
+
+#endif
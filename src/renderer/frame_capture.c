@@ -0,0 +1,260 @@
+#include "frame_capture.h"
+#include "../core/logger.h"
+#include <stdio.h>
+#include <string.h>
+
+static bool
+frame_capture_format_path (const frame_capture_t *capture,
+                           uint32_t frame_number, char *out_path,
+                           size_t size)
+{
+  const char *pattern = capture->path_pattern;
+  const char *hashes = strchr (pattern, '#');
+  if (!hashes)
+    {
+      int written = snprintf (out_path, size, "%s", pattern);
+      return written > 0 && (size_t)written < size;
+    }
+
+  int digits = (int)strspn (hashes, "#");
+  int written = snprintf (out_path, size, "%.*s%0*u%s",
+                          (int)(hashes - pattern), pattern, digits,
+                          frame_number, hashes + digits);
+  return written > 0 && (size_t)written < size;
+}
+
+static result_t
+frame_capture_write_slot (frame_capture_t *capture,
+                          frame_capture_slot_t *slot)
+{
+  slot->pending = false;
+
+  char path[FRAME_CAPTURE_PATH_MAX + 16];
+  if (!frame_capture_format_path (capture, slot->frame_number, path,
+                                  sizeof (path)))
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Capture path too long");
+    }
+
+  result_t result
+      = image_write (path, capture->format, slot->staging.mapped,
+                     slot->width, slot->height, slot->width * 4);
+  if (result.code != RESULT_OK)
+    return result;
+
+  capture->written_count++;
+  return RESULT_SUCCESS;
+}
+
+static frame_capture_slot_t *
+frame_capture_oldest_ready (frame_capture_t *capture,
+                            vulkan_context_t *context, bool wait)
+{
+  frame_capture_slot_t *oldest = NULL;
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      frame_capture_slot_t *slot = &capture->slots[i];
+      if (!slot->pending)
+        continue;
+      if (!wait
+          && vkGetFenceStatus (context->device, slot->fence) != VK_SUCCESS)
+        continue;
+      if (!oldest || slot->frame_number < oldest->frame_number)
+        oldest = slot;
+    }
+  return oldest;
+}
+
+result_t
+frame_capture_create (vulkan_context_t *context, uint32_t max_width,
+                      uint32_t max_height, const char *path_pattern,
+                      frame_capture_t *capture)
+{
+  if (!context || !capture || !path_pattern || max_width == 0
+      || max_height == 0)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Invalid parameters");
+    }
+
+  memset (capture, 0, sizeof (frame_capture_t));
+  capture->max_width = max_width;
+  capture->max_height = max_height;
+
+  int written = snprintf (capture->path_pattern,
+                          sizeof (capture->path_pattern), "%s", path_pattern);
+  if (written <= 0 || (size_t)written >= sizeof (capture->path_pattern))
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Capture path too long");
+    }
+
+  capture->format = image_format_from_path (path_pattern);
+  if (capture->format == IMAGE_FORMAT_COUNT)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Capture path must end in .ppm, .png or .exr");
+    }
+
+  VkDeviceSize size = (VkDeviceSize)max_width * max_height * 4;
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      frame_capture_slot_t *slot = &capture->slots[i];
+
+      /* Cached memory makes the CPU read of the whole frame much cheaper;
+         not every device exposes it together with coherent memory. */
+      result_t result = gpu_buffer_create (
+          context, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+              | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+          &slot->staging);
+      if (result.code != RESULT_OK)
+        {
+          result = gpu_buffer_create (
+              context, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                  | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+              &slot->staging);
+        }
+      if (result.code == RESULT_OK)
+        result = gpu_buffer_map (context, &slot->staging);
+
+      if (result.code != RESULT_OK)
+        {
+          frame_capture_destroy (context, capture);
+          return result;
+        }
+    }
+
+  return RESULT_SUCCESS;
+}
+
+void
+frame_capture_destroy (vulkan_context_t *context, frame_capture_t *capture)
+{
+  if (!context || !capture || !frame_capture_active (capture))
+    return;
+
+  vkDeviceWaitIdle (context->device);
+
+  frame_capture_slot_t *slot;
+  while ((slot = frame_capture_oldest_ready (capture, context, true)))
+    {
+      result_t result = frame_capture_write_slot (capture, slot);
+      if (result.code != RESULT_OK)
+        LOG_WARNING ("FrameCapture", "Frame %u not written: %s",
+                     slot->frame_number, result.message);
+    }
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      if (capture->slots[i].staging.buffer)
+        gpu_buffer_destroy (context, &capture->slots[i].staging);
+    }
+
+  if (capture->written_count > 0)
+    LOG_INFO ("FrameCapture", "Wrote %u frames to %s",
+              capture->written_count, capture->path_pattern);
+
+  memset (capture, 0, sizeof (frame_capture_t));
+}
+
+bool
+frame_capture_active (const frame_capture_t *capture)
+{
+  return capture && capture->slots[0].staging.buffer != VK_NULL_HANDLE;
+}
+
+void
+frame_capture_cmd_copy (frame_capture_t *capture, vulkan_context_t *context,
+                        uint32_t frame_index, VkFence fence,
+                        VkCommandBuffer cmd, const gpu_image_t *source,
+                        uint32_t width, uint32_t height)
+{
+  frame_capture_slot_t *slot
+      = &capture->slots[frame_index % MAX_FRAMES_IN_FLIGHT];
+
+  /* The slot's frame fence was waited on before this frame began, so this
+     only ever writes, it does not stall. */
+  if (slot->pending)
+    {
+      vkWaitForFences (context->device, 1, &slot->fence, VK_TRUE,
+                       UINT64_MAX);
+      result_t result = frame_capture_write_slot (capture, slot);
+      if (result.code != RESULT_OK)
+        LOG_WARNING ("FrameCapture", "Frame %u not written: %s",
+                     slot->frame_number, result.message);
+    }
+
+  if (width > capture->max_width)
+    width = capture->max_width;
+  if (height > capture->max_height)
+    height = capture->max_height;
+
+  VkImageMemoryBarrier barrier = { 0 };
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = source->image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                        &barrier);
+
+  VkBufferImageCopy region = { 0 };
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = width;
+  region.imageExtent.height = height;
+  region.imageExtent.depth = 1;
+
+  vkCmdCopyImageToBuffer (cmd, source->image, VK_IMAGE_LAYOUT_GENERAL,
+                          slot->staging.buffer, 1, &region);
+
+  VkBufferMemoryBarrier host_barrier = { 0 };
+  host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.buffer = slot->staging.buffer;
+  host_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1,
+                        &host_barrier, 0, NULL);
+
+  slot->fence = fence;
+  slot->width = width;
+  slot->height = height;
+  slot->frame_number = capture->frame_number++;
+  slot->pending = true;
+}
+
+result_t
+frame_capture_poll (frame_capture_t *capture, vulkan_context_t *context)
+{
+  if (!frame_capture_active (capture))
+    return RESULT_SUCCESS;
+
+  result_t result = RESULT_SUCCESS;
+  frame_capture_slot_t *slot;
+  while ((slot = frame_capture_oldest_ready (capture, context, false)))
+    {
+      result_t write_result = frame_capture_write_slot (capture, slot);
+      if (write_result.code != RESULT_OK)
+        result = write_result;
+    }
+
+  return result;
+}
@@ -0,0 +1,63 @@
+#ifndef HITE_FRAME_CAPTURE_H
+#define HITE_FRAME_CAPTURE_H
+
+#include "image_writer.h"
+#include "vulkan_core.h"
+
+#define FRAME_CAPTURE_PATH_MAX 1024
+
+/* One staging buffer per frame in flight, filled by the frame that owns
+   the slot and written out once that frame's fence has signalled. */
+typedef struct
+{
+  gpu_buffer_t staging;
+  VkFence fence;
+  uint32_t width;
+  uint32_t height;
+  uint32_t frame_number;
+  bool pending;
+} frame_capture_slot_t;
+
+/* Copies each frame's final image into host-visible memory and writes it
+   to disk without waiting on the GPU. A run of '#' in the path pattern is
+   replaced by the zero-padded frame number ("frames/frame_####.png");
+   without one every frame overwrites the same file. The extension picks
+   the format (.ppm, .png or .exr). */
+typedef struct
+{
+  frame_capture_slot_t slots[MAX_FRAMES_IN_FLIGHT];
+  uint32_t max_width;
+  uint32_t max_height;
+
+  char path_pattern[FRAME_CAPTURE_PATH_MAX];
+  image_format_t format;
+  uint32_t frame_number;
+  uint32_t written_count;
+} frame_capture_t;
+
+result_t frame_capture_create (vulkan_context_t *context, uint32_t max_width,
+                               uint32_t max_height, const char *path_pattern,
+                               frame_capture_t *capture);
+/* Writes whatever is still pending; waits for the device first. */
+void frame_capture_destroy (vulkan_context_t *context,
+                            frame_capture_t *capture);
+
+bool frame_capture_active (const frame_capture_t *capture);
+
+/* Records the copy into cmd for the frame in slot frame_index; fence is
+   the one that frame's submission signals. source must be in GENERAL
+   layout after compute writes. Any earlier capture still held by the slot
+   is written first. */
+void frame_capture_cmd_copy (frame_capture_t *capture,
+                             vulkan_context_t *context, uint32_t frame_index,
+                             VkFence fence, VkCommandBuffer cmd,
+                             const gpu_image_t *source, uint32_t width,
+                             uint32_t height);
+
+/* Writes every pending capture whose fence has signalled, oldest first.
+   Never blocks on the GPU. Call it after the frame that recorded a copy
+   was submitted, as its fence still reads signalled until then. */
+result_t frame_capture_poll (frame_capture_t *capture,
+                             vulkan_context_t *context);
+
+#endif
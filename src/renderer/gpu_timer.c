@@ -0,0 +1,205 @@
+#include "gpu_timer.h"
+#include "../core/allocator.h"
+#include "../core/logger.h"
+#include "../core/profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GPU_TIMER_QUERIES_PER_FRAME (GPU_TIMER_PASS_COUNT * 2)
+
+static const char *pass_names[GPU_TIMER_PASS_COUNT]
+    = { "gpu_raymarch", "gpu_lighting", "gpu_overlay", "gpu_present" };
+
+static uint32_t
+query_index (uint32_t slot, gpu_timer_pass_t pass)
+{
+  return slot * GPU_TIMER_QUERIES_PER_FRAME + (uint32_t)pass * 2;
+}
+
+result_t
+gpu_timer_create (vulkan_context_t *context, gpu_timer_t *timer)
+{
+  memset (timer, 0, sizeof (gpu_timer_t));
+  timer->vk_context = context;
+
+  uint32_t queue_family_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties (context->physical_device,
+                                            &queue_family_count, NULL);
+
+  VkQueueFamilyProperties *queue_families
+      = mem_calloc (MEM_TAG_RENDERER, queue_family_count,
+                    sizeof (VkQueueFamilyProperties));
+  if (!queue_families)
+    {
+      return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                           "Failed to allocate queue family properties");
+    }
+
+  vkGetPhysicalDeviceQueueFamilyProperties (
+      context->physical_device, &queue_family_count, queue_families);
+
+  uint32_t valid_bits = 64;
+  uint32_t families[2] = { context->graphics_family, context->compute_family };
+  for (int i = 0; i < 2; i++)
+    {
+      if (families[i] < queue_family_count
+          && queue_families[families[i]].timestampValidBits < valid_bits)
+        {
+          valid_bits = queue_families[families[i]].timestampValidBits;
+        }
+    }
+
+  mem_free (queue_families);
+
+  float period = context->device_properties.limits.timestampPeriod;
+  if (valid_bits == 0 || period <= 0.0f)
+    {
+      LOG_WARNING ("GpuTimer",
+                   "Timestamp queries unsupported, GPU timings disabled");
+      return RESULT_SUCCESS;
+    }
+
+  timer->valid_mask
+      = valid_bits >= 64 ? UINT64_MAX : ((1ull << valid_bits) - 1ull);
+  timer->period_ns = period;
+
+  VkQueryPoolCreateInfo pool_info = { 0 };
+  pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  pool_info.queryCount = GPU_TIMER_FRAME_LATENCY * GPU_TIMER_QUERIES_PER_FRAME;
+
+  if (vkCreateQueryPool (context->device, &pool_info, NULL,
+                         &timer->query_pool)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create timestamp query pool");
+    }
+
+  timer->supported = true;
+
+  LOG_INFO ("GpuTimer", "Timestamp queries enabled (%u valid bits, %.3f ns)",
+            valid_bits, timer->period_ns);
+
+  return RESULT_SUCCESS;
+}
+
+void
+gpu_timer_destroy (gpu_timer_t *timer)
+{
+  if (!timer || !timer->vk_context)
+    return;
+
+  if (timer->query_pool)
+    vkDestroyQueryPool (timer->vk_context->device, timer->query_pool, NULL);
+
+  memset (timer, 0, sizeof (gpu_timer_t));
+}
+
+void
+gpu_timer_begin_frame (gpu_timer_t *timer)
+{
+  if (!timer || !timer->supported)
+    return;
+
+  timer->frame_slot = (timer->frame_slot + 1) % GPU_TIMER_FRAME_LATENCY;
+
+  uint32_t slot = timer->frame_slot;
+  for (int pass = 0; pass < GPU_TIMER_PASS_COUNT; pass++)
+    {
+      if (!(timer->recorded_mask[slot] & (1u << pass)))
+        continue;
+
+      uint64_t data[4] = { 0 };
+      VkResult result = vkGetQueryPoolResults (
+          timer->vk_context->device, timer->query_pool,
+          query_index (slot, (gpu_timer_pass_t)pass), 2, sizeof (data), data,
+          sizeof (uint64_t) * 2,
+          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+      if (result != VK_SUCCESS && result != VK_NOT_READY)
+        continue;
+      if (data[1] == 0 || data[3] == 0)
+        continue;
+
+      uint64_t ticks = (data[2] - data[0]) & timer->valid_mask;
+      timer->pass_ms[pass] = (double)ticks * timer->period_ns / 1.0e6;
+
+      profiler_report_gpu_zone (pass_names[pass], timer->pass_ms[pass]);
+    }
+
+  timer->recorded_mask[slot] = 0;
+}
+
+void
+gpu_timer_abort_frame (gpu_timer_t *timer)
+{
+  if (!timer || !timer->supported)
+    return;
+
+  timer->recorded_mask[timer->frame_slot] = 0;
+}
+
+void
+gpu_timer_cmd_begin (gpu_timer_t *timer, VkCommandBuffer cmd,
+                     gpu_timer_pass_t pass)
+{
+  if (!timer || !timer->supported)
+    return;
+
+  uint32_t first = query_index (timer->frame_slot, pass);
+  vkCmdResetQueryPool (cmd, timer->query_pool, first, 2);
+  vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       timer->query_pool, first);
+}
+
+void
+gpu_timer_cmd_end (gpu_timer_t *timer, VkCommandBuffer cmd,
+                   gpu_timer_pass_t pass)
+{
+  if (!timer || !timer->supported)
+    return;
+
+  uint32_t first = query_index (timer->frame_slot, pass);
+  vkCmdWriteTimestamp (cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       timer->query_pool, first + 1);
+
+  timer->recorded_mask[timer->frame_slot] |= 1u << pass;
+}
+
+double
+gpu_timer_get_ms (const gpu_timer_t *timer, gpu_timer_pass_t pass)
+{
+  if (!timer || pass >= GPU_TIMER_PASS_COUNT)
+    return 0.0;
+
+  return timer->pass_ms[pass];
+}
+
+double
+gpu_timer_get_total_ms (const gpu_timer_t *timer)
+{
+  double total = 0.0;
+  for (int pass = 0; pass < GPU_TIMER_PASS_COUNT; pass++)
+    {
+      total += gpu_timer_get_ms (timer, (gpu_timer_pass_t)pass);
+    }
+  return total;
+}
+
+double
+gpu_timer_get_scene_ms (const gpu_timer_t *timer)
+{
+  return gpu_timer_get_ms (timer, GPU_TIMER_PASS_RAYMARCH)
+         + gpu_timer_get_ms (timer, GPU_TIMER_PASS_LIGHTING);
+}
+
+const char *
+gpu_timer_pass_name (gpu_timer_pass_t pass)
+{
+  if (pass >= GPU_TIMER_PASS_COUNT)
+    return "unknown";
+
+  return pass_names[pass];
+}
@@ -0,0 +1,52 @@
+#ifndef HITE_GPU_TIMER_H
+#define HITE_GPU_TIMER_H
+
+#include "vulkan_core.h"
+
+#define GPU_TIMER_FRAME_LATENCY 3
+
+typedef enum
+{
+  GPU_TIMER_PASS_RAYMARCH = 0,
+  GPU_TIMER_PASS_LIGHTING,
+  GPU_TIMER_PASS_OVERLAY,
+  GPU_TIMER_PASS_PRESENT,
+  GPU_TIMER_PASS_COUNT
+} gpu_timer_pass_t;
+
+typedef struct
+{
+  vulkan_context_t *vk_context;
+
+  VkQueryPool query_pool;
+  bool supported;
+  double period_ns;
+  uint64_t valid_mask;
+
+  uint32_t frame_slot;
+  uint32_t recorded_mask[GPU_TIMER_FRAME_LATENCY];
+
+  double pass_ms[GPU_TIMER_PASS_COUNT];
+} gpu_timer_t;
+
+result_t gpu_timer_create (vulkan_context_t *context, gpu_timer_t *timer);
+void gpu_timer_destroy (gpu_timer_t *timer);
+
+void gpu_timer_begin_frame (gpu_timer_t *timer);
+/* Forgets the current slot's queries when its commands were never
+   submitted, so stale results are not read back as this frame's. */
+void gpu_timer_abort_frame (gpu_timer_t *timer);
+
+void gpu_timer_cmd_begin (gpu_timer_t *timer, VkCommandBuffer cmd,
+                          gpu_timer_pass_t pass);
+void gpu_timer_cmd_end (gpu_timer_t *timer, VkCommandBuffer cmd,
+                        gpu_timer_pass_t pass);
+
+double gpu_timer_get_ms (const gpu_timer_t *timer, gpu_timer_pass_t pass);
+double gpu_timer_get_total_ms (const gpu_timer_t *timer);
+/* Only the passes whose cost follows the internal render resolution
+   (raymarch, including culling and reprojection, and lighting). */
+double gpu_timer_get_scene_ms (const gpu_timer_t *timer);
+const char *gpu_timer_pass_name (gpu_timer_pass_t pass);
+
+#endif
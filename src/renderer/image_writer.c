@@ -0,0 +1,400 @@
+#include "image_writer.h"
+#include "../core/allocator.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#define PNG_STORED_BLOCK_MAX 65535u
+#define EXR_MAGIC 20000630u
+#define EXR_PIXEL_TYPE_HALF 1
+#define EXR_DISPLAY_GAMMA 2.2f
+
+image_format_t
+image_format_from_path (const char *path)
+{
+  const char *dot = path ? strrchr (path, '.') : NULL;
+  if (!dot)
+    return IMAGE_FORMAT_COUNT;
+
+  if (strcasecmp (dot, ".ppm") == 0)
+    return IMAGE_FORMAT_PPM;
+  if (strcasecmp (dot, ".png") == 0)
+    return IMAGE_FORMAT_PNG;
+  if (strcasecmp (dot, ".exr") == 0)
+    return IMAGE_FORMAT_EXR;
+
+  return IMAGE_FORMAT_COUNT;
+}
+
+result_t
+image_write (const char *path, image_format_t format, const uint8_t *rgba,
+             uint32_t width, uint32_t height, uint32_t stride)
+{
+  switch (format)
+    {
+    case IMAGE_FORMAT_PPM:
+      return image_write_ppm (path, rgba, width, height, stride);
+    case IMAGE_FORMAT_PNG:
+      return image_write_png (path, rgba, width, height, stride);
+    case IMAGE_FORMAT_EXR:
+      return image_write_exr (path, rgba, width, height, stride);
+    default:
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Unsupported image format");
+    }
+}
+
+static result_t
+image_open (const char *path, const uint8_t *rgba, uint32_t width,
+            uint32_t height, FILE **out_file)
+{
+  if (!path || !rgba || width == 0 || height == 0)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Invalid image parameters");
+    }
+
+  *out_file = fopen (path, "wb");
+  if (!*out_file)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to open image file");
+    }
+
+  return RESULT_SUCCESS;
+}
+
+static result_t
+image_close (FILE *file, bool ok)
+{
+  if (fclose (file) != 0 || !ok)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to write image file");
+    }
+
+  return RESULT_SUCCESS;
+}
+
+result_t
+image_write_ppm (const char *path, const uint8_t *rgba, uint32_t width,
+                 uint32_t height, uint32_t stride)
+{
+  FILE *file;
+  result_t result = image_open (path, rgba, width, height, &file);
+  if (result.code != RESULT_OK)
+    return result;
+
+  uint8_t *row = mem_alloc (MEM_TAG_RENDERER, (size_t)width * 3);
+  if (!row)
+    {
+      fclose (file);
+      return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                           "Failed to allocate image row");
+    }
+
+  bool ok = fprintf (file, "P6\n%u %u\n255\n", width, height) > 0;
+  for (uint32_t y = 0; ok && y < height; y++)
+    {
+      const uint8_t *src = rgba + (size_t)y * stride;
+      for (uint32_t x = 0; x < width; x++)
+        {
+          row[x * 3 + 0] = src[x * 4 + 0];
+          row[x * 3 + 1] = src[x * 4 + 1];
+          row[x * 3 + 2] = src[x * 4 + 2];
+        }
+      ok = fwrite (row, 3, width, file) == width;
+    }
+
+  mem_free (row);
+  return image_close (file, ok);
+}
+
+static uint32_t
+png_crc32 (uint32_t crc, const uint8_t *data, size_t size)
+{
+  static uint32_t table[256];
+  static bool table_ready = false;
+
+  if (!table_ready)
+    {
+      for (uint32_t n = 0; n < 256; n++)
+        {
+          uint32_t c = n;
+          for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+          table[n] = c;
+        }
+      table_ready = true;
+    }
+
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void
+store_be32 (uint8_t *out, uint32_t value)
+{
+  out[0] = (uint8_t)(value >> 24);
+  out[1] = (uint8_t)(value >> 16);
+  out[2] = (uint8_t)(value >> 8);
+  out[3] = (uint8_t)value;
+}
+
+static bool
+png_write_chunk (FILE *file, const char type[4], const uint8_t *data,
+                 size_t size)
+{
+  uint8_t header[8];
+  store_be32 (header, (uint32_t)size);
+  memcpy (header + 4, type, 4);
+
+  uint8_t footer[4];
+  uint32_t crc = png_crc32 (0, header + 4, 4);
+  crc = png_crc32 (crc, data, size);
+  store_be32 (footer, crc);
+
+  return fwrite (header, 1, 8, file) == 8
+         && (size == 0 || fwrite (data, 1, size, file) == size)
+         && fwrite (footer, 1, 4, file) == 4;
+}
+
+result_t
+image_write_png (const char *path, const uint8_t *rgba, uint32_t width,
+                 uint32_t height, uint32_t stride)
+{
+  FILE *file;
+  result_t result = image_open (path, rgba, width, height, &file);
+  if (result.code != RESULT_OK)
+    return result;
+
+  /* Filter type 0 per row followed by the RGB bytes. */
+  size_t row_size = 1 + (size_t)width * 3;
+  size_t raw_size = row_size * height;
+  size_t block_count
+      = (raw_size + PNG_STORED_BLOCK_MAX - 1) / PNG_STORED_BLOCK_MAX;
+  size_t zlib_size = 2 + raw_size + block_count * 5 + 4;
+
+  uint8_t *raw = mem_alloc (MEM_TAG_RENDERER, raw_size);
+  uint8_t *zlib = mem_alloc (MEM_TAG_RENDERER, zlib_size);
+  if (!raw || !zlib)
+    {
+      mem_free (raw);
+      mem_free (zlib);
+      fclose (file);
+      return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                           "Failed to allocate PNG buffer");
+    }
+
+  for (uint32_t y = 0; y < height; y++)
+    {
+      const uint8_t *src = rgba + (size_t)y * stride;
+      uint8_t *dst = raw + (size_t)y * row_size;
+      dst[0] = 0;
+      for (uint32_t x = 0; x < width; x++)
+        {
+          dst[1 + x * 3 + 0] = src[x * 4 + 0];
+          dst[1 + x * 3 + 1] = src[x * 4 + 1];
+          dst[1 + x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+
+  uint8_t *out = zlib;
+  *out++ = 0x78;
+  *out++ = 0x01;
+
+  uint32_t adler_a = 1;
+  uint32_t adler_b = 0;
+  for (size_t offset = 0; offset < raw_size;)
+    {
+      size_t length = raw_size - offset;
+      if (length > PNG_STORED_BLOCK_MAX)
+        length = PNG_STORED_BLOCK_MAX;
+
+      *out++ = offset + length == raw_size ? 1 : 0;
+      *out++ = (uint8_t)length;
+      *out++ = (uint8_t)(length >> 8);
+      *out++ = (uint8_t)~length;
+      *out++ = (uint8_t)(~length >> 8);
+      memcpy (out, raw + offset, length);
+      out += length;
+
+      for (size_t i = 0; i < length; i++)
+        {
+          adler_a = (adler_a + raw[offset + i]) % 65521u;
+          adler_b = (adler_b + adler_a) % 65521u;
+        }
+      offset += length;
+    }
+  store_be32 (out, (adler_b << 16) | adler_a);
+
+  static const uint8_t signature[8]
+      = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  uint8_t ihdr[13] = { 0 };
+  store_be32 (ihdr, width);
+  store_be32 (ihdr + 4, height);
+  ihdr[8] = 8;
+  ihdr[9] = 2;
+
+  bool ok = fwrite (signature, 1, sizeof (signature), file)
+                == sizeof (signature)
+            && png_write_chunk (file, "IHDR", ihdr, sizeof (ihdr))
+            && png_write_chunk (file, "IDAT", zlib, zlib_size)
+            && png_write_chunk (file, "IEND", NULL, 0);
+
+  mem_free (raw);
+  mem_free (zlib);
+  return image_close (file, ok);
+}
+
+static uint16_t
+float_to_half (float value)
+{
+  uint32_t bits;
+  memcpy (&bits, &value, sizeof (bits));
+
+  uint32_t sign = (bits >> 16) & 0x8000u;
+  int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffffu;
+
+  if (exponent <= 0)
+    {
+      if (exponent < -10)
+        return (uint16_t)sign;
+      mantissa |= 0x800000u;
+      return (uint16_t)(sign | (mantissa >> (14 - exponent)));
+    }
+  if (exponent >= 31)
+    return (uint16_t)(sign | 0x7c00u);
+
+  return (uint16_t)(sign | ((uint32_t)exponent << 10) | (mantissa >> 13));
+}
+
+static void
+store_le32 (uint8_t *out, uint32_t value)
+{
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+  out[2] = (uint8_t)(value >> 16);
+  out[3] = (uint8_t)(value >> 24);
+}
+
+static uint8_t *
+exr_attribute (uint8_t *out, const char *name, const char *type,
+               const void *value, uint32_t size)
+{
+  size_t name_length = strlen (name) + 1;
+  size_t type_length = strlen (type) + 1;
+  memcpy (out, name, name_length);
+  out += name_length;
+  memcpy (out, type, type_length);
+  out += type_length;
+  store_le32 (out, size);
+  out += 4;
+  memcpy (out, value, size);
+  return out + size;
+}
+
+result_t
+image_write_exr (const char *path, const uint8_t *rgba, uint32_t width,
+                 uint32_t height, uint32_t stride)
+{
+  FILE *file;
+  result_t result = image_open (path, rgba, width, height, &file);
+  if (result.code != RESULT_OK)
+    return result;
+
+  /* Channels must be listed alphabetically, so scanlines are B, G, R. */
+  uint8_t channels[3 * 18 + 1] = { 0 };
+  for (int c = 0; c < 3; c++)
+    {
+      uint8_t *entry = channels + c * 18;
+      entry[0] = (uint8_t)"BGR"[c];
+      store_le32 (entry + 2, EXR_PIXEL_TYPE_HALF);
+      store_le32 (entry + 10, 1);
+      store_le32 (entry + 14, 1);
+    }
+
+  uint8_t window[16];
+  store_le32 (window, 0);
+  store_le32 (window + 4, 0);
+  store_le32 (window + 8, width - 1);
+  store_le32 (window + 12, height - 1);
+
+  float one = 1.0f;
+  float center[2] = { 0.0f, 0.0f };
+  uint8_t zero = 0;
+
+  uint8_t header[512];
+  uint8_t *out = header;
+  store_le32 (out, EXR_MAGIC);
+  store_le32 (out + 4, 2);
+  out += 8;
+  out = exr_attribute (out, "channels", "chlist", channels,
+                       sizeof (channels));
+  out = exr_attribute (out, "compression", "compression", &zero, 1);
+  out = exr_attribute (out, "dataWindow", "box2i", window, 16);
+  out = exr_attribute (out, "displayWindow", "box2i", window, 16);
+  out = exr_attribute (out, "lineOrder", "lineOrder", &zero, 1);
+  out = exr_attribute (out, "pixelAspectRatio", "float", &one, 4);
+  out = exr_attribute (out, "screenWindowCenter", "v2f", center, 8);
+  out = exr_attribute (out, "screenWindowWidth", "float", &one, 4);
+  *out++ = 0;
+  size_t header_size = (size_t)(out - header);
+
+  size_t line_size = 8 + (size_t)width * 3 * 2;
+  uint8_t *line = mem_alloc (MEM_TAG_RENDERER, line_size);
+  uint8_t *offsets = mem_alloc (MEM_TAG_RENDERER, (size_t)height * 8);
+  if (!line || !offsets)
+    {
+      mem_free (line);
+      mem_free (offsets);
+      fclose (file);
+      return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                           "Failed to allocate EXR buffer");
+    }
+
+  uint64_t first_line = header_size + (uint64_t)height * 8;
+  for (uint32_t y = 0; y < height; y++)
+    {
+      uint64_t offset = first_line + (uint64_t)y * line_size;
+      store_le32 (offsets + y * 8, (uint32_t)offset);
+      store_le32 (offsets + y * 8 + 4, (uint32_t)(offset >> 32));
+    }
+
+  uint16_t to_half[256];
+  for (int i = 0; i < 256; i++)
+    to_half[i]
+        = float_to_half (powf ((float)i / 255.0f, EXR_DISPLAY_GAMMA));
+
+  bool ok = fwrite (header, 1, header_size, file) == header_size
+            && fwrite (offsets, 8, height, file) == height;
+
+  for (uint32_t y = 0; ok && y < height; y++)
+    {
+      const uint8_t *src = rgba + (size_t)y * stride;
+      store_le32 (line, y);
+      store_le32 (line + 4, (uint32_t)(line_size - 8));
+
+      uint8_t *dst = line + 8;
+      for (int c = 0; c < 3; c++)
+        {
+          int source_channel = 2 - c;
+          for (uint32_t x = 0; x < width; x++)
+            {
+              uint16_t half = to_half[src[x * 4 + source_channel]];
+              *dst++ = (uint8_t)half;
+              *dst++ = (uint8_t)(half >> 8);
+            }
+        }
+
+      ok = fwrite (line, 1, line_size, file) == line_size;
+    }
+
+  mem_free (line);
+  mem_free (offsets);
+  return image_close (file, ok);
+}
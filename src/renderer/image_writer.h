@@ -0,0 +1,35 @@
+#ifndef HITE_IMAGE_WRITER_H
+#define HITE_IMAGE_WRITER_H
+
+#include "../core/types.h"
+#include <stdint.h>
+
+typedef enum
+{
+  IMAGE_FORMAT_PPM = 0,
+  IMAGE_FORMAT_PNG,
+  IMAGE_FORMAT_EXR,
+  IMAGE_FORMAT_COUNT
+} image_format_t;
+
+/* Picks the format from the file extension; IMAGE_FORMAT_COUNT when the
+   extension is not one of .ppm, .png or .exr. */
+image_format_t image_format_from_path (const char *path);
+
+/* All writers take tightly packed or strided 8-bit RGBA pixels, top row
+   first. Alpha is dropped. */
+result_t image_write (const char *path, image_format_t format,
+                      const uint8_t *rgba, uint32_t width, uint32_t height,
+                      uint32_t stride);
+
+result_t image_write_ppm (const char *path, const uint8_t *rgba,
+                          uint32_t width, uint32_t height, uint32_t stride);
+/* Uncompressed (stored deflate) RGB, so no zlib dependency. */
+result_t image_write_png (const char *path, const uint8_t *rgba,
+                          uint32_t width, uint32_t height, uint32_t stride);
+/* Uncompressed half-float RGB scanlines. The 8-bit input is display
+   encoded, so it is linearized with a 2.2 gamma first. */
+result_t image_write_exr (const char *path, const uint8_t *rgba,
+                          uint32_t width, uint32_t height, uint32_t stride);
+
+#endif
@@ -1,4 +1,7 @@
 #include "raymarcher.h"
+#include "../core/allocator.h"
+#include "../core/logger.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,7 +17,7 @@ read_file (const char *filename, size_t *out_size)
   size_t size = ftell (file);
   fseek (file, 0, SEEK_SET);
 
-  char *buffer = malloc (size);
+  char *buffer = mem_alloc (MEM_TAG_RENDERER, size);
   if (!buffer)
     {
       fclose (file);
@@ -29,29 +32,315 @@ read_file (const char *filename, size_t *out_size)
   return buffer;
 }
 
-result_t
-raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
-                   raymarcher_t *raymarcher)
+static VkDeviceSize
+align_size (VkDeviceSize size, VkDeviceSize alignment)
 {
-  memset (raymarcher, 0, sizeof (raymarcher_t));
-  raymarcher->vk_context = context;
-  raymarcher->width = width;
-  raymarcher->height = height;
-  raymarcher->max_objects = MAX_SDF_OBJECTS;
+  if (alignment == 0)
+    return size;
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+static VkDeviceSize
+raymarcher_sdf_objects_range (uint32_t capacity)
+{
+  return SDF_BUFFER_HEADER_SIZE
+         + (VkDeviceSize)capacity * sizeof (sdf_object_t);
+}
+
+static VkDeviceSize
+raymarcher_sdf_nodes_range (uint32_t capacity)
+{
+  return (VkDeviceSize)capacity * 2 * sizeof (sdf_bvh_node_t);
+}
+
+static result_t
+raymarcher_create_sdf_buffer (raymarcher_t *raymarcher, uint32_t capacity)
+{
+  vulkan_context_t *context = raymarcher->vk_context;
+  const VkPhysicalDeviceLimits *limits = &context->device_properties.limits;
+
+  VkDeviceSize objects_range = raymarcher_sdf_objects_range (capacity);
+  VkDeviceSize nodes_range = raymarcher_sdf_nodes_range (capacity);
+  if (limits->maxStorageBufferRange > 0
+      && (objects_range > limits->maxStorageBufferRange
+          || nodes_range > limits->maxStorageBufferRange))
+    {
+      return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                           "SDF object buffer exceeds maxStorageBufferRange");
+    }
+
+  VkDeviceSize alignment = limits->minStorageBufferOffsetAlignment;
+  VkDeviceSize nodes_offset = align_size (objects_range, alignment);
+  VkDeviceSize slot_size = align_size (nodes_offset + nodes_range, alignment);
+
+  gpu_buffer_t buffer = { 0 };
+  result_t result = gpu_buffer_create_shared (
+      context, slot_size * MAX_FRAMES_IN_FLIGHT,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+          | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      &buffer);
+  if (result.code != RESULT_OK)
+    return result;
+
+  result = gpu_buffer_map (context, &buffer);
+  if (result.code != RESULT_OK)
+    {
+      gpu_buffer_destroy (context, &buffer);
+      return result;
+    }
+
+  sdf_object_t *shadows[MAX_FRAMES_IN_FLIGHT] = { 0 };
+  sdf_bvh_node_t *node_shadows[MAX_FRAMES_IN_FLIGHT] = { 0 };
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      shadows[i]
+          = mem_alloc (MEM_TAG_RENDERER, capacity * sizeof (sdf_object_t));
+      node_shadows[i] = mem_alloc (MEM_TAG_RENDERER, (size_t)nodes_range);
+      if (!shadows[i] || !node_shadows[i])
+        {
+          for (uint32_t j = 0; j <= i; j++)
+            {
+              mem_free (shadows[j]);
+              mem_free (node_shadows[j]);
+            }
+          gpu_buffer_destroy (context, &buffer);
+          return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                               "Failed to allocate SDF shadow copy");
+        }
+    }
+
+  if (raymarcher->sdf_objects_buffer.buffer)
+    gpu_buffer_destroy (context, &raymarcher->sdf_objects_buffer);
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      mem_free (raymarcher->sdf_shadow[i]);
+      mem_free (raymarcher->sdf_node_shadow[i]);
+      raymarcher->sdf_shadow[i] = shadows[i];
+      raymarcher->sdf_node_shadow[i] = node_shadows[i];
+      raymarcher->sdf_shadow_count[i] = 0;
+      raymarcher->sdf_node_shadow_count[i] = 0;
+      raymarcher->sdf_header_shadow_valid[i] = false;
+    }
+
+  raymarcher->sdf_objects_buffer = buffer;
+  raymarcher->sdf_slot_size = slot_size;
+  raymarcher->sdf_nodes_offset = nodes_offset;
+  raymarcher->max_objects = capacity;
+
+  return RESULT_SUCCESS;
+}
+
+static void
+raymarcher_bind_sdf_buffer (raymarcher_t *raymarcher)
+{
+  VkDescriptorBufferInfo objects_info = { 0 };
+  objects_info.buffer = raymarcher->sdf_objects_buffer.buffer;
+  objects_info.offset = 0;
+  objects_info.range = raymarcher_sdf_objects_range (raymarcher->max_objects);
+
+  VkDescriptorBufferInfo nodes_info = { 0 };
+  nodes_info.buffer = raymarcher->sdf_objects_buffer.buffer;
+  nodes_info.offset = raymarcher->sdf_nodes_offset;
+  nodes_info.range = raymarcher_sdf_nodes_range (raymarcher->max_objects);
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      const raymarcher_frame_t *frame = &raymarcher->frames[i];
+      VkWriteDescriptorSet writes[5] = { 0 };
+      uint32_t write_count = 0;
+
+      writes[write_count].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[write_count].dstSet = frame->descriptor_set;
+      writes[write_count].dstBinding = 2;
+      writes[write_count].descriptorType
+          = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+      writes[write_count].descriptorCount = 1;
+      writes[write_count].pBufferInfo = &objects_info;
+      write_count++;
+
+      writes[write_count] = writes[0];
+      writes[write_count].dstBinding = 4;
+      writes[write_count].pBufferInfo = &nodes_info;
+      write_count++;
+
+      if (frame->lighting_descriptor_set)
+        {
+          writes[write_count] = writes[0];
+          writes[write_count].dstSet = frame->lighting_descriptor_set;
+          writes[write_count].dstBinding = 5;
+          write_count++;
+
+          writes[write_count] = writes[1];
+          writes[write_count].dstSet = frame->lighting_descriptor_set;
+          writes[write_count].dstBinding = 6;
+          write_count++;
+        }
+
+      if (frame->tile_cull_descriptor_set)
+        {
+          writes[write_count] = writes[0];
+          writes[write_count].dstSet = frame->tile_cull_descriptor_set;
+          writes[write_count].dstBinding = 1;
+          write_count++;
+        }
+
+      vkUpdateDescriptorSets (raymarcher->vk_context->device, write_count,
+                              writes, 0, NULL);
+    }
+}
+
+static raymarcher_frame_t *
+raymarcher_current_frame (raymarcher_t *raymarcher)
+{
+  return &raymarcher->frames[raymarcher->frame_index];
+}
+
+static void
+raymarcher_wait_all_frames (raymarcher_t *raymarcher)
+{
+  VkFence fences[MAX_FRAMES_IN_FLIGHT];
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    fences[i] = raymarcher->frames[i].fence;
+
+  vkWaitForFences (raymarcher->vk_context->device, MAX_FRAMES_IN_FLIGHT,
+                   fences, VK_TRUE, UINT64_MAX);
+}
+
+static result_t
+raymarcher_grow_sdf_buffer (raymarcher_t *raymarcher, uint32_t count)
+{
+  uint32_t capacity = raymarcher->max_objects;
+  while (capacity < count)
+    capacity = capacity > UINT32_MAX / 4 ? count : capacity * 2;
+
+  raymarcher_wait_all_frames (raymarcher);
+
+  result_t result = raymarcher_create_sdf_buffer (raymarcher, capacity);
+  if (result.code != RESULT_OK)
+    return result;
+
+  raymarcher_bind_sdf_buffer (raymarcher);
+
+  LOG_INFO ("Raymarcher", "Grew SDF object buffer to %u objects (%llu bytes)",
+            capacity,
+            (unsigned long long)(raymarcher->sdf_slot_size
+                                 * MAX_FRAMES_IN_FLIGHT));
+
+  return RESULT_SUCCESS;
+}
+
+static result_t
+raymarcher_create_tile_buffer (raymarcher_t *raymarcher)
+{
+  vulkan_context_t *context = raymarcher->vk_context;
+
+  raymarcher->tiles_x
+      = (raymarcher->width + RAYMARCH_TILE_SIZE - 1) / RAYMARCH_TILE_SIZE;
+  raymarcher->tiles_y
+      = (raymarcher->height + RAYMARCH_TILE_SIZE - 1) / RAYMARCH_TILE_SIZE;
+
+  VkDeviceSize tile_count
+      = (VkDeviceSize)raymarcher->tiles_x * raymarcher->tiles_y;
+  raymarcher->tile_indices_offset = align_size (
+      tile_count * sizeof (uint32_t),
+      context->device_properties.limits.minStorageBufferOffsetAlignment);
+
+  return gpu_buffer_create (
+      context,
+      raymarcher->tile_indices_offset
+          + tile_count * RAYMARCH_TILE_MAX_OBJECTS * sizeof (uint32_t),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &raymarcher->tile_buffer);
+}
+
+static void
+raymarcher_tile_buffer_infos (const raymarcher_t *raymarcher,
+                              VkDescriptorBufferInfo *counts_info,
+                              VkDescriptorBufferInfo *indices_info)
+{
+  memset (counts_info, 0, sizeof (*counts_info));
+  counts_info->buffer = raymarcher->tile_buffer.buffer;
+  counts_info->offset = 0;
+  counts_info->range = raymarcher->tile_indices_offset;
+
+  memset (indices_info, 0, sizeof (*indices_info));
+  indices_info->buffer = raymarcher->tile_buffer.buffer;
+  indices_info->offset = raymarcher->tile_indices_offset;
+  indices_info->range = VK_WHOLE_SIZE;
+}
+
+static bool
+upload_dirty_elements (gpu_buffer_t *buffer, VkDeviceSize offset,
+                       void *shadow, uint32_t shadow_count, const void *data,
+                       uint32_t count, size_t stride)
+{
+  char *old = shadow;
+  const char *new = data;
+  bool changed = false;
+
+  uint32_t i = 0;
+  while (i < count)
+    {
+      if (i < shadow_count
+          && memcmp (old + i * stride, new + i * stride, stride) == 0)
+        {
+          i++;
+          continue;
+        }
+
+      uint32_t first = i;
+      while (i < count
+             && (i >= shadow_count
+                 || memcmp (old + i * stride, new + i * stride, stride)
+                        != 0))
+        {
+          i++;
+        }
+
+      size_t range = (size_t)(i - first) * stride;
+      memcpy (old + first * stride, new + first * stride, range);
+      gpu_buffer_write (buffer, offset + first * stride, new + first * stride,
+                        range);
+      changed = true;
+    }
+
+  return changed;
+}
 
+static result_t
+raymarcher_create_frame (raymarcher_t *raymarcher, raymarcher_frame_t *frame)
+{
+  vulkan_context_t *context = raymarcher->vk_context;
+  uint32_t width = raymarcher->width;
+  uint32_t height = raymarcher->height;
+
+  /* G-buffer: albedo with the hit flag in alpha, linear hit distance, and
+     an octahedral normal packed as two snorm16 values. */
   result_t result = gpu_image_create (
-      context, width, height, VK_FORMAT_R32G32B32A32_SFLOAT,
+      context, width, height, VK_FORMAT_R8G8B8A8_UNORM,
       VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
           | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-      &raymarcher->output_color_depth);
+      &frame->output_color);
 
   if (result.code != RESULT_OK)
     return result;
 
-  result = gpu_image_create (
-      context, width, height, VK_FORMAT_R32G32B32A32_SFLOAT,
-      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-      &raymarcher->output_normal);
+  /* Depth is read by lighting on the compute queue and by the next
+     frame's reprojection on the graphics queue at the same time, so it
+     cannot be handed over like the other images. */
+  result = gpu_image_create_shared (context, width, height,
+                                    VK_FORMAT_R32_SFLOAT,
+                                    VK_IMAGE_USAGE_STORAGE_BIT,
+                                    &frame->output_depth);
+
+  if (result.code != RESULT_OK)
+    return result;
+
+  result = gpu_image_create (context, width, height, VK_FORMAT_R32_UINT,
+                             VK_IMAGE_USAGE_STORAGE_BIT,
+                             &frame->output_normal);
 
   if (result.code != RESULT_OK)
     return result;
@@ -60,7 +349,16 @@ raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
                              VK_IMAGE_USAGE_STORAGE_BIT
                                  | VK_IMAGE_USAGE_SAMPLED_BIT
                                  | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-                             &raymarcher->output_final);
+                             &frame->output_final);
+
+  if (result.code != RESULT_OK)
+    return result;
+
+  result = gpu_buffer_create (context, sizeof (raymarch_uniforms_t),
+                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                  | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &frame->uniform_buffer);
 
   if (result.code != RESULT_OK)
     return result;
@@ -69,21 +367,185 @@ raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
                               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
                                   | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                              &raymarcher->lighting_uniform_buffer);
+                              &frame->lighting_uniform_buffer);
+
+  if (result.code != RESULT_OK)
+    return result;
+
+  result = gpu_buffer_create (context, sizeof (overlay_data_t),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                  | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &frame->overlay_buffer);
+
+  if (result.code != RESULT_OK)
+    return result;
+
+  /* Rewritten every frame, so it stays mapped. */
+  result = gpu_buffer_map (context, &frame->overlay_buffer);
+  if (result.code != RESULT_OK)
+    return result;
+
+  /* The frame ends with a blit to the swapchain, so it is recorded for
+     the graphics queue, which also supports compute. */
+  VkCommandBufferAllocateInfo cmd_alloc_info = { 0 };
+  cmd_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmd_alloc_info.commandPool = context->command_pool;
+  cmd_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmd_alloc_info.commandBufferCount = 1;
+
+  if (vkAllocateCommandBuffers (context->device, &cmd_alloc_info,
+                                &frame->command_buffer)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to allocate command buffer");
+    }
+
+  if (raymarcher->async_compute)
+    {
+      if (vkAllocateCommandBuffers (context->device, &cmd_alloc_info,
+                                    &frame->present_command_buffer)
+          != VK_SUCCESS)
+        {
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to allocate present command buffer");
+        }
+
+      cmd_alloc_info.commandPool = context->compute_command_pool;
+      if (vkAllocateCommandBuffers (context->device, &cmd_alloc_info,
+                                    &frame->compute_command_buffer)
+          != VK_SUCCESS)
+        {
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to allocate compute command buffer");
+        }
+
+      VkSemaphoreCreateInfo semaphore_info = { 0 };
+      semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+      if (vkCreateSemaphore (context->device, &semaphore_info, NULL,
+                             &frame->raymarch_finished)
+              != VK_SUCCESS
+          || vkCreateSemaphore (context->device, &semaphore_info, NULL,
+                                &frame->lighting_finished)
+                 != VK_SUCCESS)
+        {
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to create frame semaphores");
+        }
+    }
+
+  VkFenceCreateInfo fence_info = { 0 };
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  if (vkCreateFence (context->device, &fence_info, NULL, &frame->fence)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN, "Failed to create fence");
+    }
+
+  return RESULT_SUCCESS;
+}
+
+static void
+raymarcher_destroy_frame (vulkan_context_t *context,
+                          raymarcher_frame_t *frame)
+{
+  if (frame->fence)
+    vkDestroyFence (context->device, frame->fence, NULL);
+  if (frame->raymarch_finished)
+    vkDestroySemaphore (context->device, frame->raymarch_finished, NULL);
+  if (frame->lighting_finished)
+    vkDestroySemaphore (context->device, frame->lighting_finished, NULL);
+  if (frame->uniform_buffer.buffer)
+    gpu_buffer_destroy (context, &frame->uniform_buffer);
+  if (frame->lighting_uniform_buffer.buffer)
+    gpu_buffer_destroy (context, &frame->lighting_uniform_buffer);
+  if (frame->overlay_buffer.buffer)
+    gpu_buffer_destroy (context, &frame->overlay_buffer);
+  if (frame->output_color.image)
+    gpu_image_destroy (context, &frame->output_color);
+  if (frame->output_depth.image)
+    gpu_image_destroy (context, &frame->output_depth);
+  if (frame->output_normal.image)
+    gpu_image_destroy (context, &frame->output_normal);
+  if (frame->output_final.image)
+    gpu_image_destroy (context, &frame->output_final);
+}
+
+result_t
+raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
+                   raymarcher_t *raymarcher)
+{
+  memset (raymarcher, 0, sizeof (raymarcher_t));
+  raymarcher->vk_context = context;
+  raymarcher->width = width;
+  raymarcher->height = height;
+  raymarcher->render_width = width;
+  raymarcher->render_height = height;
+  raymarcher->async_compute = context->async_compute;
+  raymarcher->quality = raymarch_quality_from_preset (RAYMARCH_QUALITY_HIGH);
+  raymarcher->shape_mask = 0xffffffffu;
+
+  result_t result;
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      result = raymarcher_create_frame (raymarcher, &raymarcher->frames[i]);
+      if (result.code != RESULT_OK)
+        return result;
+    }
+
+  result = gpu_image_create (
+      context,
+      (width + RAYMARCH_CONE_BLOCK_SIZE - 1) / RAYMARCH_CONE_BLOCK_SIZE,
+      (height + RAYMARCH_CONE_BLOCK_SIZE - 1) / RAYMARCH_CONE_BLOCK_SIZE,
+      VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT,
+      &raymarcher->cone_depth);
+
+  if (result.code != RESULT_OK)
+    return result;
+
+  result = gpu_image_create (
+      context,
+      (width + RAYMARCH_CONE_BLOCK_SIZE - 1) / RAYMARCH_CONE_BLOCK_SIZE,
+      (height + RAYMARCH_CONE_BLOCK_SIZE - 1) / RAYMARCH_CONE_BLOCK_SIZE,
+      VK_FORMAT_R32_UINT,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      &raymarcher->reproject_depth);
+
+  if (result.code != RESULT_OK)
+    return result;
+
+  result = gpu_image_create (context, width, height,
+                             VK_FORMAT_R16G16B16A16_SFLOAT,
+                             VK_IMAGE_USAGE_STORAGE_BIT
+                                 | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                             &raymarcher->shadow_ao);
+
+  if (result.code != RESULT_OK)
+    return result;
+
+  result = gpu_image_create (context, width, height,
+                             VK_FORMAT_R16G16B16A16_SFLOAT,
+                             VK_IMAGE_USAGE_STORAGE_BIT
+                                 | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                             &raymarcher->shadow_ao_history);
 
   if (result.code != RESULT_OK)
     return result;
 
   VkCommandBuffer cmd = vulkan_begin_single_time_commands (context);
 
-  VkImageMemoryBarrier barriers[3] = { 0 };
+  VkImageMemoryBarrier barriers[4 + 4 * MAX_FRAMES_IN_FLIGHT] = { 0 };
 
   barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
   barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
   barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
   barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barriers[0].image = raymarcher->output_color_depth.image;
+  barriers[0].image = raymarcher->cone_depth.image;
   barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   barriers[0].subresourceRange.baseMipLevel = 0;
   barriers[0].subresourceRange.levelCount = 1;
@@ -93,36 +555,46 @@ raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
   barriers[0].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
 
   barriers[1] = barriers[0];
-  barriers[1].image = raymarcher->output_normal.image;
+  barriers[1].image = raymarcher->reproject_depth.image;
 
   barriers[2] = barriers[0];
-  barriers[2].image = raymarcher->output_final.image;
+  barriers[2].image = raymarcher->shadow_ao.image;
+
+  barriers[3] = barriers[0];
+  barriers[3].image = raymarcher->shadow_ao_history.image;
+
+  uint32_t barrier_count = 4;
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      const raymarcher_frame_t *frame = &raymarcher->frames[i];
+      VkImage images[4]
+          = { frame->output_color.image, frame->output_depth.image,
+              frame->output_normal.image, frame->output_final.image };
+
+      for (uint32_t j = 0; j < 4; j++)
+        {
+          barriers[barrier_count] = barriers[0];
+          barriers[barrier_count].image = images[j];
+          barrier_count++;
+        }
+    }
 
   vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
-                        NULL, 3, barriers);
+                        NULL, barrier_count, barriers);
 
   vulkan_end_single_time_commands (context, cmd);
 
-  result = gpu_buffer_create (context, sizeof (raymarch_uniforms_t),
-                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                                  | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                              &raymarcher->uniform_buffer);
-
+  result = raymarcher_create_sdf_buffer (raymarcher,
+                                         SDF_OBJECTS_INITIAL_CAPACITY);
   if (result.code != RESULT_OK)
     return result;
 
-  result = gpu_buffer_create (context, sizeof (sdf_object_t) * MAX_SDF_OBJECTS,
-                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                                  | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                              &raymarcher->sdf_objects_buffer);
-
+  result = raymarcher_create_tile_buffer (raymarcher);
   if (result.code != RESULT_OK)
     return result;
 
-  VkDescriptorSetLayoutBinding bindings[4] = { 0 };
+  VkDescriptorSetLayoutBinding bindings[11] = { 0 };
 
   bindings[0].binding = 0;
   bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -135,7 +607,7 @@ raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
   bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
   bindings[2].binding = 2;
-  bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
   bindings[2].descriptorCount = 1;
   bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
@@ -144,9 +616,40 @@ raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
   bindings[3].descriptorCount = 1;
   bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+  bindings[4].binding = 4;
+  bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  bindings[4].descriptorCount = 1;
+  bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[5].binding = 5;
+  bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[5].descriptorCount = 1;
+  bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[6].binding = 6;
+  bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[6].descriptorCount = 1;
+  bindings[6].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[7].binding = 7;
+  bindings[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[7].descriptorCount = 1;
+  bindings[7].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[8].binding = 8;
+  bindings[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[8].descriptorCount = 1;
+  bindings[8].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[9] = bindings[8];
+  bindings[9].binding = 9;
+
+  bindings[10] = bindings[8];
+  bindings[10].binding = 10;
+
   VkDescriptorSetLayoutCreateInfo layout_info = { 0 };
   layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layout_info.bindingCount = 4;
+  layout_info.bindingCount = 11;
   layout_info.pBindings = bindings;
 
   if (vkCreateDescriptorSetLayout (context->device, &layout_info, NULL,
@@ -157,19 +660,21 @@ raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
                            "Failed to create descriptor set layout");
     }
 
-  VkDescriptorPoolSize pool_sizes[3] = { 0 };
+  VkDescriptorPoolSize pool_sizes[4] = { 0 };
   pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  pool_sizes[0].descriptorCount = 2;
+  pool_sizes[0].descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT;
   pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  pool_sizes[1].descriptorCount = 5;
+  pool_sizes[1].descriptorCount = 13 * MAX_FRAMES_IN_FLIGHT;
   pool_sizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-  pool_sizes[2].descriptorCount = 2;
+  pool_sizes[2].descriptorCount = 5 * MAX_FRAMES_IN_FLIGHT;
+  pool_sizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  pool_sizes[3].descriptorCount = 5 * MAX_FRAMES_IN_FLIGHT;
 
   VkDescriptorPoolCreateInfo pool_info = { 0 };
   pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  pool_info.poolSizeCount = 3;
+  pool_info.poolSizeCount = 4;
   pool_info.pPoolSizes = pool_sizes;
-  pool_info.maxSets = 2;
+  pool_info.maxSets = 4 * MAX_FRAMES_IN_FLIGHT;
 
   if (vkCreateDescriptorPool (context->device, &pool_info, NULL,
                               &raymarcher->descriptor_pool)
@@ -185,62 +690,104 @@ raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
   alloc_info.descriptorSetCount = 1;
   alloc_info.pSetLayouts = &raymarcher->descriptor_set_layout;
 
-  if (vkAllocateDescriptorSets (context->device, &alloc_info,
-                                &raymarcher->descriptor_set)
-      != VK_SUCCESS)
+  VkDescriptorImageInfo cone_depth_image_info = { 0 };
+  cone_depth_image_info.imageView = raymarcher->cone_depth.view;
+  cone_depth_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkDescriptorImageInfo reproject_image_info = { 0 };
+  reproject_image_info.imageView = raymarcher->reproject_depth.view;
+  reproject_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkDescriptorBufferInfo tile_counts_info;
+  VkDescriptorBufferInfo tile_indices_info;
+  raymarcher_tile_buffer_infos (raymarcher, &tile_counts_info,
+                                &tile_indices_info);
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-      return RESULT_ERROR (RESULT_ERROR_VULKAN,
-                           "Failed to allocate descriptor set");
-    }
-
-  VkDescriptorBufferInfo uniform_buffer_info = { 0 };
-  uniform_buffer_info.buffer = raymarcher->uniform_buffer.buffer;
-  uniform_buffer_info.offset = 0;
-  uniform_buffer_info.range = sizeof (raymarch_uniforms_t);
-
-  VkDescriptorImageInfo color_depth_image_info = { 0 };
-  color_depth_image_info.imageView = raymarcher->output_color_depth.view;
-  color_depth_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-  VkDescriptorImageInfo normal_image_info = { 0 };
-  normal_image_info.imageView = raymarcher->output_normal.view;
-  normal_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-  VkDescriptorBufferInfo sdf_buffer_info = { 0 };
-  sdf_buffer_info.buffer = raymarcher->sdf_objects_buffer.buffer;
-  sdf_buffer_info.offset = 0;
-  sdf_buffer_info.range = sizeof (sdf_object_t) * MAX_SDF_OBJECTS;
-
-  VkWriteDescriptorSet writes[4] = { 0 };
-  writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[0].dstSet = raymarcher->descriptor_set;
-  writes[0].dstBinding = 0;
-  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  writes[0].descriptorCount = 1;
-  writes[0].pBufferInfo = &uniform_buffer_info;
-
-  writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[1].dstSet = raymarcher->descriptor_set;
-  writes[1].dstBinding = 1;
-  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  writes[1].descriptorCount = 1;
-  writes[1].pImageInfo = &color_depth_image_info;
-
-  writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[2].dstSet = raymarcher->descriptor_set;
-  writes[2].dstBinding = 2;
-  writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-  writes[2].descriptorCount = 1;
-  writes[2].pBufferInfo = &sdf_buffer_info;
-
-  writes[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[3].dstSet = raymarcher->descriptor_set;
-  writes[3].dstBinding = 3;
-  writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  writes[3].descriptorCount = 1;
-  writes[3].pImageInfo = &normal_image_info;
-
-  vkUpdateDescriptorSets (context->device, 4, writes, 0, NULL);
+      raymarcher_frame_t *frame = &raymarcher->frames[i];
+      const raymarcher_frame_t *previous
+          = &raymarcher->frames[(i + MAX_FRAMES_IN_FLIGHT - 1)
+                                % MAX_FRAMES_IN_FLIGHT];
+
+      if (vkAllocateDescriptorSets (context->device, &alloc_info,
+                                    &frame->descriptor_set)
+          != VK_SUCCESS)
+        {
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to allocate descriptor set");
+        }
+
+      VkDescriptorBufferInfo uniform_buffer_info = { 0 };
+      uniform_buffer_info.buffer = frame->uniform_buffer.buffer;
+      uniform_buffer_info.offset = 0;
+      uniform_buffer_info.range = sizeof (raymarch_uniforms_t);
+
+      VkDescriptorImageInfo color_image_info = { 0 };
+      color_image_info.imageView = frame->output_color.view;
+      color_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkDescriptorImageInfo depth_image_info = { 0 };
+      depth_image_info.imageView = frame->output_depth.view;
+      depth_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkDescriptorImageInfo normal_image_info = { 0 };
+      normal_image_info.imageView = frame->output_normal.view;
+      normal_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkDescriptorImageInfo previous_depth_image_info = { 0 };
+      previous_depth_image_info.imageView = previous->output_depth.view;
+      previous_depth_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkWriteDescriptorSet writes[9] = { 0 };
+      writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[0].dstSet = frame->descriptor_set;
+      writes[0].dstBinding = 0;
+      writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      writes[0].descriptorCount = 1;
+      writes[0].pBufferInfo = &uniform_buffer_info;
+
+      writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[1].dstSet = frame->descriptor_set;
+      writes[1].dstBinding = 1;
+      writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      writes[1].descriptorCount = 1;
+      writes[1].pImageInfo = &color_image_info;
+
+      writes[2] = writes[1];
+      writes[2].dstBinding = 3;
+      writes[2].pImageInfo = &normal_image_info;
+
+      writes[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[3].dstSet = frame->descriptor_set;
+      writes[3].dstBinding = 5;
+      writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[3].descriptorCount = 1;
+      writes[3].pBufferInfo = &tile_counts_info;
+
+      writes[4] = writes[3];
+      writes[4].dstBinding = 6;
+      writes[4].pBufferInfo = &tile_indices_info;
+
+      writes[5] = writes[1];
+      writes[5].dstBinding = 7;
+      writes[5].pImageInfo = &cone_depth_image_info;
+
+      writes[6] = writes[1];
+      writes[6].dstBinding = 8;
+      writes[6].pImageInfo = &reproject_image_info;
+
+      writes[7] = writes[1];
+      writes[7].dstBinding = 9;
+      writes[7].pImageInfo = &depth_image_info;
+
+      writes[8] = writes[1];
+      writes[8].dstBinding = 10;
+      writes[8].pImageInfo = &previous_depth_image_info;
+
+      vkUpdateDescriptorSets (context->device, 9, writes, 0, NULL);
+    }
+  raymarcher_bind_sdf_buffer (raymarcher);
 
   VkPipelineLayoutCreateInfo pipeline_layout_info = { 0 };
   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -255,190 +802,1178 @@ raymarcher_create (vulkan_context_t *context, uint32_t width, uint32_t height,
                            "Failed to create pipeline layout");
     }
 
-  VkCommandBufferAllocateInfo cmd_alloc_info = { 0 };
-  cmd_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  cmd_alloc_info.commandPool = context->compute_command_pool;
-  cmd_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  cmd_alloc_info.commandBufferCount = 1;
+  return RESULT_SUCCESS;
+}
 
-  if (vkAllocateCommandBuffers (context->device, &cmd_alloc_info,
-                                &raymarcher->compute_command_buffer)
-      != VK_SUCCESS)
+void
+raymarcher_destroy (raymarcher_t *raymarcher)
+{
+  if (!raymarcher || !raymarcher->vk_context)
+    return;
+
+  vulkan_context_t *context = raymarcher->vk_context;
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    raymarcher_destroy_frame (context, &raymarcher->frames[i]);
+  if (raymarcher->compute_pipeline)
+    vkDestroyPipeline (context->device, raymarcher->compute_pipeline, NULL);
+  if (raymarcher->pipeline_layout)
+    vkDestroyPipelineLayout (context->device, raymarcher->pipeline_layout,
+                             NULL);
+  if (raymarcher->descriptor_pool)
+    vkDestroyDescriptorPool (context->device, raymarcher->descriptor_pool,
+                             NULL);
+  if (raymarcher->descriptor_set_layout)
+    vkDestroyDescriptorSetLayout (context->device,
+                                  raymarcher->descriptor_set_layout, NULL);
+  if (raymarcher->compute_shader)
+    vkDestroyShaderModule (context->device, raymarcher->compute_shader, NULL);
+  if (raymarcher->cone_pipeline)
+    vkDestroyPipeline (context->device, raymarcher->cone_pipeline, NULL);
+  if (raymarcher->cone_shader)
+    vkDestroyShaderModule (context->device, raymarcher->cone_shader, NULL);
+  if (raymarcher->cone_depth.image)
+    gpu_image_destroy (context, &raymarcher->cone_depth);
+  if (raymarcher->reproject_pipeline)
+    vkDestroyPipeline (context->device, raymarcher->reproject_pipeline, NULL);
+  if (raymarcher->reproject_shader)
+    vkDestroyShaderModule (context->device, raymarcher->reproject_shader,
+                           NULL);
+  if (raymarcher->reproject_depth.image)
+    gpu_image_destroy (context, &raymarcher->reproject_depth);
+
+  if (raymarcher->sdf_objects_buffer.buffer)
+    gpu_buffer_destroy (context, &raymarcher->sdf_objects_buffer);
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-      return RESULT_ERROR (RESULT_ERROR_VULKAN,
-                           "Failed to allocate command buffer");
+      mem_free (raymarcher->sdf_shadow[i]);
+      mem_free (raymarcher->sdf_node_shadow[i]);
+    }
+  if (raymarcher->tile_buffer.buffer)
+    gpu_buffer_destroy (context, &raymarcher->tile_buffer);
+  if (raymarcher->tile_cull_shader)
+    vkDestroyShaderModule (context->device, raymarcher->tile_cull_shader,
+                           NULL);
+  if (raymarcher->tile_cull_pipeline)
+    vkDestroyPipeline (context->device, raymarcher->tile_cull_pipeline, NULL);
+  if (raymarcher->tile_cull_pipeline_layout)
+    vkDestroyPipelineLayout (context->device,
+                             raymarcher->tile_cull_pipeline_layout, NULL);
+  if (raymarcher->tile_cull_descriptor_set_layout)
+    vkDestroyDescriptorSetLayout (
+        context->device, raymarcher->tile_cull_descriptor_set_layout, NULL);
+  if (raymarcher->lighting_shader)
+    vkDestroyShaderModule (context->device, raymarcher->lighting_shader, NULL);
+  if (raymarcher->lighting_pipeline)
+    vkDestroyPipeline (context->device, raymarcher->lighting_pipeline, NULL);
+  if (raymarcher->shadow_ao_pipeline)
+    vkDestroyPipeline (context->device, raymarcher->shadow_ao_pipeline, NULL);
+  if (raymarcher->shadow_ao_shader)
+    vkDestroyShaderModule (context->device, raymarcher->shadow_ao_shader,
+                           NULL);
+  if (raymarcher->shadow_ao.image)
+    gpu_image_destroy (context, &raymarcher->shadow_ao);
+  if (raymarcher->shadow_ao_history.image)
+    gpu_image_destroy (context, &raymarcher->shadow_ao_history);
+  if (raymarcher->lighting_pipeline_layout)
+    vkDestroyPipelineLayout (context->device,
+                             raymarcher->lighting_pipeline_layout, NULL);
+  if (raymarcher->lighting_descriptor_set_layout)
+    vkDestroyDescriptorSetLayout (
+        context->device, raymarcher->lighting_descriptor_set_layout, NULL);
+  if (raymarcher->overlay_shader)
+    vkDestroyShaderModule (context->device, raymarcher->overlay_shader, NULL);
+  if (raymarcher->overlay_pipeline)
+    vkDestroyPipeline (context->device, raymarcher->overlay_pipeline, NULL);
+  if (raymarcher->overlay_pipeline_layout)
+    vkDestroyPipelineLayout (context->device,
+                             raymarcher->overlay_pipeline_layout, NULL);
+  if (raymarcher->overlay_descriptor_set_layout)
+    vkDestroyDescriptorSetLayout (
+        context->device, raymarcher->overlay_descriptor_set_layout, NULL);
+}
+
+typedef struct
+{
+  raymarch_quality_t quality;
+  uint32_t shape_mask;
+} raymarch_specialization_t;
+
+#define QUALITY_CONSTANT(id, field, type)                                     \
+  { id, offsetof (raymarch_specialization_t, quality.field), sizeof (type) }
+
+/* constant_id N in shaders/common/scene_constants.glsl is field N. */
+static const VkSpecializationMapEntry quality_constants[] = {
+  QUALITY_CONSTANT (0, max_steps, int32_t),
+  QUALITY_CONSTANT (1, max_shadow_steps, int32_t),
+  QUALITY_CONSTANT (2, ao_samples, int32_t),
+  QUALITY_CONSTANT (3, reflection_max_steps, int32_t),
+  QUALITY_CONSTANT (4, ao_enabled, VkBool32),
+  QUALITY_CONSTANT (5, hard_shadows_enabled, VkBool32),
+  QUALITY_CONSTANT (6, reflection_enabled, VkBool32),
+  QUALITY_CONSTANT (7, fade_enabled, VkBool32),
+  QUALITY_CONSTANT (8, noise_enabled, VkBool32),
+  QUALITY_CONSTANT (9, near_light_enabled, VkBool32),
+  { 10, offsetof (raymarch_specialization_t, shape_mask), sizeof (uint32_t) },
+};
+
+#undef QUALITY_CONSTANT
+
+raymarch_quality_t
+raymarch_quality_from_preset (raymarch_quality_preset_t preset)
+{
+  raymarch_quality_t quality = { 0 };
+  quality.max_steps = 128;
+  quality.max_shadow_steps = 27;
+  quality.ao_samples = 6;
+  quality.reflection_max_steps = 32;
+  quality.ao_enabled = VK_TRUE;
+  quality.hard_shadows_enabled = VK_TRUE;
+  quality.reflection_enabled = VK_FALSE;
+  quality.fade_enabled = VK_TRUE;
+  quality.noise_enabled = VK_TRUE;
+  quality.near_light_enabled = VK_FALSE;
+
+  switch (preset)
+    {
+    case RAYMARCH_QUALITY_LOW:
+      quality.max_steps = 64;
+      quality.max_shadow_steps = 12;
+      quality.ao_enabled = VK_FALSE;
+      quality.noise_enabled = VK_FALSE;
+      break;
+    case RAYMARCH_QUALITY_MEDIUM:
+      quality.max_steps = 96;
+      quality.max_shadow_steps = 20;
+      quality.ao_samples = 3;
+      break;
+    case RAYMARCH_QUALITY_ULTRA:
+      quality.max_steps = 256;
+      quality.max_shadow_steps = 48;
+      quality.ao_samples = 8;
+      quality.reflection_enabled = VK_TRUE;
+      break;
+    default:
+      break;
     }
 
-  VkFenceCreateInfo fence_info = { 0 };
-  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+  return quality;
+}
+
+static VkResult
+raymarcher_create_pipeline (raymarcher_t *raymarcher, VkShaderModule module,
+                            VkPipelineLayout layout, VkPipeline *out_pipeline)
+{
+  raymarch_specialization_t data = { 0 };
+  data.quality = raymarcher->quality;
+  data.shape_mask = raymarcher->shape_mask;
+
+  VkSpecializationInfo specialization = { 0 };
+  specialization.mapEntryCount
+      = sizeof (quality_constants) / sizeof (quality_constants[0]);
+  specialization.pMapEntries = quality_constants;
+  specialization.dataSize = sizeof (data);
+  specialization.pData = &data;
+
+  VkComputePipelineCreateInfo pipeline_info = { 0 };
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage.sType
+      = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = module;
+  pipeline_info.stage.pName = "main";
+  pipeline_info.stage.pSpecializationInfo = &specialization;
+  pipeline_info.layout = layout;
+
+  return vkCreateComputePipelines (raymarcher->vk_context->device,
+                                   raymarcher->vk_context->pipeline_cache, 1,
+                                   &pipeline_info, NULL, out_pipeline);
+}
+
+/* Recreates every pipeline that evaluates the scene with the current
+   specialization data, then swaps them in once no frame uses the old ones.
+   Leaves the old pipelines in place if any variant fails. */
+static result_t
+raymarcher_rebuild_variants (raymarcher_t *raymarcher)
+{
+  struct
+  {
+    VkShaderModule module;
+    VkPipelineLayout layout;
+    VkPipeline *pipeline;
+  } variants[] = {
+    { raymarcher->compute_shader, raymarcher->pipeline_layout,
+      &raymarcher->compute_pipeline },
+    { raymarcher->cone_shader, raymarcher->pipeline_layout,
+      &raymarcher->cone_pipeline },
+    { raymarcher->lighting_shader, raymarcher->lighting_pipeline_layout,
+      &raymarcher->lighting_pipeline },
+    { raymarcher->shadow_ao_shader, raymarcher->lighting_pipeline_layout,
+      &raymarcher->shadow_ao_pipeline },
+  };
+  uint32_t variant_count = sizeof (variants) / sizeof (variants[0]);
+
+  VkPipeline pipelines[sizeof (variants) / sizeof (variants[0])] = { 0 };
+  for (uint32_t i = 0; i < variant_count; i++)
+    {
+      if (!variants[i].module || !*variants[i].pipeline)
+        continue;
+
+      if (raymarcher_create_pipeline (raymarcher, variants[i].module,
+                                      variants[i].layout, &pipelines[i])
+          != VK_SUCCESS)
+        {
+          for (uint32_t j = 0; j < i; j++)
+            if (pipelines[j])
+              vkDestroyPipeline (raymarcher->vk_context->device,
+                                 pipelines[j], NULL);
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to create pipeline variant");
+        }
+    }
+
+  /* Frames in flight may still be running the old variants. */
+  raymarcher_wait_all_frames (raymarcher);
+
+  for (uint32_t i = 0; i < variant_count; i++)
+    {
+      if (!pipelines[i])
+        continue;
+      vkDestroyPipeline (raymarcher->vk_context->device, *variants[i].pipeline,
+                         NULL);
+      *variants[i].pipeline = pipelines[i];
+    }
+
+  /* The accumulated history was traced with the old variants. */
+  raymarcher->history_valid = false;
+  raymarcher->shadow_history_valid = false;
+
+  return RESULT_SUCCESS;
+}
+
+result_t
+raymarcher_set_quality (raymarcher_t *raymarcher,
+                        const raymarch_quality_t *quality)
+{
+  if (memcmp (&raymarcher->quality, quality, sizeof (*quality)) == 0)
+    return RESULT_SUCCESS;
+
+  raymarch_quality_t previous = raymarcher->quality;
+  raymarcher->quality = *quality;
+
+  result_t result = raymarcher_rebuild_variants (raymarcher);
+  if (result.code != RESULT_OK)
+    raymarcher->quality = previous;
+  return result;
+}
+
+result_t
+raymarcher_set_shape_mask (raymarcher_t *raymarcher, uint32_t shape_mask)
+{
+  if (raymarcher->shape_mask == shape_mask)
+    return RESULT_SUCCESS;
+
+  uint32_t previous = raymarcher->shape_mask;
+  raymarcher->shape_mask = shape_mask;
+
+  result_t result = raymarcher_rebuild_variants (raymarcher);
+  if (result.code != RESULT_OK)
+    raymarcher->shape_mask = previous;
+  return result;
+}
+
+result_t
+raymarcher_reload_shader (raymarcher_t *raymarcher, raymarch_shader_t shader,
+                          const char *shader_path)
+{
+  VkShaderModule *module = NULL;
+  VkPipeline *pipeline = NULL;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+
+  switch (shader)
+    {
+    case RAYMARCH_SHADER_RAYMARCH:
+      module = &raymarcher->compute_shader;
+      pipeline = &raymarcher->compute_pipeline;
+      layout = raymarcher->pipeline_layout;
+      break;
+    case RAYMARCH_SHADER_CONE:
+      module = &raymarcher->cone_shader;
+      pipeline = &raymarcher->cone_pipeline;
+      layout = raymarcher->pipeline_layout;
+      break;
+    case RAYMARCH_SHADER_REPROJECT:
+      module = &raymarcher->reproject_shader;
+      pipeline = &raymarcher->reproject_pipeline;
+      layout = raymarcher->pipeline_layout;
+      break;
+    case RAYMARCH_SHADER_TILE_CULL:
+      module = &raymarcher->tile_cull_shader;
+      pipeline = &raymarcher->tile_cull_pipeline;
+      layout = raymarcher->tile_cull_pipeline_layout;
+      break;
+    case RAYMARCH_SHADER_LIGHTING:
+      module = &raymarcher->lighting_shader;
+      pipeline = &raymarcher->lighting_pipeline;
+      layout = raymarcher->lighting_pipeline_layout;
+      break;
+    case RAYMARCH_SHADER_SHADOW_AO:
+      module = &raymarcher->shadow_ao_shader;
+      pipeline = &raymarcher->shadow_ao_pipeline;
+      layout = raymarcher->lighting_pipeline_layout;
+      break;
+    case RAYMARCH_SHADER_OVERLAY:
+      module = &raymarcher->overlay_shader;
+      pipeline = &raymarcher->overlay_pipeline;
+      layout = raymarcher->overlay_pipeline_layout;
+      break;
+    default:
+      break;
+    }
+
+  if (!module || !*module || !*pipeline)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Shader pass was never loaded");
+    }
+
+  size_t code_size;
+  char *code = read_file (shader_path, &code_size);
+  if (!code)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to load shader");
+    }
+
+  VkShaderModuleCreateInfo create_info = { 0 };
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = code_size;
+  create_info.pCode = (const uint32_t *)code;
+
+  VkShaderModule new_module = VK_NULL_HANDLE;
+  VkResult vk_result = vkCreateShaderModule (raymarcher->vk_context->device,
+                                             &create_info, NULL, &new_module);
+  mem_free (code);
+  if (vk_result != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
+                           "Failed to create shader module");
+    }
+
+  VkPipeline new_pipeline = VK_NULL_HANDLE;
+  if (raymarcher_create_pipeline (raymarcher, new_module, layout,
+                                  &new_pipeline)
+      != VK_SUCCESS)
+    {
+      vkDestroyShaderModule (raymarcher->vk_context->device, new_module,
+                             NULL);
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create compute pipeline");
+    }
+
+  raymarcher_wait_all_frames (raymarcher);
+
+  vkDestroyPipeline (raymarcher->vk_context->device, *pipeline, NULL);
+  vkDestroyShaderModule (raymarcher->vk_context->device, *module, NULL);
+  *pipeline = new_pipeline;
+  *module = new_module;
+
+  raymarcher->history_valid = false;
+  raymarcher->shadow_history_valid = false;
+
+  return RESULT_SUCCESS;
+}
+
+result_t
+raymarcher_load_shader (raymarcher_t *raymarcher, const char *shader_path)
+{
+  size_t code_size;
+  char *code = read_file (shader_path, &code_size);
+  if (!code)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to load shader");
+    }
+
+  VkShaderModuleCreateInfo create_info = { 0 };
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = code_size;
+  create_info.pCode = (const uint32_t *)code;
+
+  if (vkCreateShaderModule (raymarcher->vk_context->device, &create_info, NULL,
+                            &raymarcher->compute_shader)
+      != VK_SUCCESS)
+    {
+      mem_free (code);
+      return RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
+                           "Failed to create shader module");
+    }
+
+  mem_free (code);
+
+  if (raymarcher_create_pipeline (raymarcher, raymarcher->compute_shader,
+                                  raymarcher->pipeline_layout,
+                                  &raymarcher->compute_pipeline)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create compute pipeline");
+    }
+
+  return RESULT_SUCCESS;
+}
+
+static result_t
+raymarcher_load_compute_variant (raymarcher_t *raymarcher,
+                                 const char *shader_path,
+                                 VkPipelineLayout layout,
+                                 VkShaderModule *out_shader,
+                                 VkPipeline *out_pipeline)
+{
+  size_t code_size;
+  char *code = read_file (shader_path, &code_size);
+  if (!code)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to load shader");
+    }
+
+  VkShaderModuleCreateInfo create_info = { 0 };
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = code_size;
+  create_info.pCode = (const uint32_t *)code;
+
+  if (vkCreateShaderModule (raymarcher->vk_context->device, &create_info, NULL,
+                            out_shader)
+      != VK_SUCCESS)
+    {
+      mem_free (code);
+      return RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
+                           "Failed to create shader module");
+    }
+
+  mem_free (code);
+
+  if (raymarcher_create_pipeline (raymarcher, *out_shader, layout,
+                                  out_pipeline)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create compute pipeline");
+    }
+
+  return RESULT_SUCCESS;
+}
+
+result_t
+raymarcher_load_cone_shader (raymarcher_t *raymarcher, const char *shader_path)
+{
+  return raymarcher_load_compute_variant (raymarcher, shader_path,
+                                          raymarcher->pipeline_layout,
+                                          &raymarcher->cone_shader,
+                                          &raymarcher->cone_pipeline);
+}
+
+result_t
+raymarcher_load_reproject_shader (raymarcher_t *raymarcher,
+                                  const char *shader_path)
+{
+  return raymarcher_load_compute_variant (raymarcher, shader_path,
+                                          raymarcher->pipeline_layout,
+                                          &raymarcher->reproject_shader,
+                                          &raymarcher->reproject_pipeline);
+}
+
+result_t
+raymarcher_load_tile_cull_shader (raymarcher_t *raymarcher,
+                                  const char *shader_path)
+{
+  size_t code_size;
+  char *code = read_file (shader_path, &code_size);
+  if (!code)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to load tile cull shader");
+    }
+
+  VkShaderModuleCreateInfo create_info = { 0 };
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = code_size;
+  create_info.pCode = (const uint32_t *)code;
+
+  if (vkCreateShaderModule (raymarcher->vk_context->device, &create_info, NULL,
+                            &raymarcher->tile_cull_shader)
+      != VK_SUCCESS)
+    {
+      mem_free (code);
+      return RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
+                           "Failed to create tile cull shader module");
+    }
+
+  mem_free (code);
+
+  VkDescriptorSetLayoutBinding bindings[4] = { 0 };
+
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[2].binding = 2;
+  bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[2].descriptorCount = 1;
+  bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[3].binding = 3;
+  bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[3].descriptorCount = 1;
+  bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = { 0 };
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = 4;
+  layout_info.pBindings = bindings;
+
+  if (vkCreateDescriptorSetLayout (
+          raymarcher->vk_context->device, &layout_info, NULL,
+          &raymarcher->tile_cull_descriptor_set_layout)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create tile cull descriptor set layout");
+    }
+
+  VkDescriptorSetAllocateInfo alloc_info = { 0 };
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = raymarcher->descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &raymarcher->tile_cull_descriptor_set_layout;
+
+  VkDescriptorBufferInfo tile_counts_info;
+  VkDescriptorBufferInfo tile_indices_info;
+  raymarcher_tile_buffer_infos (raymarcher, &tile_counts_info,
+                                &tile_indices_info);
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      raymarcher_frame_t *frame = &raymarcher->frames[i];
+
+      if (vkAllocateDescriptorSets (raymarcher->vk_context->device,
+                                    &alloc_info,
+                                    &frame->tile_cull_descriptor_set)
+          != VK_SUCCESS)
+        {
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to allocate tile cull descriptor set");
+        }
+
+      VkDescriptorBufferInfo uniform_buffer_info = { 0 };
+      uniform_buffer_info.buffer = frame->uniform_buffer.buffer;
+      uniform_buffer_info.offset = 0;
+      uniform_buffer_info.range = sizeof (raymarch_uniforms_t);
+
+      VkWriteDescriptorSet writes[3] = { 0 };
+      writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[0].dstSet = frame->tile_cull_descriptor_set;
+      writes[0].dstBinding = 0;
+      writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      writes[0].descriptorCount = 1;
+      writes[0].pBufferInfo = &uniform_buffer_info;
+
+      writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[1].dstSet = frame->tile_cull_descriptor_set;
+      writes[1].dstBinding = 2;
+      writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[1].descriptorCount = 1;
+      writes[1].pBufferInfo = &tile_counts_info;
+
+      writes[2] = writes[1];
+      writes[2].dstBinding = 3;
+      writes[2].pBufferInfo = &tile_indices_info;
+
+      vkUpdateDescriptorSets (raymarcher->vk_context->device, 3, writes, 0,
+                              NULL);
+    }
+  raymarcher_bind_sdf_buffer (raymarcher);
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info = { 0 };
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts
+      = &raymarcher->tile_cull_descriptor_set_layout;
+
+  if (vkCreatePipelineLayout (raymarcher->vk_context->device,
+                              &pipeline_layout_info, NULL,
+                              &raymarcher->tile_cull_pipeline_layout)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create tile cull pipeline layout");
+    }
+
+  if (raymarcher_create_pipeline (raymarcher, raymarcher->tile_cull_shader,
+                                  raymarcher->tile_cull_pipeline_layout,
+                                  &raymarcher->tile_cull_pipeline)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create tile cull compute pipeline");
+    }
+
+  return RESULT_SUCCESS;
+}
+
+static void
+raymarcher_cmd_tile_cull (raymarcher_t *raymarcher, VkCommandBuffer cmd,
+                          uint32_t sdf_offset)
+{
+  vkCmdFillBuffer (cmd, raymarcher->tile_buffer.buffer, 0,
+                   raymarcher->tile_indices_offset, 0);
+
+  VkBufferMemoryBarrier barrier = { 0 };
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask
+      = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = raymarcher->tile_buffer.buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1,
+                        &barrier, 0, NULL);
+
+  const raymarcher_frame_t *frame = raymarcher_current_frame (raymarcher);
+  uint32_t slot = frame->sdf_slot;
+  uint32_t bounded_count = 0;
+  if (raymarcher->sdf_header_shadow_valid[slot])
+    {
+      bounded_count = raymarcher->sdf_header_shadow[slot][0]
+                      - raymarcher->sdf_header_shadow[slot][1];
+    }
+
+  if (bounded_count > 0)
+    {
+      vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                         raymarcher->tile_cull_pipeline);
+      vkCmdBindDescriptorSets (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                               raymarcher->tile_cull_pipeline_layout, 0, 1,
+                               &frame->tile_cull_descriptor_set, 1,
+                               &sdf_offset);
+      vkCmdDispatch (cmd, (bounded_count + 63) / 64, 1, 1);
+    }
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1,
+                        &barrier, 0, NULL);
+}
+
+static void
+raymarcher_cmd_reproject (raymarcher_t *raymarcher, VkCommandBuffer cmd)
+{
+  VkImageSubresourceRange range = { 0 };
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = 1;
+  range.layerCount = 1;
+
+  VkClearColorValue empty = { 0 };
+  empty.uint32[0] = UINT32_MAX;
+  vkCmdClearColorImage (cmd, raymarcher->reproject_depth.image,
+                        VK_IMAGE_LAYOUT_GENERAL, &empty, 1, &range);
+
+  VkImageMemoryBarrier barrier = { 0 };
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask
+      = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = raymarcher->reproject_depth.image;
+  barrier.subresourceRange = range;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                        NULL, 1, &barrier);
+
+  vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                     raymarcher->reproject_pipeline);
+  vkCmdDispatch (cmd, (raymarcher->render_width + 7) / 8,
+                 (raymarcher->render_height + 7) / 8, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                        NULL, 1, &barrier);
+}
+
+static void
+raymarcher_cmd_cone_prepass (raymarcher_t *raymarcher, VkCommandBuffer cmd)
+{
+  vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                     raymarcher->cone_pipeline);
+
+  uint32_t block_count_x
+      = (raymarcher->render_width + RAYMARCH_CONE_BLOCK_SIZE - 1)
+        / RAYMARCH_CONE_BLOCK_SIZE;
+  uint32_t block_count_y
+      = (raymarcher->render_height + RAYMARCH_CONE_BLOCK_SIZE - 1)
+        / RAYMARCH_CONE_BLOCK_SIZE;
+  vkCmdDispatch (cmd, (block_count_x + 7) / 8, (block_count_y + 7) / 8, 1);
+
+  VkImageMemoryBarrier barrier = { 0 };
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = raymarcher->cone_depth.image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                        NULL, 1, &barrier);
+}
+
+result_t
+raymarcher_upload_sdf_objects (raymarcher_t *raymarcher,
+                               const sdf_object_t *objects, uint32_t count,
+                               uint32_t unbounded_count,
+                               const sdf_bvh_node_t *nodes,
+                               uint32_t node_count)
+{
+  if (!raymarcher || (!objects && count > 0) || (!nodes && node_count > 0)
+      || unbounded_count > count)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Invalid parameters");
+    }
+
+  uint32_t required = count > node_count / 2 ? count : node_count / 2 + 1;
+  if (required > raymarcher->max_objects)
+    {
+      result_t result = raymarcher_grow_sdf_buffer (raymarcher, required);
+      if (result.code != RESULT_OK)
+        return result;
+    }
+
+  /* Each frame writes its own slot; a frame that skipped its upload may
+     still be reading this one. */
+  uint32_t slot = raymarcher->frame_index;
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      if (i != slot && raymarcher->frames[i].sdf_slot == slot)
+        vkWaitForFences (raymarcher->vk_context->device, 1,
+                         &raymarcher->frames[i].fence, VK_TRUE, UINT64_MAX);
+    }
+  raymarcher->sdf_frame_slot = slot;
+  VkDeviceSize slot_offset = slot * raymarcher->sdf_slot_size;
+  gpu_buffer_t *buffer = &raymarcher->sdf_objects_buffer;
+
+  bool changed = false;
+
+  uint32_t header[SDF_BUFFER_HEADER_SIZE / sizeof (uint32_t)]
+      = { count, unbounded_count, node_count, 0 };
+  changed |= upload_dirty_elements (
+      buffer, slot_offset, raymarcher->sdf_header_shadow[slot],
+      raymarcher->sdf_header_shadow_valid[slot] ? 1 : 0, header, 1,
+      sizeof (header));
+  raymarcher->sdf_header_shadow_valid[slot] = true;
+
+  changed |= upload_dirty_elements (
+      buffer, slot_offset + SDF_BUFFER_HEADER_SIZE,
+      raymarcher->sdf_shadow[slot], raymarcher->sdf_shadow_count[slot],
+      objects, count, sizeof (sdf_object_t));
+  raymarcher->sdf_shadow_count[slot] = count;
+
+  changed |= upload_dirty_elements (
+      buffer, slot_offset + raymarcher->sdf_nodes_offset,
+      raymarcher->sdf_node_shadow[slot],
+      raymarcher->sdf_node_shadow_count[slot], nodes, node_count,
+      sizeof (sdf_bvh_node_t));
+  raymarcher->sdf_node_shadow_count[slot] = node_count;
+
+  /* Moved objects make last frame's depth unsafe as a march seed, and
+     its shadows wrong. */
+  if (changed)
+    {
+      raymarcher->history_valid = false;
+      raymarcher->shadow_history_valid = false;
+    }
+
+  return RESULT_SUCCESS;
+}
+
+static void
+raymarcher_cmd_frame_barrier (VkCommandBuffer cmd)
+{
+  /* Tile lists, cone depth and shadow history are shared by all frames in
+     flight, and reprojection reads the previous frame's depth. Every
+     transfer inside a frame is already followed by a barrier into the
+     compute stage, so waiting on compute covers it without also waiting
+     on a present blit that may still be blocked on the compute queue. */
+  VkMemoryBarrier barrier = { 0 };
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+                          | VK_ACCESS_SHADER_WRITE_BIT
+                          | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                            | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+static VkCommandBuffer
+raymarcher_lighting_command_buffer (const raymarcher_t *raymarcher,
+                                    const raymarcher_frame_t *frame)
+{
+  return raymarcher->async_compute ? frame->compute_command_buffer
+                                   : frame->command_buffer;
+}
+
+/* Hands output_final from the compute queue to the graphics queue for the
+   present blit: the release ends the compute command buffer, the acquire
+   starts the present one. */
+static void
+raymarcher_cmd_transfer_final (const raymarcher_t *raymarcher,
+                               const raymarcher_frame_t *frame, bool release)
+{
+  VkImageMemoryBarrier barrier = { 0 };
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = raymarcher->vk_context->compute_family;
+  barrier.dstQueueFamilyIndex = raymarcher->vk_context->graphics_family;
+  barrier.image = frame->output_final.image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+
+  if (release)
+    {
+      barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      vkCmdPipelineBarrier (frame->compute_command_buffer,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL,
+                            0, NULL, 1, &barrier);
+    }
+  else
+    {
+      /* The present submission waits on lighting_finished at the transfer
+         stage, which this barrier chains to. */
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      vkCmdPipelineBarrier (frame->present_command_buffer,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
+                            NULL, 1, &barrier);
+    }
+}
+
+void
+raymarcher_begin_frame (raymarcher_t *raymarcher)
+{
+  if (!raymarcher || raymarcher->frame_open)
+    return;
+
+  raymarcher->frame_index
+      = (raymarcher->frame_index + 1) % MAX_FRAMES_IN_FLIGHT;
+  raymarcher->frame_open = true;
+
+  raymarcher_frame_t *frame = raymarcher_current_frame (raymarcher);
+
+  /* The fence is reset by the submission that signals it again. */
+  vkWaitForFences (raymarcher->vk_context->device, 1, &frame->fence,
+                   VK_TRUE, UINT64_MAX);
+
+  VkCommandBufferBeginInfo begin_info = { 0 };
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer (frame->command_buffer, &begin_info);
+  raymarcher_cmd_frame_barrier (frame->command_buffer);
 
-  if (vkCreateFence (context->device, &fence_info, NULL,
-                     &raymarcher->compute_fence)
-      != VK_SUCCESS)
+  frame->lighting_recorded = false;
+  if (raymarcher->async_compute)
     {
-      return RESULT_ERROR (RESULT_ERROR_VULKAN, "Failed to create fence");
+      vkBeginCommandBuffer (frame->compute_command_buffer, &begin_info);
+      raymarcher_cmd_frame_barrier (frame->compute_command_buffer);
+      vkBeginCommandBuffer (frame->present_command_buffer, &begin_info);
     }
-
-  return RESULT_SUCCESS;
 }
 
-void
-raymarcher_destroy (raymarcher_t *raymarcher)
+VkCommandBuffer
+raymarcher_get_command_buffer (const raymarcher_t *raymarcher)
 {
-  if (!raymarcher || !raymarcher->vk_context)
-    return;
+  const raymarcher_frame_t *frame
+      = &raymarcher->frames[raymarcher->frame_index];
+  return raymarcher->async_compute ? frame->present_command_buffer
+                                   : frame->command_buffer;
+}
 
+static result_t
+raymarcher_submit_async (raymarcher_t *raymarcher, raymarcher_frame_t *frame,
+                         VkSemaphore wait_semaphore,
+                         VkSemaphore signal_semaphore)
+{
   vulkan_context_t *context = raymarcher->vk_context;
 
-  if (raymarcher->compute_fence)
-    vkDestroyFence (context->device, raymarcher->compute_fence, NULL);
-  if (raymarcher->compute_pipeline)
-    vkDestroyPipeline (context->device, raymarcher->compute_pipeline, NULL);
-  if (raymarcher->pipeline_layout)
-    vkDestroyPipelineLayout (context->device, raymarcher->pipeline_layout,
-                             NULL);
-  if (raymarcher->descriptor_pool)
-    vkDestroyDescriptorPool (context->device, raymarcher->descriptor_pool,
-                             NULL);
-  if (raymarcher->descriptor_set_layout)
-    vkDestroyDescriptorSetLayout (context->device,
-                                  raymarcher->descriptor_set_layout, NULL);
-  if (raymarcher->compute_shader)
-    vkDestroyShaderModule (context->device, raymarcher->compute_shader, NULL);
+  VkSemaphore present_waits[2];
+  VkPipelineStageFlags present_stages[2] = { VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                             VK_PIPELINE_STAGE_TRANSFER_BIT };
+  uint32_t present_wait_count = 0;
+  if (frame->lighting_recorded)
+    present_waits[present_wait_count++] = frame->lighting_finished;
+  if (wait_semaphore)
+    present_waits[present_wait_count++] = wait_semaphore;
+
+  VkSubmitInfo present_submit = { 0 };
+  present_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  present_submit.waitSemaphoreCount = present_wait_count;
+  present_submit.pWaitSemaphores = present_waits;
+  present_submit.pWaitDstStageMask = present_stages;
+  present_submit.commandBufferCount = 1;
+  present_submit.pCommandBuffers = &frame->present_command_buffer;
+  present_submit.signalSemaphoreCount = signal_semaphore ? 1 : 0;
+  present_submit.pSignalSemaphores = &signal_semaphore;
+
+  vkResetFences (context->device, 1, &frame->fence);
+
+  if (!frame->lighting_recorded)
+    {
+      /* Nothing for the compute queue, so the raymarch and the blit go
+         out as one batch. */
+      VkCommandBuffer buffers[2]
+          = { frame->command_buffer, frame->present_command_buffer };
+      present_submit.commandBufferCount = 2;
+      present_submit.pCommandBuffers = buffers;
+
+      if (vkQueueSubmit (context->graphics_queue, 1, &present_submit,
+                         frame->fence)
+          != VK_SUCCESS)
+        {
+          gpu_timer_abort_frame (raymarcher->gpu_timer);
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to submit frame commands");
+        }
+      return RESULT_SUCCESS;
+    }
 
-  if (raymarcher->uniform_buffer.buffer)
-    gpu_buffer_destroy (context, &raymarcher->uniform_buffer);
-  if (raymarcher->sdf_objects_buffer.buffer)
-    gpu_buffer_destroy (context, &raymarcher->sdf_objects_buffer);
-  if (raymarcher->output_color_depth.image)
-    gpu_image_destroy (context, &raymarcher->output_color_depth);
-  if (raymarcher->output_normal.image)
-    gpu_image_destroy (context, &raymarcher->output_normal);
-  if (raymarcher->output_final.image)
-    gpu_image_destroy (context, &raymarcher->output_final);
-  if (raymarcher->lighting_uniform_buffer.buffer)
-    gpu_buffer_destroy (context, &raymarcher->lighting_uniform_buffer);
-  if (raymarcher->lighting_shader)
-    vkDestroyShaderModule (context->device, raymarcher->lighting_shader, NULL);
-  if (raymarcher->lighting_pipeline)
-    vkDestroyPipeline (context->device, raymarcher->lighting_pipeline, NULL);
-  if (raymarcher->lighting_pipeline_layout)
-    vkDestroyPipelineLayout (context->device,
-                             raymarcher->lighting_pipeline_layout, NULL);
-  if (raymarcher->lighting_descriptor_set_layout)
-    vkDestroyDescriptorSetLayout (
-        context->device, raymarcher->lighting_descriptor_set_layout, NULL);
+  VkSubmitInfo raymarch_submit = { 0 };
+  raymarch_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  raymarch_submit.commandBufferCount = 1;
+  raymarch_submit.pCommandBuffers = &frame->command_buffer;
+  raymarch_submit.signalSemaphoreCount = 1;
+  raymarch_submit.pSignalSemaphores = &frame->raymarch_finished;
+
+  VkPipelineStageFlags compute_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  VkSubmitInfo compute_submit = { 0 };
+  compute_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  compute_submit.waitSemaphoreCount = 1;
+  compute_submit.pWaitSemaphores = &frame->raymarch_finished;
+  compute_submit.pWaitDstStageMask = &compute_stage;
+  compute_submit.commandBufferCount = 1;
+  compute_submit.pCommandBuffers = &frame->compute_command_buffer;
+  compute_submit.signalSemaphoreCount = 1;
+  compute_submit.pSignalSemaphores = &frame->lighting_finished;
+
+  /* The fence goes on the present batch, which cannot complete before the
+     raymarch and lighting batches it transitively waits on. */
+  if (vkQueueSubmit (context->graphics_queue, 1, &raymarch_submit,
+                     VK_NULL_HANDLE)
+          != VK_SUCCESS
+      || vkQueueSubmit (context->compute_queue, 1, &compute_submit,
+                        VK_NULL_HANDLE)
+             != VK_SUCCESS
+      || vkQueueSubmit (context->graphics_queue, 1, &present_submit,
+                        frame->fence)
+             != VK_SUCCESS)
+    {
+      gpu_timer_abort_frame (raymarcher->gpu_timer);
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to submit frame commands");
+    }
+
+  return RESULT_SUCCESS;
 }
 
 result_t
-raymarcher_load_shader (raymarcher_t *raymarcher, const char *shader_path)
+raymarcher_end_frame (raymarcher_t *raymarcher, VkSemaphore wait_semaphore,
+                      VkSemaphore signal_semaphore)
 {
-  size_t code_size;
-  char *code = read_file (shader_path, &code_size);
-  if (!code)
-    {
-      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
-                           "Failed to load shader");
-    }
+  vulkan_context_t *context = raymarcher->vk_context;
+  raymarcher_frame_t *frame = raymarcher_current_frame (raymarcher);
 
-  VkShaderModuleCreateInfo create_info = { 0 };
-  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  create_info.codeSize = code_size;
-  create_info.pCode = (const uint32_t *)code;
+  vkEndCommandBuffer (frame->command_buffer);
+  raymarcher->frame_open = false;
 
-  if (vkCreateShaderModule (raymarcher->vk_context->device, &create_info, NULL,
-                            &raymarcher->compute_shader)
-      != VK_SUCCESS)
+  if (raymarcher->async_compute)
     {
-      free (code);
-      return RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
-                           "Failed to create shader module");
+      if (frame->lighting_recorded)
+        raymarcher_cmd_transfer_final (raymarcher, frame, true);
+      vkEndCommandBuffer (frame->compute_command_buffer);
+      vkEndCommandBuffer (frame->present_command_buffer);
+
+      return raymarcher_submit_async (raymarcher, frame, wait_semaphore,
+                                      signal_semaphore);
     }
 
-  free (code);
+  VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 
-  VkComputePipelineCreateInfo pipeline_info = { 0 };
-  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-  pipeline_info.stage.sType
-      = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-  pipeline_info.stage.module = raymarcher->compute_shader;
-  pipeline_info.stage.pName = "main";
-  pipeline_info.layout = raymarcher->pipeline_layout;
+  VkSubmitInfo submit_info = { 0 };
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.waitSemaphoreCount = wait_semaphore ? 1 : 0;
+  submit_info.pWaitSemaphores = &wait_semaphore;
+  submit_info.pWaitDstStageMask = &wait_stage;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &frame->command_buffer;
+  submit_info.signalSemaphoreCount = signal_semaphore ? 1 : 0;
+  submit_info.pSignalSemaphores = &signal_semaphore;
 
-  if (vkCreateComputePipelines (raymarcher->vk_context->device, VK_NULL_HANDLE,
-                                1, &pipeline_info, NULL,
-                                &raymarcher->compute_pipeline)
+  vkResetFences (context->device, 1, &frame->fence);
+
+  if (vkQueueSubmit (context->graphics_queue, 1, &submit_info, frame->fence)
       != VK_SUCCESS)
     {
+      gpu_timer_abort_frame (raymarcher->gpu_timer);
       return RESULT_ERROR (RESULT_ERROR_VULKAN,
-                           "Failed to create compute pipeline");
+                           "Failed to submit frame commands");
     }
 
   return RESULT_SUCCESS;
 }
 
+void
+raymarcher_abort_frame (raymarcher_t *raymarcher)
+{
+  if (!raymarcher || !raymarcher->frame_open)
+    return;
+
+  raymarcher_frame_t *frame = raymarcher_current_frame (raymarcher);
+  vkEndCommandBuffer (frame->command_buffer);
+  if (raymarcher->async_compute)
+    {
+      vkEndCommandBuffer (frame->compute_command_buffer);
+      vkEndCommandBuffer (frame->present_command_buffer);
+    }
+  raymarcher->frame_open = false;
+
+  gpu_timer_abort_frame (raymarcher->gpu_timer);
+}
+
 result_t
 raymarcher_execute (raymarcher_t *raymarcher,
                     const raymarch_uniforms_t *uniforms)
 {
   vulkan_context_t *context = raymarcher->vk_context;
+  raymarcher_frame_t *frame = raymarcher_current_frame (raymarcher);
+  VkCommandBuffer cmd = frame->command_buffer;
+
+  raymarch_uniforms_t frame_uniforms = *uniforms;
+  frame_uniforms.tile_culling = raymarcher->tile_cull_pipeline ? 1 : 0;
+  frame_uniforms.cone_prepass = raymarcher->cone_pipeline ? 1 : 0;
+  frame_uniforms.history_valid = frame_uniforms.cone_prepass
+                                 && raymarcher->reproject_pipeline
+                                 && raymarcher->history_valid;
+  frame_uniforms.prev_camera_position = raymarcher->history_camera_position;
+  frame_uniforms.prev_camera_direction
+      = raymarcher->history_camera_direction;
 
-  vkWaitForFences (context->device, 1, &raymarcher->compute_fence, VK_TRUE,
-                   UINT64_MAX);
-  vkResetFences (context->device, 1, &raymarcher->compute_fence);
-
-  result_t result = gpu_buffer_upload (context, &raymarcher->uniform_buffer,
-                                       uniforms, sizeof (raymarch_uniforms_t));
+  result_t result
+      = gpu_buffer_upload (context, &frame->uniform_buffer, &frame_uniforms,
+                           sizeof (raymarch_uniforms_t));
   if (result.code != RESULT_OK)
     return result;
 
-  VkCommandBufferBeginInfo begin_info = { 0 };
-  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  frame->sdf_slot = raymarcher->sdf_frame_slot;
 
-  vkBeginCommandBuffer (raymarcher->compute_command_buffer, &begin_info);
+  gpu_timer_cmd_begin (raymarcher->gpu_timer, cmd, GPU_TIMER_PASS_RAYMARCH);
 
-  vkCmdBindPipeline (raymarcher->compute_command_buffer,
-                     VK_PIPELINE_BIND_POINT_COMPUTE,
-                     raymarcher->compute_pipeline);
-  vkCmdBindDescriptorSets (
-      raymarcher->compute_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
-      raymarcher->pipeline_layout, 0, 1, &raymarcher->descriptor_set, 0, NULL);
+  uint32_t sdf_offset
+      = (uint32_t)(frame->sdf_slot * raymarcher->sdf_slot_size);
+  if (frame_uniforms.tile_culling)
+    raymarcher_cmd_tile_cull (raymarcher, cmd, sdf_offset);
 
-  uint32_t group_count_x = (raymarcher->width + 7) / 8;
-  uint32_t group_count_y = (raymarcher->height + 7) / 8;
-  vkCmdDispatch (raymarcher->compute_command_buffer, group_count_x,
-                 group_count_y, 1);
+  uint32_t sdf_offsets[2] = { sdf_offset, sdf_offset };
+  vkCmdBindDescriptorSets (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           raymarcher->pipeline_layout, 0, 1,
+                           &frame->descriptor_set, 2, sdf_offsets);
 
-  vkEndCommandBuffer (raymarcher->compute_command_buffer);
+  if (frame_uniforms.history_valid)
+    raymarcher_cmd_reproject (raymarcher, cmd);
+  if (frame_uniforms.cone_prepass)
+    raymarcher_cmd_cone_prepass (raymarcher, cmd);
 
-  VkSubmitInfo submit_info = { 0 };
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &raymarcher->compute_command_buffer;
+  vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                     raymarcher->compute_pipeline);
 
-  if (vkQueueSubmit (context->compute_queue, 1, &submit_info,
-                     raymarcher->compute_fence)
-      != VK_SUCCESS)
-    {
-      return RESULT_ERROR (RESULT_ERROR_VULKAN,
-                           "Failed to submit compute commands");
-    }
+  uint32_t group_count_x = (raymarcher->render_width + 7) / 8;
+  uint32_t group_count_y = (raymarcher->render_height + 7) / 8;
+  vkCmdDispatch (cmd, group_count_x, group_count_y, 1);
+
+  gpu_timer_cmd_end (raymarcher->gpu_timer, cmd, GPU_TIMER_PASS_RAYMARCH);
+
+  raymarcher->history_camera_position = uniforms->camera_position;
+  raymarcher->history_camera_direction = uniforms->camera_direction;
+  raymarcher->history_valid = true;
 
   return RESULT_SUCCESS;
 }
 
+void
+raymarcher_set_render_size (raymarcher_t *raymarcher, uint32_t width,
+                            uint32_t height)
+{
+  if (!raymarcher)
+    return;
+
+  if (width < 1)
+    width = 1;
+  if (width > raymarcher->width)
+    width = raymarcher->width;
+  if (height < 1)
+    height = 1;
+  if (height > raymarcher->height)
+    height = raymarcher->height;
+
+  if (width == raymarcher->render_width
+      && height == raymarcher->render_height)
+    return;
+
+  raymarcher->render_width = width;
+  raymarcher->render_height = height;
+  raymarcher->history_valid = false;
+  raymarcher->shadow_history_valid = false;
+}
+
 const gpu_image_t *
-raymarcher_get_color_depth (const raymarcher_t *raymarcher)
+raymarcher_get_color (const raymarcher_t *raymarcher)
 {
-  return &raymarcher->output_color_depth;
+  return &raymarcher->frames[raymarcher->frame_index].output_color;
 }
 
 const gpu_image_t *
 raymarcher_get_final (const raymarcher_t *raymarcher)
 {
-  return &raymarcher->output_final;
+  return &raymarcher->frames[raymarcher->frame_index].output_final;
 }
 
 result_t
@@ -462,14 +1997,14 @@ raymarcher_load_lighting_shader (raymarcher_t *raymarcher,
                             &raymarcher->lighting_shader)
       != VK_SUCCESS)
     {
-      free (code);
+      mem_free (code);
       return RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
                            "Failed to create lighting shader module");
     }
 
-  free (code);
+  mem_free (code);
 
-  VkDescriptorSetLayoutBinding bindings[6] = { 0 };
+  VkDescriptorSetLayoutBinding bindings[9] = { 0 };
 
   bindings[0].binding = 0;
   bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -492,13 +2027,29 @@ raymarcher_load_lighting_shader (raymarcher_t *raymarcher,
   bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
   bindings[4].binding = 5;
-  bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
   bindings[4].descriptorCount = 1;
   bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+  bindings[5].binding = 6;
+  bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  bindings[5].descriptorCount = 1;
+  bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[6].binding = 7;
+  bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[6].descriptorCount = 1;
+  bindings[6].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[7] = bindings[6];
+  bindings[7].binding = 8;
+
+  bindings[8] = bindings[6];
+  bindings[8].binding = 3;
+
   VkDescriptorSetLayoutCreateInfo layout_info = { 0 };
   layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layout_info.bindingCount = 5;
+  layout_info.bindingCount = 9;
   layout_info.pBindings = bindings;
 
   if (vkCreateDescriptorSetLayout (raymarcher->vk_context->device,
@@ -516,74 +2067,88 @@ raymarcher_load_lighting_shader (raymarcher_t *raymarcher,
   alloc_info.descriptorSetCount = 1;
   alloc_info.pSetLayouts = &raymarcher->lighting_descriptor_set_layout;
 
-  if (vkAllocateDescriptorSets (raymarcher->vk_context->device, &alloc_info,
-                                &raymarcher->lighting_descriptor_set)
-      != VK_SUCCESS)
+  VkDescriptorImageInfo shadow_ao_info = { 0 };
+  shadow_ao_info.imageView = raymarcher->shadow_ao.view;
+  shadow_ao_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkDescriptorImageInfo shadow_ao_history_info = { 0 };
+  shadow_ao_history_info.imageView = raymarcher->shadow_ao_history.view;
+  shadow_ao_history_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-      return RESULT_ERROR (RESULT_ERROR_VULKAN,
-                           "Failed to allocate lighting descriptor set");
-    }
-
-  VkDescriptorBufferInfo lighting_uniform_buffer_info = { 0 };
-  lighting_uniform_buffer_info.buffer
-      = raymarcher->lighting_uniform_buffer.buffer;
-  lighting_uniform_buffer_info.offset = 0;
-  lighting_uniform_buffer_info.range = sizeof (lighting_uniforms_t);
-
-  VkDescriptorImageInfo color_depth_read_info = { 0 };
-  color_depth_read_info.imageView = raymarcher->output_color_depth.view;
-  color_depth_read_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-  VkDescriptorImageInfo normal_read_info = { 0 };
-  normal_read_info.imageView = raymarcher->output_normal.view;
-  normal_read_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-  VkDescriptorImageInfo final_write_info = { 0 };
-  final_write_info.imageView = raymarcher->output_final.view;
-  final_write_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-  VkDescriptorBufferInfo sdf_buffer_info = { 0 };
-  sdf_buffer_info.buffer = raymarcher->sdf_objects_buffer.buffer;
-  sdf_buffer_info.offset = 0;
-  sdf_buffer_info.range = sizeof (sdf_object_t) * MAX_SDF_OBJECTS;
-
-  VkWriteDescriptorSet writes[5] = { 0 };
-  writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[0].dstSet = raymarcher->lighting_descriptor_set;
-  writes[0].dstBinding = 0;
-  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  writes[0].descriptorCount = 1;
-  writes[0].pBufferInfo = &lighting_uniform_buffer_info;
-
-  writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[1].dstSet = raymarcher->lighting_descriptor_set;
-  writes[1].dstBinding = 1;
-  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  writes[1].descriptorCount = 1;
-  writes[1].pImageInfo = &color_depth_read_info;
-
-  writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[2].dstSet = raymarcher->lighting_descriptor_set;
-  writes[2].dstBinding = 2;
-  writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  writes[2].descriptorCount = 1;
-  writes[2].pImageInfo = &normal_read_info;
-
-  writes[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[3].dstSet = raymarcher->lighting_descriptor_set;
-  writes[3].dstBinding = 4;
-  writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  writes[3].descriptorCount = 1;
-  writes[3].pImageInfo = &final_write_info;
-
-  writes[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writes[4].dstSet = raymarcher->lighting_descriptor_set;
-  writes[4].dstBinding = 5;
-  writes[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-  writes[4].descriptorCount = 1;
-  writes[4].pBufferInfo = &sdf_buffer_info;
-
-  vkUpdateDescriptorSets (raymarcher->vk_context->device, 5, writes, 0, NULL);
+      raymarcher_frame_t *frame = &raymarcher->frames[i];
+
+      if (vkAllocateDescriptorSets (raymarcher->vk_context->device,
+                                    &alloc_info,
+                                    &frame->lighting_descriptor_set)
+          != VK_SUCCESS)
+        {
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to allocate lighting descriptor set");
+        }
+
+      VkDescriptorBufferInfo lighting_uniform_buffer_info = { 0 };
+      lighting_uniform_buffer_info.buffer
+          = frame->lighting_uniform_buffer.buffer;
+      lighting_uniform_buffer_info.offset = 0;
+      lighting_uniform_buffer_info.range = sizeof (lighting_uniforms_t);
+
+      VkDescriptorImageInfo color_read_info = { 0 };
+      color_read_info.imageView = frame->output_color.view;
+      color_read_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkDescriptorImageInfo depth_read_info = { 0 };
+      depth_read_info.imageView = frame->output_depth.view;
+      depth_read_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkDescriptorImageInfo normal_read_info = { 0 };
+      normal_read_info.imageView = frame->output_normal.view;
+      normal_read_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkDescriptorImageInfo final_write_info = { 0 };
+      final_write_info.imageView = frame->output_final.view;
+      final_write_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkWriteDescriptorSet writes[7] = { 0 };
+      writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[0].dstSet = frame->lighting_descriptor_set;
+      writes[0].dstBinding = 0;
+      writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      writes[0].descriptorCount = 1;
+      writes[0].pBufferInfo = &lighting_uniform_buffer_info;
+
+      writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[1].dstSet = frame->lighting_descriptor_set;
+      writes[1].dstBinding = 1;
+      writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      writes[1].descriptorCount = 1;
+      writes[1].pImageInfo = &color_read_info;
+
+      writes[2] = writes[1];
+      writes[2].dstBinding = 2;
+      writes[2].pImageInfo = &normal_read_info;
+
+      writes[3] = writes[1];
+      writes[3].dstBinding = 4;
+      writes[3].pImageInfo = &final_write_info;
+
+      writes[4] = writes[1];
+      writes[4].dstBinding = 7;
+      writes[4].pImageInfo = &shadow_ao_info;
+
+      writes[5] = writes[1];
+      writes[5].dstBinding = 8;
+      writes[5].pImageInfo = &shadow_ao_history_info;
+
+      writes[6] = writes[1];
+      writes[6].dstBinding = 3;
+      writes[6].pImageInfo = &depth_read_info;
+
+      vkUpdateDescriptorSets (raymarcher->vk_context->device, 7, writes, 0,
+                              NULL);
+    }
+  raymarcher_bind_sdf_buffer (raymarcher);
 
   VkPipelineLayoutCreateInfo pipeline_layout_info = { 0 };
   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -600,18 +2165,9 @@ raymarcher_load_lighting_shader (raymarcher_t *raymarcher,
                            "Failed to create lighting pipeline layout");
     }
 
-  VkComputePipelineCreateInfo pipeline_info = { 0 };
-  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-  pipeline_info.stage.sType
-      = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-  pipeline_info.stage.module = raymarcher->lighting_shader;
-  pipeline_info.stage.pName = "main";
-  pipeline_info.layout = raymarcher->lighting_pipeline_layout;
-
-  if (vkCreateComputePipelines (raymarcher->vk_context->device, VK_NULL_HANDLE,
-                                1, &pipeline_info, NULL,
-                                &raymarcher->lighting_pipeline)
+  if (raymarcher_create_pipeline (raymarcher, raymarcher->lighting_shader,
+                                  raymarcher->lighting_pipeline_layout,
+                                  &raymarcher->lighting_pipeline)
       != VK_SUCCESS)
     {
       return RESULT_ERROR (RESULT_ERROR_VULKAN,
@@ -621,72 +2177,366 @@ raymarcher_load_lighting_shader (raymarcher_t *raymarcher,
   return RESULT_SUCCESS;
 }
 
+result_t
+raymarcher_load_shadow_ao_shader (raymarcher_t *raymarcher,
+                                  const char *shader_path)
+{
+  if (!raymarcher->lighting_pipeline_layout)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Lighting pipeline layout not created");
+    }
+
+  return raymarcher_load_compute_variant (
+      raymarcher, shader_path, raymarcher->lighting_pipeline_layout,
+      &raymarcher->shadow_ao_shader, &raymarcher->shadow_ao_pipeline);
+}
+
+static uint32_t
+raymarcher_shadow_ao_scale (const raymarcher_t *raymarcher, uint32_t scale)
+{
+  if (!raymarcher->shadow_ao_pipeline || scale < 2)
+    return 1;
+
+  return scale < RAYMARCH_SHADOW_AO_MAX_SCALE ? 2
+                                              : RAYMARCH_SHADOW_AO_MAX_SCALE;
+}
+
+static void
+raymarcher_cmd_shadow_ao (raymarcher_t *raymarcher, VkCommandBuffer cmd,
+                          uint32_t scale, bool temporal)
+{
+  vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                     raymarcher->shadow_ao_pipeline);
+
+  uint32_t width = (raymarcher->render_width + scale - 1) / scale;
+  uint32_t height = (raymarcher->render_height + scale - 1) / scale;
+  vkCmdDispatch (cmd, (width + 7) / 8, (height + 7) / 8, 1);
+
+  VkImageMemoryBarrier barriers[2] = { 0 };
+  barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].image = raymarcher->shadow_ao.image;
+  barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barriers[0].subresourceRange.levelCount = 1;
+  barriers[0].subresourceRange.layerCount = 1;
+
+  if (!temporal)
+    {
+      vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL,
+                            0, NULL, 1, barriers);
+      return;
+    }
+
+  /* The accumulated result becomes next frame's history. */
+  barriers[0].dstAccessMask
+      = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+  barriers[1] = barriers[0];
+  barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[1].image = raymarcher->shadow_ao_history.image;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                            | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0, 0, NULL, 0, NULL, 2, barriers);
+
+  VkImageCopy region = { 0 };
+  region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.srcSubresource.layerCount = 1;
+  region.dstSubresource = region.srcSubresource;
+  region.extent.width = width;
+  region.extent.height = height;
+  region.extent.depth = 1;
+
+  vkCmdCopyImage (cmd, raymarcher->shadow_ao.image, VK_IMAGE_LAYOUT_GENERAL,
+                  raymarcher->shadow_ao_history.image,
+                  VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+  barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                        NULL, 1, &barriers[1]);
+}
+
 result_t
 raymarcher_execute_lighting (raymarcher_t *raymarcher,
                              const lighting_uniforms_t *uniforms)
 {
   vulkan_context_t *context = raymarcher->vk_context;
-
-  vkWaitForFences (context->device, 1, &raymarcher->compute_fence, VK_TRUE,
-                   UINT64_MAX);
-  vkResetFences (context->device, 1, &raymarcher->compute_fence);
+  raymarcher_frame_t *frame = raymarcher_current_frame (raymarcher);
+  VkCommandBuffer cmd = raymarcher_lighting_command_buffer (raymarcher, frame);
+
+  lighting_uniforms_t frame_uniforms = *uniforms;
+  frame_uniforms.shadow_ao_scale
+      = raymarcher_shadow_ao_scale (raymarcher, uniforms->shadow_ao_scale);
+  frame_uniforms.temporal_shadows
+      = raymarcher->shadow_ao_pipeline && uniforms->temporal_shadows;
+  frame_uniforms.shadow_ao_pass = frame_uniforms.shadow_ao_scale > 1
+                                  || frame_uniforms.temporal_shadows;
+  frame_uniforms.frame_index = raymarcher->lighting_frame_index++;
+  frame_uniforms.history_valid
+      = frame_uniforms.temporal_shadows && raymarcher->shadow_history_valid
+        && raymarcher->shadow_history_scale == frame_uniforms.shadow_ao_scale;
+  frame_uniforms.prev_camera_position
+      = raymarcher->shadow_history_camera_position;
+  frame_uniforms.prev_camera_direction
+      = raymarcher->shadow_history_camera_direction;
 
   result_t result
-      = gpu_buffer_upload (context, &raymarcher->lighting_uniform_buffer,
-                           uniforms, sizeof (lighting_uniforms_t));
+      = gpu_buffer_upload (context, &frame->lighting_uniform_buffer,
+                           &frame_uniforms, sizeof (lighting_uniforms_t));
   if (result.code != RESULT_OK)
     return result;
 
-  VkCommandBufferBeginInfo begin_info = { 0 };
-  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-  vkBeginCommandBuffer (raymarcher->compute_command_buffer, &begin_info);
+  gpu_timer_cmd_begin (raymarcher->gpu_timer, cmd, GPU_TIMER_PASS_LIGHTING);
 
-  VkImageMemoryBarrier barriers[2] = { 0 };
+  VkImageMemoryBarrier barriers[3] = { 0 };
   barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
   barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
   barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
   barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  barriers[0].image = raymarcher->output_color_depth.image;
+  barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].image = frame->output_depth.image;
   barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   barriers[0].subresourceRange.levelCount = 1;
   barriers[0].subresourceRange.layerCount = 1;
 
   barriers[1] = barriers[0];
-  barriers[1].image = raymarcher->output_normal.image;
+  barriers[1].image = frame->output_color.image;
+  if (raymarcher->async_compute)
+    {
+      barriers[1].srcQueueFamilyIndex = context->graphics_family;
+      barriers[1].dstQueueFamilyIndex = context->compute_family;
+    }
 
-  vkCmdPipelineBarrier (
-      raymarcher->compute_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 2, barriers);
+  barriers[2] = barriers[1];
+  barriers[2].image = frame->output_normal.image;
 
-  vkCmdBindPipeline (raymarcher->compute_command_buffer,
-                     VK_PIPELINE_BIND_POINT_COMPUTE,
-                     raymarcher->lighting_pipeline);
-  vkCmdBindDescriptorSets (raymarcher->compute_command_buffer,
-                           VK_PIPELINE_BIND_POINT_COMPUTE,
+  if (raymarcher->async_compute)
+    {
+      /* Release color and normal from the graphics queue; the same
+         barriers below acquire them on the compute queue. Depth is
+         shared between both queues. */
+      vkCmdPipelineBarrier (frame->command_buffer,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL,
+                            0, NULL, 2, &barriers[1]);
+      raymarcher_cmd_transfer_final (raymarcher, frame, false);
+      frame->lighting_recorded = true;
+    }
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                        NULL, 3, barriers);
+
+  uint32_t sdf_offset
+      = (uint32_t)(frame->sdf_slot * raymarcher->sdf_slot_size);
+  uint32_t sdf_offsets[2] = { sdf_offset, sdf_offset };
+  vkCmdBindDescriptorSets (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
                            raymarcher->lighting_pipeline_layout, 0, 1,
-                           &raymarcher->lighting_descriptor_set, 0, NULL);
+                           &frame->lighting_descriptor_set, 2, sdf_offsets);
+
+  if (frame_uniforms.shadow_ao_pass)
+    raymarcher_cmd_shadow_ao (raymarcher, cmd, frame_uniforms.shadow_ao_scale,
+                              frame_uniforms.temporal_shadows);
 
-  uint32_t group_count_x = (raymarcher->width + 7) / 8;
-  uint32_t group_count_y = (raymarcher->height + 7) / 8;
-  vkCmdDispatch (raymarcher->compute_command_buffer, group_count_x,
-                 group_count_y, 1);
+  vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                     raymarcher->lighting_pipeline);
 
-  vkEndCommandBuffer (raymarcher->compute_command_buffer);
+  uint32_t group_count_x = (raymarcher->render_width + 7) / 8;
+  uint32_t group_count_y = (raymarcher->render_height + 7) / 8;
+  vkCmdDispatch (cmd, group_count_x, group_count_y, 1);
 
-  VkSubmitInfo submit_info = { 0 };
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &raymarcher->compute_command_buffer;
+  gpu_timer_cmd_end (raymarcher->gpu_timer, cmd, GPU_TIMER_PASS_LIGHTING);
+
+  raymarcher->shadow_history_camera_position = uniforms->camera_position;
+  raymarcher->shadow_history_camera_direction = uniforms->camera_direction;
+  raymarcher->shadow_history_scale = frame_uniforms.shadow_ao_scale;
+  raymarcher->shadow_history_valid = frame_uniforms.temporal_shadows;
+
+  return RESULT_SUCCESS;
+}
+
+result_t
+raymarcher_load_overlay_shader (raymarcher_t *raymarcher,
+                                const char *shader_path)
+{
+  size_t code_size;
+  char *code = read_file (shader_path, &code_size);
+  if (!code)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to load overlay shader");
+    }
+
+  VkShaderModuleCreateInfo create_info = { 0 };
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = code_size;
+  create_info.pCode = (const uint32_t *)code;
+
+  if (vkCreateShaderModule (raymarcher->vk_context->device, &create_info, NULL,
+                            &raymarcher->overlay_shader)
+      != VK_SUCCESS)
+    {
+      mem_free (code);
+      return RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
+                           "Failed to create overlay shader module");
+    }
+
+  mem_free (code);
+
+  VkDescriptorSetLayoutBinding bindings[2] = { 0 };
+
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = { 0 };
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = 2;
+  layout_info.pBindings = bindings;
+
+  if (vkCreateDescriptorSetLayout (raymarcher->vk_context->device,
+                                   &layout_info, NULL,
+                                   &raymarcher->overlay_descriptor_set_layout)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create overlay descriptor set layout");
+    }
+
+  VkDescriptorSetAllocateInfo alloc_info = { 0 };
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = raymarcher->descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &raymarcher->overlay_descriptor_set_layout;
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      raymarcher_frame_t *frame = &raymarcher->frames[i];
+
+      if (vkAllocateDescriptorSets (raymarcher->vk_context->device,
+                                    &alloc_info,
+                                    &frame->overlay_descriptor_set)
+          != VK_SUCCESS)
+        {
+          return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                               "Failed to allocate overlay descriptor set");
+        }
+
+      VkDescriptorBufferInfo overlay_buffer_info = { 0 };
+      overlay_buffer_info.buffer = frame->overlay_buffer.buffer;
+      overlay_buffer_info.offset = 0;
+      overlay_buffer_info.range = sizeof (overlay_data_t);
+
+      VkDescriptorImageInfo final_image_info = { 0 };
+      final_image_info.imageView = frame->output_final.view;
+      final_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkWriteDescriptorSet writes[2] = { 0 };
+      writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[0].dstSet = frame->overlay_descriptor_set;
+      writes[0].dstBinding = 0;
+      writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[0].descriptorCount = 1;
+      writes[0].pBufferInfo = &overlay_buffer_info;
+
+      writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[1].dstSet = frame->overlay_descriptor_set;
+      writes[1].dstBinding = 1;
+      writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      writes[1].descriptorCount = 1;
+      writes[1].pImageInfo = &final_image_info;
+
+      vkUpdateDescriptorSets (raymarcher->vk_context->device, 2, writes, 0,
+                              NULL);
+    }
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info = { 0 };
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts
+      = &raymarcher->overlay_descriptor_set_layout;
+
+  if (vkCreatePipelineLayout (raymarcher->vk_context->device,
+                              &pipeline_layout_info, NULL,
+                              &raymarcher->overlay_pipeline_layout)
+      != VK_SUCCESS)
+    {
+      return RESULT_ERROR (RESULT_ERROR_VULKAN,
+                           "Failed to create overlay pipeline layout");
+    }
 
-  if (vkQueueSubmit (context->compute_queue, 1, &submit_info,
-                     raymarcher->compute_fence)
+  if (raymarcher_create_pipeline (raymarcher, raymarcher->overlay_shader,
+                                  raymarcher->overlay_pipeline_layout,
+                                  &raymarcher->overlay_pipeline)
       != VK_SUCCESS)
     {
       return RESULT_ERROR (RESULT_ERROR_VULKAN,
-                           "Failed to submit lighting compute commands");
+                           "Failed to create overlay compute pipeline");
     }
 
   return RESULT_SUCCESS;
 }
+
+result_t
+raymarcher_execute_overlay (raymarcher_t *raymarcher,
+                            const overlay_data_t *data)
+{
+  raymarcher_frame_t *frame = raymarcher_current_frame (raymarcher);
+  VkCommandBuffer cmd = raymarcher_lighting_command_buffer (raymarcher, frame);
+
+  gpu_buffer_write (&frame->overlay_buffer, 0, data, sizeof (overlay_data_t));
+
+  gpu_timer_cmd_begin (raymarcher->gpu_timer, cmd, GPU_TIMER_PASS_OVERLAY);
+
+  VkImageMemoryBarrier barrier = { 0 };
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask
+      = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.image = frame->output_final.image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                        NULL, 1, &barrier);
+
+  vkCmdBindPipeline (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                     raymarcher->overlay_pipeline);
+  vkCmdBindDescriptorSets (cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                           raymarcher->overlay_pipeline_layout, 0, 1,
+                           &frame->overlay_descriptor_set, 0, NULL);
+
+  uint32_t group_count_x = (raymarcher->render_width + 7) / 8;
+  uint32_t group_count_y = (raymarcher->render_height + 7) / 8;
+  vkCmdDispatch (cmd, group_count_x, group_count_y, 1);
+
+  gpu_timer_cmd_end (raymarcher->gpu_timer, cmd, GPU_TIMER_PASS_OVERLAY);
+
+  return RESULT_SUCCESS;
+}
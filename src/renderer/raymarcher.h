@@ -2,9 +2,20 @@
 #define HITE_RAYMARCHER_H
 
 #include "../core/ecs.h"
+#include "gpu_timer.h"
 #include "vulkan_core.h"
 
-#define MAX_SDF_OBJECTS 256
+#define SDF_OBJECTS_INITIAL_CAPACITY 256
+#define SDF_BUFFER_HEADER_SIZE 16
+
+#define RAYMARCH_TILE_SIZE 16
+#define RAYMARCH_TILE_MAX_OBJECTS 64
+#define RAYMARCH_CONE_BLOCK_SIZE 8
+#define RAYMARCH_SHADOW_AO_MAX_SCALE 4
+
+#define OVERLAY_GRAPH_SAMPLES 240
+#define OVERLAY_TEXT_COLUMNS 96
+#define OVERLAY_TEXT_ROWS 32
 
 typedef struct
 {
@@ -15,9 +26,12 @@ typedef struct
   vec2_t resolution;
   vec4_t background_color;
   float time;
-  uint32_t object_count;
 
-  float _padding[1];
+  uint32_t tile_culling;
+  uint32_t cone_prepass;
+  uint32_t history_valid;
+  vec4_t prev_camera_position;
+  vec4_t prev_camera_direction;
 } ALIGN_64 raymarch_uniforms_t;
 
 typedef struct
@@ -30,6 +44,87 @@ typedef struct
 
 } ALIGN_64 sdf_object_t;
 
+typedef struct
+{
+  float bounds_min[3];
+  uint32_t left_first;
+  float bounds_max[3];
+  uint32_t count;
+} ALIGN_32 sdf_bvh_node_t;
+
+/* Quality knobs baked into the raymarch and lighting pipelines as
+   specialization constants, so disabled features are compiled out of each
+   variant. Field order matches the constant_id values declared in
+   shaders/common/scene_constants.glsl. */
+typedef struct
+{
+  int32_t max_steps;
+  int32_t max_shadow_steps;
+  int32_t ao_samples;
+  int32_t reflection_max_steps;
+  VkBool32 ao_enabled;
+  VkBool32 hard_shadows_enabled;
+  VkBool32 reflection_enabled;
+  VkBool32 fade_enabled;
+  VkBool32 noise_enabled;
+  VkBool32 near_light_enabled;
+} raymarch_quality_t;
+
+typedef enum
+{
+  RAYMARCH_QUALITY_LOW,
+  RAYMARCH_QUALITY_MEDIUM,
+  RAYMARCH_QUALITY_HIGH,
+  RAYMARCH_QUALITY_ULTRA,
+  RAYMARCH_QUALITY_COUNT
+} raymarch_quality_preset_t;
+
+typedef enum
+{
+  RAYMARCH_SHADER_RAYMARCH = 0,
+  RAYMARCH_SHADER_CONE,
+  RAYMARCH_SHADER_REPROJECT,
+  RAYMARCH_SHADER_TILE_CULL,
+  RAYMARCH_SHADER_LIGHTING,
+  RAYMARCH_SHADER_SHADOW_AO,
+  RAYMARCH_SHADER_OVERLAY,
+  RAYMARCH_SHADER_COUNT
+} raymarch_shader_t;
+
+/* Everything the CPU rewrites or the GPU writes per frame, so frame N+1
+   can be recorded while frame N is still executing. On a single queue all
+   passes of a frame and the present blit go into command_buffer. With
+   async compute, command_buffer only holds the raymarch; lighting and the
+   overlay go to the compute queue, and the blit to present_command_buffer
+   once lighting has finished, so frame N+1's raymarch overlaps frame N's
+   lighting. */
+typedef struct
+{
+  VkCommandBuffer command_buffer;
+  VkCommandBuffer compute_command_buffer;
+  VkCommandBuffer present_command_buffer;
+  VkSemaphore raymarch_finished;
+  VkSemaphore lighting_finished;
+  bool lighting_recorded;
+  VkFence fence;
+
+  gpu_buffer_t uniform_buffer;
+  gpu_buffer_t lighting_uniform_buffer;
+  gpu_buffer_t overlay_buffer;
+
+  gpu_image_t output_color;
+  gpu_image_t output_depth;
+  gpu_image_t output_normal;
+  gpu_image_t output_final;
+
+  VkDescriptorSet descriptor_set;
+  VkDescriptorSet tile_cull_descriptor_set;
+  VkDescriptorSet lighting_descriptor_set;
+  VkDescriptorSet overlay_descriptor_set;
+
+  uint32_t sdf_slot;
+} raymarcher_frame_t;
+
 typedef struct
 {
   vulkan_context_t *vk_context;
@@ -38,30 +133,77 @@ typedef struct
   VkPipelineLayout pipeline_layout;
   VkDescriptorSetLayout descriptor_set_layout;
   VkDescriptorPool descriptor_pool;
-  VkDescriptorSet descriptor_set;
 
   VkShaderModule compute_shader;
 
-  gpu_buffer_t uniform_buffer;
+  VkPipeline cone_pipeline;
+  VkShaderModule cone_shader;
+  gpu_image_t cone_depth;
+
+  VkPipeline reproject_pipeline;
+  VkShaderModule reproject_shader;
+  gpu_image_t reproject_depth;
+  vec4_t history_camera_position;
+  vec4_t history_camera_direction;
+  bool history_valid;
+
   gpu_buffer_t sdf_objects_buffer;
+  VkDeviceSize sdf_slot_size;
+  VkDeviceSize sdf_nodes_offset;
+  uint32_t sdf_frame_slot;
+  sdf_object_t *sdf_shadow[MAX_FRAMES_IN_FLIGHT];
+  uint32_t sdf_shadow_count[MAX_FRAMES_IN_FLIGHT];
+  sdf_bvh_node_t *sdf_node_shadow[MAX_FRAMES_IN_FLIGHT];
+  uint32_t sdf_node_shadow_count[MAX_FRAMES_IN_FLIGHT];
+  uint32_t sdf_header_shadow[MAX_FRAMES_IN_FLIGHT][4];
+  bool sdf_header_shadow_valid[MAX_FRAMES_IN_FLIGHT];
 
-  gpu_image_t output_color_depth;
-  gpu_image_t output_normal;
-  gpu_image_t output_final;
+  gpu_buffer_t tile_buffer;
+  VkDeviceSize tile_indices_offset;
+  uint32_t tiles_x;
+  uint32_t tiles_y;
+
+  VkPipeline tile_cull_pipeline;
+  VkPipelineLayout tile_cull_pipeline_layout;
+  VkDescriptorSetLayout tile_cull_descriptor_set_layout;
+  VkShaderModule tile_cull_shader;
 
   VkPipeline lighting_pipeline;
   VkPipelineLayout lighting_pipeline_layout;
   VkDescriptorSetLayout lighting_descriptor_set_layout;
-  VkDescriptorSet lighting_descriptor_set;
   VkShaderModule lighting_shader;
 
-  gpu_buffer_t lighting_uniform_buffer;
+  VkPipeline shadow_ao_pipeline;
+  VkShaderModule shadow_ao_shader;
+  gpu_image_t shadow_ao;
+  gpu_image_t shadow_ao_history;
+  vec4_t shadow_history_camera_position;
+  vec4_t shadow_history_camera_direction;
+  uint32_t shadow_history_scale;
+  uint32_t lighting_frame_index;
+  bool shadow_history_valid;
 
-  VkCommandBuffer compute_command_buffer;
-  VkFence compute_fence;
+  VkPipeline overlay_pipeline;
+  VkPipelineLayout overlay_pipeline_layout;
+  VkDescriptorSetLayout overlay_descriptor_set_layout;
+  VkShaderModule overlay_shader;
+
+  raymarcher_frame_t frames[MAX_FRAMES_IN_FLIGHT];
+  uint32_t frame_index;
+  bool frame_open;
+  bool async_compute;
+
+  raymarch_quality_t quality;
+  /* Bit N set when shape type N may appear in the scene; eval_shape drops
+     the branches of cleared types (constant_id 10). */
+  uint32_t shape_mask;
+
+  gpu_timer_t *gpu_timer;
 
   uint32_t width;
   uint32_t height;
+  uint32_t render_width;
+  uint32_t render_height;
   uint32_t max_objects;
 } raymarcher_t;
 
@@ -72,9 +214,46 @@ void raymarcher_destroy (raymarcher_t *raymarcher);
 result_t raymarcher_load_shader (raymarcher_t *raymarcher,
                                  const char *shader_path);
 
+raymarch_quality_t
+raymarch_quality_from_preset (raymarch_quality_preset_t preset);
+/* Rebuilds the affected pipelines when quality changes. Must be called
+   before any pass of the current frame has been recorded. */
+result_t raymarcher_set_quality (raymarcher_t *raymarcher,
+                                 const raymarch_quality_t *quality);
+/* Same contract as raymarcher_set_quality. */
+result_t raymarcher_set_shape_mask (raymarcher_t *raymarcher,
+                                    uint32_t shape_mask);
+/* Swaps in new SPIR-V for a pass whose shader was already loaded, keeping
+   the old pipeline if the new one fails. Same contract as
+   raymarcher_set_quality. */
+result_t raymarcher_reload_shader (raymarcher_t *raymarcher,
+                                   raymarch_shader_t shader,
+                                   const char *shader_path);
+
+void raymarcher_begin_frame (raymarcher_t *raymarcher);
+VkCommandBuffer raymarcher_get_command_buffer (const raymarcher_t *raymarcher);
+result_t raymarcher_end_frame (raymarcher_t *raymarcher,
+                               VkSemaphore wait_semaphore,
+                               VkSemaphore signal_semaphore);
+void raymarcher_abort_frame (raymarcher_t *raymarcher);
+
 result_t raymarcher_update_from_ecs (raymarcher_t *raymarcher,
                                      ecs_world_t *world);
 
+result_t raymarcher_upload_sdf_objects (raymarcher_t *raymarcher,
+                                        const sdf_object_t *objects,
+                                        uint32_t count,
+                                        uint32_t unbounded_count,
+                                        const sdf_bvh_node_t *nodes,
+                                        uint32_t node_count);
+
+result_t raymarcher_load_cone_shader (raymarcher_t *raymarcher,
+                                      const char *shader_path);
+result_t raymarcher_load_reproject_shader (raymarcher_t *raymarcher,
+                                           const char *shader_path);
+result_t raymarcher_load_tile_cull_shader (raymarcher_t *raymarcher,
+                                           const char *shader_path);
+
 result_t raymarcher_execute (raymarcher_t *raymarcher,
                              const raymarch_uniforms_t *uniforms);
 
@@ -92,15 +271,43 @@ typedef struct
   float shadow_bias;
   float shadow_softness;
   uint32_t shadow_steps;
-  uint32_t object_count;
+  uint32_t shadow_ao_scale;
+  uint32_t shadow_ao_pass;
+  uint32_t temporal_shadows;
+  uint32_t frame_index;
+  uint32_t history_valid;
+  vec4_t prev_camera_position;
+  vec4_t prev_camera_direction;
 } ALIGN_64 lighting_uniforms_t;
 
 result_t raymarcher_load_lighting_shader (raymarcher_t *raymarcher,
                                           const char *shader_path);
+result_t raymarcher_load_shadow_ao_shader (raymarcher_t *raymarcher,
+                                           const char *shader_path);
 result_t raymarcher_execute_lighting (raymarcher_t *raymarcher,
                                       const lighting_uniforms_t *uniforms);
 
-const gpu_image_t *raymarcher_get_color_depth (const raymarcher_t *raymarcher);
+typedef struct
+{
+  vec4_t graph_rect;
+  vec4_t graph_params;
+  int32_t text_columns;
+  int32_t text_rows;
+  int32_t text_scale;
+  int32_t enabled;
+  float samples[OVERLAY_GRAPH_SAMPLES];
+  uint32_t cells[OVERLAY_TEXT_COLUMNS * OVERLAY_TEXT_ROWS];
+} overlay_data_t;
+
+result_t raymarcher_load_overlay_shader (raymarcher_t *raymarcher,
+                                         const char *shader_path);
+result_t raymarcher_execute_overlay (raymarcher_t *raymarcher,
+                                     const overlay_data_t *data);
+
+void raymarcher_set_render_size (raymarcher_t *raymarcher, uint32_t width,
+                                 uint32_t height);
+
+const gpu_image_t *raymarcher_get_color (const raymarcher_t *raymarcher);
 const gpu_image_t *raymarcher_get_normal (const raymarcher_t *raymarcher);
 const gpu_image_t *raymarcher_get_final (const raymarcher_t *raymarcher);
 
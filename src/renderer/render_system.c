@@ -1,6 +1,10 @@
 #include "render_system.h"
 #include "../components/camera_component.h"
+#include "../components/developer_overlay_component.h"
 #include "../components/lighting_component.h"
+#include "../core/allocator.h"
+#include "../core/logger.h"
+#include "../core/metrics.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +15,215 @@
 #define M_PI 3.14159265358979323846
 #endif
 
+#define OVERLAY_TEXT_SCALE 2
+#define OVERLAY_CELL_WIDTH 6
+#define OVERLAY_CELL_HEIGHT 9
+#define OVERLAY_MARGIN 8
+#define OVERLAY_GRAPH_WIDTH 480
+#define OVERLAY_GRAPH_HEIGHT 100
+
+#define PIPELINE_CACHE_FILE_NAME "hite_pipeline_cache.bin"
+#define SHADER_CACHE_DIR_NAME "shader_cache"
+#define SHADER_POLL_INTERVAL 0.5f
+
+static const char *shader_sources[RAYMARCH_SHADER_COUNT] = {
+  [RAYMARCH_SHADER_RAYMARCH] = "raymarch.comp",
+  [RAYMARCH_SHADER_CONE] = "cone_prepass.comp",
+  [RAYMARCH_SHADER_REPROJECT] = "reproject.comp",
+  [RAYMARCH_SHADER_TILE_CULL] = "tile_cull.comp",
+  [RAYMARCH_SHADER_LIGHTING] = "lighting.comp",
+  [RAYMARCH_SHADER_SHADOW_AO] = "shadow_ao.comp",
+  [RAYMARCH_SHADER_OVERLAY] = "overlay.comp",
+};
+
+typedef result_t (*shader_loader_t) (raymarcher_t *raymarcher,
+                                     const char *shader_path);
+
+static void
+resolve_install_prefix (char *out_prefix, size_t size)
+{
+  out_prefix[0] = '\0';
+
+  ssize_t len = readlink ("/proc/self/exe", out_prefix, size - 1);
+  if (len == -1)
+    {
+      out_prefix[0] = '\0';
+      return;
+    }
+  out_prefix[len] = '\0';
+
+  char *last_slash = strrchr (out_prefix, '/');
+  if (last_slash)
+    {
+      *last_slash = '\0';
+      last_slash = strrchr (out_prefix, '/');
+      if (last_slash)
+        *last_slash = '\0';
+    }
+}
+
+static void
+resolve_binary_dir_path (const char *file_name, char *out_path, size_t size)
+{
+  char exe_path[1024];
+  const char *dir = ".";
+
+  ssize_t len = readlink ("/proc/self/exe", exe_path, sizeof (exe_path) - 1);
+  if (len > 0)
+    {
+      exe_path[len] = '\0';
+      char *last_slash = strrchr (exe_path, '/');
+      if (last_slash)
+        {
+          *last_slash = '\0';
+          dir = exe_path;
+        }
+    }
+
+  int written = snprintf (out_path, size, "%s/%s", dir, file_name);
+  if (written < 0 || (size_t)written >= size)
+    out_path[0] = '\0';
+}
+
+/* Prefers SPIR-V compiled from the source tree so edits apply without a
+   rebuild, falling back to the build output. */
+static result_t
+load_shader (render_system_t *system, const char *install_prefix,
+             raymarch_shader_t shader, shader_loader_t loader)
+{
+  static const char *search_dirs[]
+      = { "build/shaders", "shaders", "../shaders", NULL };
+
+  raymarcher_t *raymarcher = &system->raymarcher;
+  char path[1280];
+  result_t result
+      = RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND, "Shader not found");
+
+  if (system->shader_compiler.available)
+    {
+      system->shader_hashes[shader] = shader_compiler_source_hash (
+          &system->shader_compiler, shader_sources[shader]);
+      result = shader_compiler_build (&system->shader_compiler,
+                                      shader_sources[shader], path,
+                                      sizeof (path));
+      if (result.code == RESULT_OK)
+        result = loader (raymarcher, path);
+      if (result.code == RESULT_OK)
+        return result;
+
+      LOG_WARNING ("RenderSystem", "Using prebuilt %s: %s",
+                   shader_sources[shader], result.message);
+    }
+
+  char file_name[64];
+  snprintf (file_name, sizeof (file_name), "%s.spv", shader_sources[shader]);
+
+  if (install_prefix && install_prefix[0])
+    {
+      int written = snprintf (path, sizeof (path), "%s/share/hite/shaders/%s",
+                              install_prefix, file_name);
+      if (written > 0 && (size_t)written < sizeof (path))
+        {
+          result = loader (raymarcher, path);
+          if (result.code == RESULT_OK)
+            return result;
+        }
+    }
+
+  for (int i = 0; search_dirs[i] != NULL; i++)
+    {
+      int written
+          = snprintf (path, sizeof (path), "%s/%s", search_dirs[i], file_name);
+      if (written < 0 || (size_t)written >= sizeof (path))
+        continue;
+
+      result = loader (raymarcher, path);
+      if (result.code == RESULT_OK)
+        return result;
+    }
+
+  return result;
+}
+
+static uint32_t
+pack_overlay_color (vec4_t color)
+{
+  uint32_t r = (uint32_t)(fminf (fmaxf (color.x, 0.0f), 1.0f) * 255.0f);
+  uint32_t g = (uint32_t)(fminf (fmaxf (color.y, 0.0f), 1.0f) * 255.0f);
+  uint32_t b = (uint32_t)(fminf (fmaxf (color.z, 0.0f), 1.0f) * 255.0f);
+  return (r << 8) | (g << 16) | (b << 24);
+}
+
+static void
+build_overlay_data (const render_system_t *system,
+                    const developer_overlay_component_t *overlay,
+                    overlay_data_t *data)
+{
+  uint32_t width = system->raymarcher.render_width;
+  uint32_t height = system->raymarcher.render_height;
+  int32_t cell_width = OVERLAY_CELL_WIDTH * OVERLAY_TEXT_SCALE;
+  int32_t cell_height = OVERLAY_CELL_HEIGHT * OVERLAY_TEXT_SCALE;
+
+  memset (data, 0, sizeof (overlay_data_t));
+  data->enabled = 1;
+  data->text_scale = OVERLAY_TEXT_SCALE;
+  data->text_columns = ((int32_t)width - OVERLAY_MARGIN) / cell_width;
+  data->text_rows = ((int32_t)height - OVERLAY_MARGIN) / cell_height;
+  if (data->text_columns > OVERLAY_TEXT_COLUMNS)
+    data->text_columns = OVERLAY_TEXT_COLUMNS;
+  if (data->text_rows > OVERLAY_TEXT_ROWS)
+    data->text_rows = OVERLAY_TEXT_ROWS;
+
+  for (size_t i = 0; i < overlay->text_element_count; i++)
+    {
+      const developer_overlay_text_element_t *element
+          = &overlay->text_elements[i];
+      if (!element->active || element->text[0] == '\0')
+        continue;
+
+      int32_t column = (int32_t)(element->x * (float)width) / cell_width;
+      int32_t row = (int32_t)(element->y * (float)height) / cell_height;
+      if (row < 0 || row >= data->text_rows || column < 0)
+        continue;
+
+      uint32_t color = pack_overlay_color (element->color);
+      for (const char *c = element->text;
+           *c && column < data->text_columns; c++, column++)
+        {
+          data->cells[row * OVERLAY_TEXT_COLUMNS + column]
+              = (uint32_t)(unsigned char)*c | color;
+        }
+    }
+
+  float graph_width = (float)width - 2.0f * OVERLAY_MARGIN;
+  if (graph_width > OVERLAY_GRAPH_WIDTH)
+    graph_width = OVERLAY_GRAPH_WIDTH;
+
+  data->graph_rect
+      = (vec4_t){ (float)OVERLAY_MARGIN,
+                  (float)height - OVERLAY_MARGIN - OVERLAY_GRAPH_HEIGHT,
+                  graph_width, (float)OVERLAY_GRAPH_HEIGHT };
+
+  uint32_t sample_count = DEVELOPER_OVERLAY_HISTORY < OVERLAY_GRAPH_SAMPLES
+                              ? DEVELOPER_OVERLAY_HISTORY
+                              : OVERLAY_GRAPH_SAMPLES;
+  for (uint32_t i = 0; i < sample_count; i++)
+    {
+      data->samples[i] = overlay->frame_times_ms[i];
+    }
+
+  float budget_ms = overlay->frame_budget_ms;
+  float graph_max_ms = budget_ms * 2.0f;
+  if (overlay->frame_max_ms * 1.1f > graph_max_ms)
+    graph_max_ms = overlay->frame_max_ms * 1.1f;
+
+  uint32_t head = overlay->frame_time_count < DEVELOPER_OVERLAY_HISTORY
+                      ? 0
+                      : overlay->frame_time_head;
+  data->graph_params = (vec4_t){ graph_max_ms, budget_ms,
+                                 (float)sample_count, (float)head };
+}
+
 static void
 shape_to_sdf_object (const shape_component_t *shape, sdf_object_t *sdf)
 {
@@ -39,88 +252,123 @@ render_system_init (render_system_t *system, vulkan_context_t *vk_context,
   if (result.code != RESULT_OK)
     return result;
 
-  result = swapchain_create (vk_context, window, width, height,
-                             &system->swapchain);
-  if (result.code != RESULT_OK)
-    {
-      raymarcher_destroy (&system->raymarcher);
-      return result;
-    }
-
-  char exe_path[1024] = { 0 };
-  ssize_t len = readlink ("/proc/self/exe", exe_path, sizeof (exe_path) - 1);
-  if (len != -1)
+  /* Without a window the frame ends in output_final and is only read
+     back through the frame capture. */
+  system->headless = window == NULL;
+  if (!system->headless)
     {
-      exe_path[len] = '\0';
-
-      char *last_slash = strrchr (exe_path, '/');
-      if (last_slash)
+      result = swapchain_create (vk_context, window, width, height,
+                                 &system->swapchain);
+      if (result.code != RESULT_OK)
         {
-          *last_slash = '\0';
-          last_slash = strrchr (exe_path, '/');
-          if (last_slash)
-            *last_slash = '\0';
+          raymarcher_destroy (&system->raymarcher);
+          return result;
         }
     }
 
-  char shader_path_buf[1024];
-  snprintf (shader_path_buf, sizeof (shader_path_buf),
-            "%s/share/hite/shaders/raymarch.comp.spv", exe_path);
-
-  const char *shader_paths[]
-      = { shader_path_buf, "build/shaders/raymarch.comp.spv",
-          "shaders/raymarch.comp.spv", "../shaders/raymarch.comp.spv", NULL };
+  result = gpu_timer_create (vk_context, &system->gpu_timer);
+  if (result.code != RESULT_OK)
+    {
+      swapchain_destroy (vk_context, &system->swapchain);
+      raymarcher_destroy (&system->raymarcher);
+      return result;
+    }
 
-  result_t shader_result
-      = RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND, "Shader not found");
-  for (int i = 0; shader_paths[i] != NULL; i++)
+  system->raymarcher.gpu_timer = &system->gpu_timer;
+  system->swapchain.gpu_timer = &system->gpu_timer;
+
+  resolve_binary_dir_path (PIPELINE_CACHE_FILE_NAME,
+                           system->pipeline_cache_path,
+                           sizeof (system->pipeline_cache_path));
+  vulkan_pipeline_cache_load (vk_context,
+                              system->pipeline_cache_path[0]
+                                  ? system->pipeline_cache_path
+                                  : NULL);
+
+  char install_prefix[1024] = { 0 };
+  resolve_install_prefix (install_prefix, sizeof (install_prefix));
+
+  char shader_cache_dir[SHADER_COMPILER_PATH_MAX];
+  resolve_binary_dir_path (SHADER_CACHE_DIR_NAME, shader_cache_dir,
+                           sizeof (shader_cache_dir));
+  result_t compiler_result
+      = shader_compiler_init (&system->shader_compiler, shader_cache_dir);
+  if (compiler_result.code != RESULT_OK)
     {
-      shader_result
-          = raymarcher_load_shader (&system->raymarcher, shader_paths[i]);
-      if (shader_result.code == RESULT_OK)
-        {
-          break;
-        }
+      LOG_INFO ("RenderSystem", "Runtime shader compilation disabled: %s",
+                compiler_result.message);
     }
 
+  result_t shader_result = load_shader (
+      system, install_prefix, RAYMARCH_SHADER_RAYMARCH,
+      raymarcher_load_shader);
   if (shader_result.code != RESULT_OK)
     {
+      gpu_timer_destroy (&system->gpu_timer);
       raymarcher_destroy (&system->raymarcher);
       return shader_result;
     }
 
-  char lighting_shader_path_buf[1024] = { 0 };
+  shader_result = load_shader (system, install_prefix, RAYMARCH_SHADER_CONE,
+                               raymarcher_load_cone_shader);
+  if (shader_result.code != RESULT_OK)
+    {
+      LOG_WARNING ("RenderSystem", "Cone pre-pass disabled: %s",
+                   shader_result.message);
+    }
 
-  if (len != -1 && strlen (exe_path) > 0)
+  shader_result = load_shader (
+      system, install_prefix, RAYMARCH_SHADER_REPROJECT,
+      raymarcher_load_reproject_shader);
+  if (shader_result.code != RESULT_OK)
     {
-      snprintf (lighting_shader_path_buf, sizeof (lighting_shader_path_buf),
-                "%s/share/hite/shaders/lighting.comp.spv", exe_path);
+      LOG_WARNING ("RenderSystem", "Depth reprojection disabled: %s",
+                   shader_result.message);
     }
-  else
+
+  shader_result = load_shader (
+      system, install_prefix, RAYMARCH_SHADER_TILE_CULL,
+      raymarcher_load_tile_cull_shader);
+  if (shader_result.code != RESULT_OK)
     {
-      lighting_shader_path_buf[0] = '\0';
+      LOG_WARNING ("RenderSystem", "Tile culling disabled: %s",
+                   shader_result.message);
     }
 
-  const char *lighting_shader_paths[]
-      = { lighting_shader_path_buf[0] ? lighting_shader_path_buf : NULL,
-          "build/shaders/lighting.comp.spv", "shaders/lighting.comp.spv",
-          "../shaders/lighting.comp.spv", NULL };
+  shader_result = load_shader (
+      system, install_prefix, RAYMARCH_SHADER_LIGHTING,
+      raymarcher_load_lighting_shader);
+  if (shader_result.code != RESULT_OK)
+    {
+      LOG_WARNING ("RenderSystem", "Lighting pass disabled: %s",
+                   shader_result.message);
+    }
 
-  shader_result = RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
-                                "Lighting shader not found");
-  for (int i = 0; lighting_shader_paths[i] != NULL; i++)
+  if (system->raymarcher.lighting_pipeline)
     {
-      shader_result = raymarcher_load_lighting_shader (
-          &system->raymarcher, lighting_shader_paths[i]);
-      if (shader_result.code == RESULT_OK)
+      shader_result = load_shader (
+          system, install_prefix, RAYMARCH_SHADER_SHADOW_AO,
+          raymarcher_load_shadow_ao_shader);
+      if (shader_result.code != RESULT_OK)
         {
-          break;
+          LOG_WARNING ("RenderSystem",
+                       "Reduced-resolution shadows disabled: %s",
+                       shader_result.message);
         }
     }
 
-  system->sdf_object_capacity = MAX_SDF_OBJECTS;
+  shader_result = load_shader (system, install_prefix, RAYMARCH_SHADER_OVERLAY,
+                               raymarcher_load_overlay_shader);
+  if (shader_result.code != RESULT_OK)
+    {
+      LOG_WARNING ("RenderSystem", "Overlay pass disabled: %s",
+                   shader_result.message);
+    }
+
+  system->sdf_object_capacity = SDF_OBJECTS_INITIAL_CAPACITY;
   system->sdf_objects
-      = calloc (system->sdf_object_capacity, sizeof (sdf_object_t));
+      = mem_calloc (MEM_TAG_RENDERER, system->sdf_object_capacity,
+                    sizeof (sdf_object_t));
   if (!system->sdf_objects)
     {
       raymarcher_destroy (&system->raymarcher);
@@ -140,6 +388,7 @@ render_system_init (render_system_t *system, vulkan_context_t *vk_context,
   system->camera_direction.z /= dir_len;
 
   system->camera_fov = 1.0f;
+  system->quality = LIGHTING_QUALITY_HIGH;
 
   return RESULT_SUCCESS;
 }
@@ -150,11 +399,102 @@ render_system_cleanup (render_system_t *system)
   if (!system)
     return;
 
+  if (system->raymarcher.vk_context && system->pipeline_cache_path[0])
+    vulkan_pipeline_cache_save (system->raymarcher.vk_context,
+                                system->pipeline_cache_path);
+
+  shader_compiler_shutdown (&system->shader_compiler);
+  frame_capture_destroy (system->raymarcher.vk_context, &system->capture);
   swapchain_destroy (system->raymarcher.vk_context, &system->swapchain);
-  free (system->sdf_objects);
+  gpu_timer_destroy (&system->gpu_timer);
+  mem_free (system->sdf_objects);
+  mem_free (system->benchmark_objects);
+  sdf_bvh_destroy (&system->bvh);
   raymarcher_destroy (&system->raymarcher);
 }
 
+static result_t
+render_system_reserve_objects (render_system_t *system, size_t count)
+{
+  if (count <= system->sdf_object_capacity)
+    return RESULT_SUCCESS;
+
+  size_t capacity = system->sdf_object_capacity;
+  while (capacity < count)
+    capacity *= 2;
+
+  sdf_object_t *objects
+      = mem_realloc (system->sdf_objects, capacity * sizeof (sdf_object_t));
+  if (!objects)
+    {
+      return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                           "Failed to grow SDF object array");
+    }
+
+  system->sdf_objects = objects;
+  system->sdf_object_capacity = capacity;
+
+  return RESULT_SUCCESS;
+}
+
+result_t
+render_system_set_benchmark_objects (render_system_t *system, uint32_t count)
+{
+  if (!system)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER, "Invalid system");
+    }
+
+  mem_free (system->benchmark_objects);
+  system->benchmark_objects = NULL;
+  system->benchmark_object_count = 0;
+
+  if (count == 0)
+    return RESULT_SUCCESS;
+
+  system->benchmark_objects
+      = mem_alloc (MEM_TAG_RENDERER, count * sizeof (sdf_object_t));
+  if (!system->benchmark_objects)
+    {
+      return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                           "Failed to allocate benchmark objects");
+    }
+
+  uint32_t side = 1;
+  while (side * side * side < count)
+    side++;
+
+  const float spacing = 2.5f;
+  float half = (float)(side - 1) * spacing * 0.5f;
+  for (uint32_t i = 0; i < count; i++)
+    {
+      uint32_t x = i % side;
+      uint32_t y = (i / side) % side;
+      uint32_t z = i / (side * side);
+
+      shape_component_t sphere = { 0 };
+      sphere.type = SHAPE_SPHERE;
+      sphere.transform.position
+          = (vec3_t){ (float)x * spacing - half, (float)y * spacing + 1.0f,
+                      -(float)z * spacing - 8.0f, 0 };
+      sphere.dimensions = (vec3_t){ 0.6f, 0.6f, 0.6f, 0 };
+      sphere.size = 0.6f;
+      sphere.roughness = 0.5f;
+      sphere.color = (vec4_t){ 0.3f + 0.7f * (float)x / (float)side,
+                               0.3f + 0.7f * (float)y / (float)side,
+                               0.3f + 0.7f * (float)z / (float)side, 1.0f };
+
+      shape_to_sdf_object (&sphere, &system->benchmark_objects[i]);
+    }
+
+  system->benchmark_object_count = count;
+
+  LOG_INFO ("RenderSystem", "Benchmark scene: %u spheres in a %u^3 grid",
+            count, side);
+
+  return RESULT_SUCCESS;
+}
+
 result_t
 render_system_collect_shapes (render_system_t *system, ecs_world_t *world)
 {
@@ -175,8 +515,12 @@ render_system_collect_shapes (render_system_t *system, ecs_world_t *world)
 
   component_array_t *shape_array = &world->component_arrays[shape_id];
 
-  for (size_t i = 0; i < shape_array->count && i < system->sdf_object_capacity;
-       i++)
+  result_t result = render_system_reserve_objects (
+      system, shape_array->count + system->benchmark_object_count);
+  if (result.code != RESULT_OK)
+    return result;
+
+  for (size_t i = 0; i < shape_array->count; i++)
     {
       if (!shape_array->active[i])
         {
@@ -198,18 +542,137 @@ render_system_collect_shapes (render_system_t *system, ecs_world_t *world)
       system->sdf_object_count++;
     }
 
-  for (size_t i = system->sdf_object_count; i < system->sdf_object_capacity;
-       i++)
+  if (system->benchmark_object_count > 0)
     {
-      memset (&system->sdf_objects[i], 0, sizeof (sdf_object_t));
+      memcpy (&system->sdf_objects[system->sdf_object_count],
+              system->benchmark_objects,
+              system->benchmark_object_count * sizeof (sdf_object_t));
+      system->sdf_object_count += system->benchmark_object_count;
     }
 
-  result_t result = gpu_buffer_upload (
-      system->raymarcher.vk_context, &system->raymarcher.sdf_objects_buffer,
-      system->sdf_objects,
-      sizeof (sdf_object_t) * system->sdf_object_capacity);
+  metrics_gauge_set (METRIC_GAUGE_RENDER_SDF_OBJECTS,
+                     (int64_t)system->sdf_object_count);
 
-  return result;
+  if (system->shape_world != world)
+    {
+      system->shape_world = world;
+      system->shape_mask = 0;
+    }
+  for (size_t i = 0; i < system->sdf_object_count; i++)
+    {
+      uint32_t type = (uint32_t)system->sdf_objects[i].dimensions.w;
+      if (type < 32)
+        system->shape_mask |= 1u << type;
+    }
+
+  /* Must happen before begin_frame hands out this frame's resources. */
+  result = raymarcher_set_shape_mask (&system->raymarcher, system->shape_mask);
+  if (result.code != RESULT_OK)
+    {
+      LOG_WARNING ("RenderSystem", "Shape variant not applied: %s",
+                   result.message);
+    }
+
+  result = sdf_bvh_build (&system->bvh, system->sdf_objects,
+                          (uint32_t)system->sdf_object_count);
+  if (result.code != RESULT_OK)
+    return result;
+
+  raymarcher_begin_frame (&system->raymarcher);
+  return raymarcher_upload_sdf_objects (
+      &system->raymarcher, system->bvh.objects, system->bvh.object_count,
+      system->bvh.unbounded_count, system->bvh.nodes,
+      system->bvh.node_count);
+}
+
+static result_t
+render_system_present (render_system_t *system, const gpu_image_t *source)
+{
+  raymarcher_t *raymarcher = &system->raymarcher;
+  vulkan_context_t *context = raymarcher->vk_context;
+  swapchain_t *swapchain = &system->swapchain;
+
+  /* Readback lags a frame or so behind; captures are written once their
+     frame's fence has signalled, never by waiting on it here. */
+  if (frame_capture_active (&system->capture))
+    frame_capture_cmd_copy (
+        &system->capture, context, raymarcher->frame_index,
+        raymarcher->frames[raymarcher->frame_index].fence,
+        raymarcher_get_command_buffer (raymarcher), source,
+        raymarcher->render_width, raymarcher->render_height);
+
+  if (system->headless)
+    {
+      result_t result
+          = raymarcher_end_frame (raymarcher, VK_NULL_HANDLE, VK_NULL_HANDLE);
+      if (result.code != RESULT_OK)
+        return result;
+      return frame_capture_poll (&system->capture, context);
+    }
+
+  uint32_t image_index;
+  result_t result = swapchain_acquire (context, swapchain,
+                                       raymarcher->frame_index, &image_index);
+  if (result.code != RESULT_OK)
+    {
+      /* Still run the passes so history and the frame fence stay valid. */
+      raymarcher_end_frame (raymarcher, VK_NULL_HANDLE, VK_NULL_HANDLE);
+      return result;
+    }
+
+  uint32_t frame_index = raymarcher->frame_index;
+  swapchain_cmd_blit (swapchain, raymarcher_get_command_buffer (raymarcher),
+                      frame_index, image_index, source,
+                      raymarcher->render_width, raymarcher->render_height);
+
+  result = raymarcher_end_frame (
+      raymarcher, swapchain->image_available_semaphores[frame_index],
+      swapchain->render_finished_semaphores[image_index]);
+  if (result.code != RESULT_OK)
+    return result;
+
+  result = swapchain_present (context, swapchain, image_index);
+  if (result.code != RESULT_OK)
+    return result;
+
+  return frame_capture_poll (&system->capture, context);
+}
+
+/* Recompiles only the passes whose source hash moved, so an edit to a
+   lighting include does not rebuild the raymarch pipelines. A shader that
+   fails to compile keeps its previous pipeline. */
+static void
+render_system_poll_shaders (render_system_t *system, float time)
+{
+  if (!system->shader_hot_reload
+      || time - system->shader_poll_time < SHADER_POLL_INTERVAL)
+    return;
+
+  system->shader_poll_time = time;
+  if (!shader_compiler_poll (&system->shader_compiler))
+    return;
+
+  for (uint32_t i = 0; i < RAYMARCH_SHADER_COUNT; i++)
+    {
+      uint64_t hash = shader_compiler_source_hash (&system->shader_compiler,
+                                                   shader_sources[i]);
+      if (hash == system->shader_hashes[i])
+        continue;
+      system->shader_hashes[i] = hash;
+
+      char path[SHADER_COMPILER_PATH_MAX + 64];
+      result_t result = shader_compiler_build (
+          &system->shader_compiler, shader_sources[i], path, sizeof (path));
+      if (result.code == RESULT_OK)
+        result = raymarcher_reload_shader (&system->raymarcher,
+                                           (raymarch_shader_t)i, path);
+
+      if (result.code == RESULT_OK)
+        LOG_INFO ("RenderSystem", "Reloaded %s", shader_sources[i]);
+      else
+        LOG_WARNING ("RenderSystem", "Kept previous %s: %s",
+                     shader_sources[i], result.message);
+    }
 }
 
 result_t
@@ -221,6 +684,34 @@ render_system_render_frame (render_system_t *system, ecs_world_t *world,
       return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER, "Invalid system");
     }
 
+  raymarcher_t *raymarcher = &system->raymarcher;
+  raymarcher_begin_frame (raymarcher);
+  gpu_timer_begin_frame (&system->gpu_timer);
+
+  /* The present blit and the overlay cost the same at any render scale,
+     so only the scene passes are held to the budget. */
+  if (system->dynamic_resolution.enabled
+      && dynamic_resolution_update (
+          &system->dynamic_resolution,
+          gpu_timer_get_scene_ms (&system->gpu_timer)))
+    {
+      float scale = system->dynamic_resolution.scale;
+      raymarcher_set_render_size (
+          raymarcher, (uint32_t)((float)raymarcher->width * scale + 0.5f),
+          (uint32_t)((float)raymarcher->height * scale + 0.5f));
+      metrics_gauge_set (METRIC_GAUGE_RENDER_SCALE_PERCENT,
+                         (int64_t)(scale * 100.0f + 0.5f));
+    }
+
+  render_system_poll_shaders (system, time);
+
+  uint64_t upload_bytes
+      = metrics_counter_get (METRIC_COUNTER_RENDER_UPLOAD_BYTES);
+  metrics_histogram_record (METRIC_HISTOGRAM_RENDER_UPLOAD_BYTES,
+                            upload_bytes - system->metrics_upload_mark);
+  system->metrics_upload_mark = upload_bytes;
+  metrics_counter_add (METRIC_COUNTER_RENDER_FRAMES, 1);
+
   raymarch_uniforms_t uniforms = { 0 };
 
   for (int i = 0; i < 4; i++)
@@ -241,8 +732,8 @@ render_system_render_frame (render_system_t *system, ecs_world_t *world,
       = (vec4_t){ system->camera_direction.x, system->camera_direction.y,
                   system->camera_direction.z, 0 };
 
-  uniforms.resolution = (vec2_t){ (float)system->raymarcher.width,
-                                  (float)system->raymarcher.height, 0, 0 };
+  uniforms.resolution = (vec2_t){ (float)raymarcher->render_width,
+                                  (float)raymarcher->render_height, 0, 0 };
 
   entity_id_t camera_entity_for_bg = INVALID_ENTITY;
   camera_component_t *camera_for_bg = NULL;
@@ -264,14 +755,6 @@ render_system_render_frame (render_system_t *system, ecs_world_t *world,
 
   uniforms.time = time;
 
-  uniforms.object_count = (system->sdf_object_count > MAX_SDF_OBJECTS)
-                              ? MAX_SDF_OBJECTS
-                              : system->sdf_object_count;
-
-  result_t result = raymarcher_execute (&system->raymarcher, &uniforms);
-  if (result.code != RESULT_OK)
-    return result;
-
   entity_id_t camera_entity = INVALID_ENTITY;
   camera_component_t *camera = NULL;
   lighting_component_t *lighting = NULL;
@@ -285,6 +768,28 @@ render_system_render_frame (render_system_t *system, ecs_world_t *world,
         }
     }
 
+  /* Switching presets rebuilds pipelines, so only on an actual change. */
+  if (lighting && lighting->quality != system->quality
+      && (uint32_t)lighting->quality < RAYMARCH_QUALITY_COUNT)
+    {
+      system->quality = lighting->quality;
+      raymarch_quality_t quality = raymarch_quality_from_preset (
+          (raymarch_quality_preset_t)lighting->quality);
+      result_t quality_result = raymarcher_set_quality (raymarcher, &quality);
+      if (quality_result.code != RESULT_OK)
+        {
+          LOG_WARNING ("RenderSystem", "Quality preset not applied: %s",
+                       quality_result.message);
+        }
+    }
+
+  result_t result = raymarcher_execute (&system->raymarcher, &uniforms);
+  if (result.code != RESULT_OK)
+    {
+      raymarcher_abort_frame (raymarcher);
+      return result;
+    }
+
   if (lighting && lighting->enabled && system->raymarcher.lighting_pipeline)
     {
       lighting_uniforms_t lighting_uniforms = { 0 };
@@ -302,8 +807,8 @@ render_system_render_frame (render_system_t *system, ecs_world_t *world,
           = (vec4_t){ system->camera_direction.x, system->camera_direction.y,
                       system->camera_direction.z, 0 };
       lighting_uniforms.resolution
-          = (vec2_t){ (float)system->raymarcher.width,
-                      (float)system->raymarcher.height, 0, 0 };
+          = (vec2_t){ (float)raymarcher->render_width,
+                      (float)raymarcher->render_height, 0, 0 };
       if (camera)
         {
           lighting_uniforms.background_color
@@ -322,29 +827,101 @@ render_system_render_frame (render_system_t *system, ecs_world_t *world,
       lighting_uniforms.shadow_bias = lighting->shadow_bias;
       lighting_uniforms.shadow_softness = lighting->shadow_softness;
       lighting_uniforms.shadow_steps = (uint32_t)lighting->shadow_steps;
-      lighting_uniforms.object_count
-          = (system->sdf_object_count > MAX_SDF_OBJECTS)
-                ? MAX_SDF_OBJECTS
-                : system->sdf_object_count;
+      lighting_uniforms.shadow_ao_scale
+          = lighting->shadow_downsample > 0
+                ? (uint32_t)lighting->shadow_downsample
+                : 1;
+      lighting_uniforms.temporal_shadows = lighting->temporal_shadows;
 
       result = raymarcher_execute_lighting (&system->raymarcher,
                                             &lighting_uniforms);
       if (result.code != RESULT_OK)
-        return result;
+        {
+          raymarcher_abort_frame (raymarcher);
+          return result;
+        }
 
-      return swapchain_present (system->raymarcher.vk_context,
-                                &system->swapchain,
-                                raymarcher_get_final (&system->raymarcher));
+      developer_overlay_component_t *overlay
+          = developer_overlay_find_active (world);
+      if (overlay && system->raymarcher.overlay_pipeline)
+        {
+          build_overlay_data (system, overlay, &system->overlay_data);
+          result = raymarcher_execute_overlay (&system->raymarcher,
+                                              &system->overlay_data);
+          if (result.code != RESULT_OK)
+            {
+              raymarcher_abort_frame (raymarcher);
+              return result;
+            }
+        }
+
+      return render_system_present (system,
+                                    raymarcher_get_final (raymarcher));
     }
   else
     {
 
-      return swapchain_present (
-          system->raymarcher.vk_context, &system->swapchain,
-          raymarcher_get_color_depth (&system->raymarcher));
+      return render_system_present (system,
+                                    raymarcher_get_color (raymarcher));
     }
 }
 
+void
+render_system_set_frame_budget (render_system_t *system, float target_ms)
+{
+  if (!system)
+    return;
+
+  dynamic_resolution_init (&system->dynamic_resolution, target_ms);
+  raymarcher_set_render_size (&system->raymarcher, system->raymarcher.width,
+                              system->raymarcher.height);
+  metrics_gauge_set (METRIC_GAUGE_RENDER_SCALE_PERCENT, 100);
+}
+
+result_t
+render_system_set_capture (render_system_t *system, const char *path_pattern)
+{
+  if (!system)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER, "Invalid system");
+    }
+
+  frame_capture_destroy (system->raymarcher.vk_context, &system->capture);
+  if (!path_pattern)
+    return RESULT_SUCCESS;
+
+  return frame_capture_create (system->raymarcher.vk_context,
+                               system->raymarcher.width,
+                               system->raymarcher.height, path_pattern,
+                               &system->capture);
+}
+
+void
+render_system_set_shader_hot_reload (render_system_t *system, bool enabled)
+{
+  if (!system)
+    return;
+
+  if (enabled && !system->shader_compiler.available)
+    {
+      LOG_WARNING ("RenderSystem",
+                   "Shader hot reload needs runtime shader compilation");
+      enabled = false;
+    }
+
+  system->shader_hot_reload = enabled;
+}
+
+double
+render_system_get_gpu_time_ms (const render_system_t *system,
+                               gpu_timer_pass_t pass)
+{
+  if (!system)
+    return 0.0;
+
+  return gpu_timer_get_ms (&system->gpu_timer, pass);
+}
+
 void
 render_system_set_camera (render_system_t *system, vec3_t position,
                           vec3_t direction)
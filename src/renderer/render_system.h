@@ -1,9 +1,14 @@
 #ifndef HITE_RENDER_SYSTEM_H
 #define HITE_RENDER_SYSTEM_H
 
+#include "../components/lighting_component.h"
 #include "../components/shape_component.h"
 #include "../core/ecs.h"
+#include "dynamic_resolution.h"
+#include "frame_capture.h"
 #include "raymarcher.h"
+#include "sdf_bvh.h"
+#include "shader_compiler.h"
 #include "swapchain.h"
 #include <GLFW/glfw3.h>
 
@@ -11,6 +16,9 @@ typedef struct
 {
   raymarcher_t raymarcher;
   swapchain_t swapchain;
+  bool headless;
+  frame_capture_t capture;
+  gpu_timer_t gpu_timer;
   GLFWwindow *window;
 
   vec3_t camera_position;
@@ -20,8 +28,33 @@ typedef struct
   sdf_object_t *sdf_objects;
   size_t sdf_object_count;
   size_t sdf_object_capacity;
+
+  sdf_bvh_t bvh;
+
+  sdf_object_t *benchmark_objects;
+  uint32_t benchmark_object_count;
+
+  overlay_data_t overlay_data;
+
+  dynamic_resolution_t dynamic_resolution;
+  lighting_quality_t quality;
+
+  /* Shape types seen since shape_world was loaded; only ever grows so a
+     shape toggling visibility does not rebuild pipelines every frame. */
+  const ecs_world_t *shape_world;
+  uint32_t shape_mask;
+
+  uint64_t metrics_upload_mark;
+
+  char pipeline_cache_path[1024];
+
+  shader_compiler_t shader_compiler;
+  bool shader_hot_reload;
+  float shader_poll_time;
+  uint64_t shader_hashes[RAYMARCH_SHADER_COUNT];
 } render_system_t;
 
+/* A NULL window renders headless, without a surface or swapchain. */
 result_t render_system_init (render_system_t *system,
                              vulkan_context_t *vk_context, GLFWwindow *window,
                              uint32_t width, uint32_t height);
@@ -30,9 +63,25 @@ void render_system_cleanup (render_system_t *system);
 result_t render_system_collect_shapes (render_system_t *system,
                                        ecs_world_t *world);
 
+result_t render_system_set_benchmark_objects (render_system_t *system,
+                                              uint32_t count);
+
 result_t render_system_render_frame (render_system_t *system,
                                      ecs_world_t *world, float time);
 
+void render_system_set_frame_budget (render_system_t *system,
+                                     float target_ms);
+/* Writes every following frame to path_pattern (see frame_capture_t);
+   NULL stops capturing. */
+result_t render_system_set_capture (render_system_t *system,
+                                    const char *path_pattern);
+/* Watches the shader sources and swaps in recompiled passes on edit. */
+void render_system_set_shader_hot_reload (render_system_t *system,
+                                          bool enabled);
+
+double render_system_get_gpu_time_ms (const render_system_t *system,
+                                      gpu_timer_pass_t pass);
+
 void render_system_set_camera (render_system_t *system, vec3_t position,
                                vec3_t direction);
 void render_system_move_camera (render_system_t *system, vec3_t delta);
@@ -0,0 +1,339 @@
+#include "sdf_bvh.h"
+#include "../components/shape_component.h"
+#include "../core/allocator.h"
+
+#include <float.h>
+#include <string.h>
+
+typedef struct
+{
+  float min[3];
+  float max[3];
+} sdf_aabb_t;
+
+typedef struct
+{
+  sdf_aabb_t bounds;
+  uint32_t count;
+} sdf_bvh_bin_t;
+
+static void
+aabb_reset (sdf_aabb_t *box)
+{
+  for (int axis = 0; axis < 3; axis++)
+    {
+      box->min[axis] = FLT_MAX;
+      box->max[axis] = -FLT_MAX;
+    }
+}
+
+static void
+aabb_grow (sdf_aabb_t *box, const float *min, const float *max)
+{
+  for (int axis = 0; axis < 3; axis++)
+    {
+      if (min[axis] < box->min[axis])
+        box->min[axis] = min[axis];
+      if (max[axis] > box->max[axis])
+        box->max[axis] = max[axis];
+    }
+}
+
+static float
+aabb_area (const sdf_aabb_t *box)
+{
+  float dx = box->max[0] - box->min[0];
+  float dy = box->max[1] - box->min[1];
+  float dz = box->max[2] - box->min[2];
+  if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+    return 0.0f;
+  return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static bool
+object_bounds (const sdf_object_t *object, float *min, float *max)
+{
+  float extent[3];
+  switch ((int)object->dimensions.w)
+    {
+    case SHAPE_SPHERE:
+      extent[0] = extent[1] = extent[2] = object->position.w;
+      break;
+    case SHAPE_BOX:
+      extent[0] = object->dimensions.x;
+      extent[1] = object->dimensions.y;
+      extent[2] = object->dimensions.z;
+      break;
+    case SHAPE_TORUS:
+      extent[0] = extent[2] = object->dimensions.x + object->dimensions.y;
+      extent[1] = object->dimensions.y;
+      break;
+    default:
+      return false;
+    }
+
+  const float center[3]
+      = { object->position.x, object->position.y, object->position.z };
+  for (int axis = 0; axis < 3; axis++)
+    {
+      float e = extent[axis] < 0.0f ? -extent[axis] : extent[axis];
+      min[axis] = center[axis] - e;
+      max[axis] = center[axis] + e;
+    }
+  return true;
+}
+
+static result_t
+sdf_bvh_reserve (sdf_bvh_t *bvh, uint32_t count)
+{
+  if (count <= bvh->capacity)
+    return RESULT_SUCCESS;
+
+  uint32_t capacity = bvh->capacity > 0 ? bvh->capacity : 256;
+  while (capacity < count)
+    capacity *= 2;
+
+  sdf_object_t *objects
+      = mem_alloc (MEM_TAG_RENDERER, capacity * sizeof (sdf_object_t));
+  sdf_object_t *source
+      = mem_alloc (MEM_TAG_RENDERER, capacity * sizeof (sdf_object_t));
+  sdf_bvh_node_t *nodes
+      = mem_alloc (MEM_TAG_RENDERER, 2 * capacity * sizeof (sdf_bvh_node_t));
+  uint32_t *indices
+      = mem_alloc (MEM_TAG_RENDERER, capacity * sizeof (uint32_t));
+  float *bounds = mem_alloc (MEM_TAG_RENDERER, capacity * 6 * sizeof (float));
+  if (!objects || !source || !nodes || !indices || !bounds)
+    {
+      mem_free (objects);
+      mem_free (source);
+      mem_free (nodes);
+      mem_free (indices);
+      mem_free (bounds);
+      return RESULT_ERROR (RESULT_ERROR_ALLOCATION,
+                           "Failed to allocate BVH storage");
+    }
+
+  sdf_bvh_destroy (bvh);
+  bvh->objects = objects;
+  bvh->source = source;
+  bvh->nodes = nodes;
+  bvh->indices = indices;
+  bvh->bounds = bounds;
+  bvh->capacity = capacity;
+
+  return RESULT_SUCCESS;
+}
+
+static void
+sdf_bvh_make_leaf (sdf_bvh_t *bvh, sdf_bvh_node_t *node, uint32_t first,
+                   uint32_t count)
+{
+  node->left_first = bvh->unbounded_count + first;
+  node->count = count;
+}
+
+static void
+sdf_bvh_build_node (sdf_bvh_t *bvh, uint32_t node_index, uint32_t first,
+                    uint32_t count, uint32_t depth)
+{
+  sdf_bvh_node_t *node = &bvh->nodes[node_index];
+  uint32_t *indices = bvh->indices;
+
+  sdf_aabb_t bounds, centroid_bounds;
+  aabb_reset (&bounds);
+  aabb_reset (&centroid_bounds);
+  for (uint32_t i = first; i < first + count; i++)
+    {
+      const float *box = &bvh->bounds[indices[i] * 6];
+      float centroid[3] = { (box[0] + box[3]) * 0.5f, (box[1] + box[4]) * 0.5f,
+                            (box[2] + box[5]) * 0.5f };
+      aabb_grow (&bounds, box, box + 3);
+      aabb_grow (&centroid_bounds, centroid, centroid);
+    }
+
+  memcpy (node->bounds_min, bounds.min, sizeof (bounds.min));
+  memcpy (node->bounds_max, bounds.max, sizeof (bounds.max));
+
+  if (count <= SDF_BVH_LEAF_SIZE || depth >= SDF_BVH_MAX_DEPTH)
+    {
+      sdf_bvh_make_leaf (bvh, node, first, count);
+      return;
+    }
+
+  int best_axis = -1;
+  uint32_t best_split = 0;
+  float best_cost = aabb_area (&bounds) * (float)count;
+
+  for (int axis = 0; axis < 3; axis++)
+    {
+      float lo = centroid_bounds.min[axis];
+      float extent = centroid_bounds.max[axis] - lo;
+      if (extent <= 0.0f)
+        continue;
+
+      sdf_bvh_bin_t bins[SDF_BVH_BINS];
+      for (int b = 0; b < SDF_BVH_BINS; b++)
+        {
+          aabb_reset (&bins[b].bounds);
+          bins[b].count = 0;
+        }
+
+      float scale = (float)SDF_BVH_BINS / extent;
+      for (uint32_t i = first; i < first + count; i++)
+        {
+          const float *box = &bvh->bounds[indices[i] * 6];
+          float centroid = (box[axis] + box[axis + 3]) * 0.5f;
+          int b = (int)((centroid - lo) * scale);
+          b = b < 0 ? 0 : (b >= SDF_BVH_BINS ? SDF_BVH_BINS - 1 : b);
+          aabb_grow (&bins[b].bounds, box, box + 3);
+          bins[b].count++;
+        }
+
+      float left_area[SDF_BVH_BINS - 1];
+      uint32_t left_count[SDF_BVH_BINS - 1];
+      sdf_aabb_t acc;
+      aabb_reset (&acc);
+      uint32_t acc_count = 0;
+      for (int b = 0; b < SDF_BVH_BINS - 1; b++)
+        {
+          aabb_grow (&acc, bins[b].bounds.min, bins[b].bounds.max);
+          acc_count += bins[b].count;
+          left_area[b] = aabb_area (&acc);
+          left_count[b] = acc_count;
+        }
+
+      aabb_reset (&acc);
+      acc_count = 0;
+      for (int b = SDF_BVH_BINS - 1; b > 0; b--)
+        {
+          aabb_grow (&acc, bins[b].bounds.min, bins[b].bounds.max);
+          acc_count += bins[b].count;
+          if (left_count[b - 1] == 0 || acc_count == 0)
+            continue;
+
+          float cost = left_area[b - 1] * (float)left_count[b - 1]
+                       + aabb_area (&acc) * (float)acc_count;
+          if (cost < best_cost)
+            {
+              best_cost = cost;
+              best_axis = axis;
+              best_split = (uint32_t)b;
+            }
+        }
+    }
+
+  uint32_t mid = first;
+  if (best_axis >= 0)
+    {
+      float lo = centroid_bounds.min[best_axis];
+      float scale = (float)SDF_BVH_BINS
+                    / (centroid_bounds.max[best_axis] - lo);
+      uint32_t i = first;
+      uint32_t j = first + count;
+      while (i < j)
+        {
+          const float *box = &bvh->bounds[indices[i] * 6];
+          float centroid = (box[best_axis] + box[best_axis + 3]) * 0.5f;
+          int b = (int)((centroid - lo) * scale);
+          if (b >= SDF_BVH_BINS)
+            b = SDF_BVH_BINS - 1;
+          if ((uint32_t)(b < 0 ? 0 : b) < best_split)
+            {
+              i++;
+            }
+          else
+            {
+              uint32_t tmp = indices[i];
+              indices[i] = indices[--j];
+              indices[j] = tmp;
+            }
+        }
+      mid = i;
+    }
+  else if (count > SDF_BVH_LEAF_SIZE * 4)
+    {
+      mid = first + count / 2;
+    }
+
+  if (mid == first || mid == first + count)
+    {
+      sdf_bvh_make_leaf (bvh, node, first, count);
+      return;
+    }
+
+  uint32_t left = bvh->node_count;
+  bvh->node_count += 2;
+
+  node->left_first = left;
+  node->count = 0;
+
+  sdf_bvh_build_node (bvh, left, first, mid - first, depth + 1);
+  sdf_bvh_build_node (bvh, left + 1, mid, first + count - mid, depth + 1);
+}
+
+result_t
+sdf_bvh_build (sdf_bvh_t *bvh, const sdf_object_t *objects, uint32_t count)
+{
+  if (!bvh || (!objects && count > 0))
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Invalid parameters");
+    }
+
+  if (bvh->capacity > 0 && count == bvh->object_count
+      && memcmp (bvh->source, objects, count * sizeof (sdf_object_t)) == 0)
+    {
+      return RESULT_SUCCESS;
+    }
+
+  result_t result = sdf_bvh_reserve (bvh, count);
+  if (result.code != RESULT_OK)
+    return result;
+
+  if (count > 0)
+    memcpy (bvh->source, objects, count * sizeof (sdf_object_t));
+  bvh->object_count = count;
+  bvh->unbounded_count = 0;
+  bvh->node_count = 0;
+
+  uint32_t bounded_count = 0;
+  for (uint32_t i = 0; i < count; i++)
+    {
+      float *box = &bvh->bounds[i * 6];
+      if (object_bounds (&objects[i], box, box + 3))
+        {
+          bvh->indices[bounded_count++] = i;
+        }
+      else
+        {
+          bvh->objects[bvh->unbounded_count++] = objects[i];
+        }
+    }
+
+  if (bounded_count == 0)
+    return RESULT_SUCCESS;
+
+  bvh->node_count = 1;
+  sdf_bvh_build_node (bvh, 0, 0, bounded_count, 0);
+
+  for (uint32_t i = 0; i < bounded_count; i++)
+    {
+      bvh->objects[bvh->unbounded_count + i] = objects[bvh->indices[i]];
+    }
+
+  return RESULT_SUCCESS;
+}
+
+void
+sdf_bvh_destroy (sdf_bvh_t *bvh)
+{
+  if (!bvh)
+    return;
+
+  mem_free (bvh->objects);
+  mem_free (bvh->source);
+  mem_free (bvh->nodes);
+  mem_free (bvh->indices);
+  mem_free (bvh->bounds);
+  memset (bvh, 0, sizeof (sdf_bvh_t));
+}
@@ -0,0 +1,29 @@
+#ifndef HITE_SDF_BVH_H
+#define HITE_SDF_BVH_H
+
+#include "../../shaders/common/sdf_bvh_constants.glsl"
+#include "raymarcher.h"
+
+#define SDF_BVH_LEAF_SIZE 4
+#define SDF_BVH_BINS 12
+
+typedef struct
+{
+  sdf_object_t *objects;
+  uint32_t object_count;
+  uint32_t unbounded_count;
+
+  sdf_bvh_node_t *nodes;
+  uint32_t node_count;
+
+  uint32_t capacity;
+  sdf_object_t *source;
+  uint32_t *indices;
+  float *bounds;
+} sdf_bvh_t;
+
+result_t sdf_bvh_build (sdf_bvh_t *bvh, const sdf_object_t *objects,
+                        uint32_t count);
+void sdf_bvh_destroy (sdf_bvh_t *bvh);
+
+#endif
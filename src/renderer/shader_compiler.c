@@ -0,0 +1,612 @@
+#include "shader_compiler.h"
+#include "../core/allocator.h"
+#include "../core/logger.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef HITE_HAVE_SHADERC
+#include <shaderc/shaderc.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+#define SHADER_INCLUDE_DEPTH_MAX 16
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+#define SHADER_VERSION_MAX 512
+
+#ifdef HITE_HAVE_SHADERC
+#define SHADER_TOOLCHAIN "shaderc target=vulkan1.0 stage=comp entry=main"
+#else
+#define SHADER_TOOLCHAIN "glslangValidator -V"
+#endif
+
+static char *
+read_text_file (const char *path, size_t *out_size)
+{
+  FILE *file = fopen (path, "rb");
+  if (!file)
+    return NULL;
+
+  fseek (file, 0, SEEK_END);
+  long size = ftell (file);
+  fseek (file, 0, SEEK_SET);
+  if (size < 0)
+    {
+      fclose (file);
+      return NULL;
+    }
+
+  char *buffer = mem_alloc (MEM_TAG_RENDERER, (size_t)size + 1);
+  if (!buffer)
+    {
+      fclose (file);
+      return NULL;
+    }
+
+  size_t read = fread (buffer, 1, (size_t)size, file);
+  fclose (file);
+  buffer[read] = '\0';
+
+  if (out_size)
+    *out_size = read;
+  return buffer;
+}
+
+static bool
+file_exists (const char *path)
+{
+  struct stat st;
+  return stat (path, &st) == 0 && S_ISREG (st.st_mode);
+}
+
+static bool
+dir_exists (const char *path)
+{
+  struct stat st;
+  return stat (path, &st) == 0 && S_ISDIR (st.st_mode);
+}
+
+/* Same lookup order as the build: next to the includer, then the root. */
+static bool
+resolve_include (const shader_compiler_t *compiler, const char *includer,
+                 const char *name, char *out_path, size_t size)
+{
+  const char *slash = strrchr (includer, '/');
+  int dir_length = slash ? (int)(slash - includer) : 1;
+  const char *dir = slash ? includer : ".";
+
+  int written = snprintf (out_path, size, "%.*s/%s", dir_length, dir, name);
+  if (written > 0 && (size_t)written < size && file_exists (out_path))
+    return true;
+
+  written = snprintf (out_path, size, "%s/%s", compiler->source_dir, name);
+  return written > 0 && (size_t)written < size && file_exists (out_path);
+}
+
+static uint64_t
+hash_bytes (uint64_t hash, const char *data, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+    {
+      hash ^= (unsigned char)data[i];
+      hash *= FNV_PRIME;
+    }
+  return hash;
+}
+
+static uint64_t
+hash_source_tree (const shader_compiler_t *compiler, const char *path,
+                  uint64_t hash, uint32_t depth)
+{
+  if (depth > SHADER_INCLUDE_DEPTH_MAX)
+    return hash;
+
+  size_t size = 0;
+  char *source = read_text_file (path, &size);
+  if (!source)
+    return hash;
+
+  hash = hash_bytes (hash, source, size);
+
+  for (char *line = source; line && *line;)
+    {
+      char *next = strchr (line, '\n');
+      while (*line == ' ' || *line == '\t')
+        line++;
+
+      if (strncmp (line, "#include", 8) == 0)
+        {
+          char *open = strchr (line, '"');
+          char *close = open ? strchr (open + 1, '"') : NULL;
+          if (close && (!next || close < next))
+            {
+              char name[SHADER_COMPILER_PATH_MAX];
+              char include_path[SHADER_COMPILER_PATH_MAX];
+              snprintf (name, sizeof (name), "%.*s", (int)(close - open - 1),
+                        open + 1);
+              if (resolve_include (compiler, path, name, include_path,
+                                   sizeof (include_path)))
+                hash = hash_source_tree (compiler, include_path, hash,
+                                         depth + 1);
+            }
+        }
+
+      line = next ? next + 1 : NULL;
+    }
+
+  mem_free (source);
+  return hash;
+}
+
+static uint64_t
+newest_mtime (const char *dir_path, uint32_t depth)
+{
+  uint64_t newest = 0;
+  DIR *dir = opendir (dir_path);
+  if (!dir)
+    return 0;
+
+  struct dirent *entry;
+  while ((entry = readdir (dir)) != NULL)
+    {
+      if (entry->d_name[0] == '.')
+        continue;
+
+      char path[SHADER_COMPILER_PATH_MAX];
+      int written
+          = snprintf (path, sizeof (path), "%s/%s", dir_path, entry->d_name);
+      if (written < 0 || (size_t)written >= sizeof (path))
+        continue;
+
+      struct stat st;
+      if (stat (path, &st) != 0)
+        continue;
+
+      uint64_t stamp = (uint64_t)st.st_mtim.tv_sec * 1000000000ull
+                       + (uint64_t)st.st_mtim.tv_nsec;
+      if (S_ISDIR (st.st_mode) && depth < SHADER_INCLUDE_DEPTH_MAX)
+        {
+          uint64_t child = newest_mtime (path, depth + 1);
+          if (child > stamp)
+            stamp = child;
+        }
+      if (stamp > newest)
+        newest = stamp;
+    }
+
+  closedir (dir);
+  return newest;
+}
+
+/* Removes cache entries for file_name other than the current one, so hot
+   reload does not leave one file behind per edit. */
+static void
+prune_cache (const shader_compiler_t *compiler, const char *file_name,
+             const char *current_path)
+{
+  DIR *dir = opendir (compiler->cache_dir);
+  if (!dir)
+    return;
+
+  const char *current = strrchr (current_path, '/');
+  current = current ? current + 1 : current_path;
+  size_t name_length = strlen (file_name);
+
+  struct dirent *entry;
+  while ((entry = readdir (dir)) != NULL)
+    {
+      const char *name = entry->d_name;
+      if (strncmp (name, file_name, name_length) != 0
+          || strcmp (name, current) == 0)
+        continue;
+
+      /* Exactly "<file_name>.<16 hex digits>.spv". */
+      const char *suffix = name + name_length;
+      if (suffix[0] != '.' || strlen (suffix) != 21
+          || strspn (suffix + 1, "0123456789abcdef") != 16
+          || strcmp (suffix + 17, ".spv") != 0)
+        continue;
+
+      char path[SHADER_COMPILER_PATH_MAX];
+      int written
+          = snprintf (path, sizeof (path), "%s/%s", compiler->cache_dir, name);
+      if (written > 0 && (size_t)written < sizeof (path))
+        remove (path);
+    }
+
+  closedir (dir);
+}
+
+#ifdef HITE_HAVE_SHADERC
+static result_t
+write_spirv (const char *path, const void *code, size_t size)
+{
+  char tmp_path[SHADER_COMPILER_PATH_MAX + 8];
+  snprintf (tmp_path, sizeof (tmp_path), "%s.tmp", path);
+
+  FILE *file = fopen (tmp_path, "wb");
+  if (!file)
+    return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                         "Failed to open shader cache entry");
+
+  size_t written = fwrite (code, 1, size, file);
+  if (fclose (file) != 0 || written != size || rename (tmp_path, path) != 0)
+    {
+      remove (tmp_path);
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to write shader cache entry");
+    }
+
+  return RESULT_SUCCESS;
+}
+
+static shaderc_include_result *
+shaderc_resolve_include (void *user_data, const char *requested_source,
+                         int type, const char *requesting_source,
+                         size_t include_depth)
+{
+  (void)type;
+  (void)include_depth;
+  const shader_compiler_t *compiler = user_data;
+
+  shaderc_include_result *result
+      = mem_calloc (MEM_TAG_RENDERER, 1, sizeof (*result));
+  char *path = mem_alloc (MEM_TAG_RENDERER, SHADER_COMPILER_PATH_MAX);
+  if (!result || !path)
+    {
+      mem_free (result);
+      mem_free (path);
+      return NULL;
+    }
+
+  size_t size = 0;
+  char *content = NULL;
+  if (resolve_include (compiler, requesting_source, requested_source, path,
+                       SHADER_COMPILER_PATH_MAX))
+    content = read_text_file (path, &size);
+
+  if (!content)
+    {
+      /* An empty source name tells shaderc the include failed. */
+      path[0] = '\0';
+      content = mem_alloc (MEM_TAG_RENDERER, 32);
+      if (content)
+        size = (size_t)snprintf (content, 32, "include not found");
+    }
+
+  result->source_name = path;
+  result->source_name_length = strlen (path);
+  result->content = content;
+  result->content_length = content ? size : 0;
+  return result;
+}
+
+static void
+shaderc_release_include (void *user_data, shaderc_include_result *result)
+{
+  (void)user_data;
+  mem_free ((void *)result->source_name);
+  mem_free ((void *)result->content);
+  mem_free (result);
+}
+
+static result_t
+compile_spirv (shader_compiler_t *compiler, const char *source_path,
+               const char *spirv_path)
+{
+  size_t size = 0;
+  char *source = read_text_file (source_path, &size);
+  if (!source)
+    return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                         "Shader source not found");
+
+  shaderc_compile_options_t options = shaderc_compile_options_initialize ();
+  shaderc_compile_options_set_include_callbacks (
+      options, shaderc_resolve_include, shaderc_release_include, compiler);
+  shaderc_compile_options_set_target_env (options, shaderc_target_env_vulkan,
+                                          shaderc_env_version_vulkan_1_0);
+
+  shaderc_compilation_result_t compiled = shaderc_compile_into_spv (
+      (shaderc_compiler_t)compiler->backend, source, size,
+      shaderc_compute_shader, source_path, "main", options);
+  shaderc_compile_options_release (options);
+  mem_free (source);
+
+  result_t result = RESULT_SUCCESS;
+  if (shaderc_result_get_compilation_status (compiled)
+      != shaderc_compilation_status_success)
+    {
+      LOG_ERROR ("ShaderCompiler", "%s", shaderc_result_get_error_message (
+                                             compiled));
+      result = RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
+                             "Shader compilation failed");
+    }
+  else
+    {
+      result = write_spirv (spirv_path, shaderc_result_get_bytes (compiled),
+                            shaderc_result_get_length (compiled));
+    }
+
+  shaderc_result_release (compiled);
+  return result;
+}
+#else
+/* Spawned without a shell so paths are passed through untouched. With
+   output set, stdout is captured there and stderr discarded. */
+static bool
+run_glslang (char *const argv[], char *output, size_t output_size)
+{
+  int pipe_fds[2] = { -1, -1 };
+  if (output && pipe (pipe_fds) != 0)
+    return false;
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init (&actions);
+  if (output)
+    {
+      posix_spawn_file_actions_addclose (&actions, pipe_fds[0]);
+      posix_spawn_file_actions_adddup2 (&actions, pipe_fds[1],
+                                        STDOUT_FILENO);
+      posix_spawn_file_actions_addclose (&actions, pipe_fds[1]);
+      posix_spawn_file_actions_addopen (&actions, STDERR_FILENO, "/dev/null",
+                                        O_WRONLY, 0);
+    }
+
+  pid_t pid;
+  int error = posix_spawnp (&pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy (&actions);
+
+  if (output)
+    {
+      close (pipe_fds[1]);
+      size_t length = 0;
+      ssize_t count = 1;
+      while (error == 0 && count > 0)
+        {
+          char chunk[256];
+          count = read (pipe_fds[0], chunk, sizeof (chunk));
+          if (count < 0 && errno == EINTR)
+            count = 1;
+          else if (count > 0 && length + 1 < output_size)
+            {
+              size_t keep = output_size - 1 - length;
+              if ((size_t)count < keep)
+                keep = (size_t)count;
+              memcpy (output + length, chunk, keep);
+              length += keep;
+            }
+        }
+      output[length] = '\0';
+      close (pipe_fds[0]);
+    }
+
+  if (error != 0)
+    return false;
+
+  int status = 0;
+  while (waitpid (pid, &status, 0) < 0)
+    {
+      if (errno != EINTR)
+        return false;
+    }
+  return WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+static result_t
+compile_spirv (shader_compiler_t *compiler, const char *source_path,
+               const char *spirv_path)
+{
+  char tmp_path[SHADER_COMPILER_PATH_MAX + 8];
+  snprintf (tmp_path, sizeof (tmp_path), "%s.tmp", spirv_path);
+
+  char include_arg[SHADER_COMPILER_PATH_MAX + 2];
+  int written = snprintf (include_arg, sizeof (include_arg), "-I%s",
+                          compiler->source_dir);
+  if (written < 0 || (size_t)written >= sizeof (include_arg))
+    return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                         "Shader path too long");
+
+  char *argv[] = { "glslangValidator", "-V", include_arg,
+                   (char *)source_path, "-o", tmp_path, NULL };
+  if (!run_glslang (argv, NULL, 0))
+    {
+      remove (tmp_path);
+      return RESULT_ERROR (RESULT_ERROR_SHADER_COMPILATION,
+                           "Shader compilation failed");
+    }
+
+  if (rename (tmp_path, spirv_path) != 0)
+    {
+      remove (tmp_path);
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to write shader cache entry");
+    }
+
+  return RESULT_SUCCESS;
+}
+#endif
+
+static bool
+find_source_dir (char *out_dir, size_t size)
+{
+  static const char *search_dirs[] = {
+#ifdef HITE_SHADER_SOURCE_DIR
+    HITE_SHADER_SOURCE_DIR,
+#endif
+    "shaders", "../shaders", NULL
+  };
+
+  for (int i = 0; search_dirs[i] != NULL; i++)
+    {
+      char probe[SHADER_COMPILER_PATH_MAX];
+      snprintf (probe, sizeof (probe), "%s/raymarch.comp", search_dirs[i]);
+      if (file_exists (probe))
+        {
+          snprintf (out_dir, size, "%s", search_dirs[i]);
+          return true;
+        }
+    }
+
+  return false;
+}
+
+result_t
+shader_compiler_init (shader_compiler_t *compiler, const char *cache_dir)
+{
+  if (!compiler || !cache_dir)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Invalid parameters");
+    }
+
+  memset (compiler, 0, sizeof (*compiler));
+
+  if (!find_source_dir (compiler->source_dir, sizeof (compiler->source_dir)))
+    {
+      return RESULT_ERROR (RESULT_ERROR_NOT_FOUND,
+                           "Shader sources not found");
+    }
+
+  int written = snprintf (compiler->cache_dir, sizeof (compiler->cache_dir),
+                          "%s", cache_dir);
+  if (written < 0 || (size_t)written >= sizeof (compiler->cache_dir))
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Shader cache path too long");
+    }
+
+  if (!dir_exists (compiler->cache_dir)
+      && mkdir (compiler->cache_dir, 0755) != 0 && errno != EEXIST)
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Failed to create shader cache directory");
+    }
+
+#ifdef HITE_HAVE_SHADERC
+  compiler->backend = shaderc_compiler_initialize ();
+  if (!compiler->backend)
+    {
+      return RESULT_ERROR (RESULT_ERROR_DEPENDENCY_MISSING,
+                           "Failed to initialize shaderc");
+    }
+
+  unsigned int spv_version = 0, spv_revision = 0;
+  shaderc_get_spv_version (&spv_version, &spv_revision);
+  char version[SHADER_VERSION_MAX];
+  snprintf (version, sizeof (version), "spv %u.%u", spv_version,
+            spv_revision);
+#else
+  char version[SHADER_VERSION_MAX];
+  char *argv[] = { "glslangValidator", "--version", NULL };
+  if (!run_glslang (argv, version, sizeof (version)))
+    {
+      return RESULT_ERROR (RESULT_ERROR_DEPENDENCY_MISSING,
+                           "glslangValidator not found in PATH");
+    }
+#endif
+
+  compiler->toolchain_hash = hash_bytes (
+      FNV_OFFSET_BASIS, SHADER_TOOLCHAIN, sizeof (SHADER_TOOLCHAIN));
+  compiler->toolchain_hash
+      = hash_bytes (compiler->toolchain_hash, version, strlen (version));
+
+  compiler->sources_stamp = newest_mtime (compiler->source_dir, 0);
+  compiler->available = true;
+
+  LOG_INFO ("ShaderCompiler", "Compiling shaders from %s, cache in %s",
+            compiler->source_dir, compiler->cache_dir);
+
+  return RESULT_SUCCESS;
+}
+
+void
+shader_compiler_shutdown (shader_compiler_t *compiler)
+{
+  if (!compiler)
+    return;
+
+#ifdef HITE_HAVE_SHADERC
+  if (compiler->backend)
+    shaderc_compiler_release ((shaderc_compiler_t)compiler->backend);
+#endif
+  compiler->backend = NULL;
+  compiler->available = false;
+}
+
+uint64_t
+shader_compiler_source_hash (const shader_compiler_t *compiler,
+                             const char *file_name)
+{
+  char path[SHADER_COMPILER_PATH_MAX];
+  int written = snprintf (path, sizeof (path), "%s/%s", compiler->source_dir,
+                          file_name);
+  if (written < 0 || (size_t)written >= sizeof (path))
+    return 0;
+  return hash_source_tree (compiler, path, compiler->toolchain_hash, 0);
+}
+
+result_t
+shader_compiler_build (shader_compiler_t *compiler, const char *file_name,
+                       char *out_path, size_t out_size)
+{
+  if (!compiler || !compiler->available || !file_name || !out_path)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Shader compiler unavailable");
+    }
+
+  char source_path[SHADER_COMPILER_PATH_MAX];
+  int written = snprintf (source_path, sizeof (source_path), "%s/%s",
+                          compiler->source_dir, file_name);
+  if (written < 0 || (size_t)written >= sizeof (source_path)
+      || !file_exists (source_path))
+    {
+      return RESULT_ERROR (RESULT_ERROR_FILE_NOT_FOUND,
+                           "Shader source not found");
+    }
+
+  uint64_t hash = shader_compiler_source_hash (compiler, file_name);
+  written = snprintf (out_path, out_size, "%s/%s.%016llx.spv",
+                      compiler->cache_dir, file_name,
+                      (unsigned long long)hash);
+  if (written < 0 || (size_t)written >= out_size)
+    {
+      return RESULT_ERROR (RESULT_ERROR_INVALID_PARAMETER,
+                           "Shader cache path too long");
+    }
+
+  if (!file_exists (out_path))
+    {
+      LOG_INFO ("ShaderCompiler", "Compiling %s", file_name);
+      result_t result = compile_spirv (compiler, source_path, out_path);
+      if (result.code != RESULT_OK)
+        return result;
+    }
+
+  prune_cache (compiler, file_name, out_path);
+  return RESULT_SUCCESS;
+}
+
+bool
+shader_compiler_poll (shader_compiler_t *compiler)
+{
+  if (!compiler || !compiler->available)
+    return false;
+
+  uint64_t stamp = newest_mtime (compiler->source_dir, 0);
+  if (stamp == compiler->sources_stamp)
+    return false;
+
+  compiler->sources_stamp = stamp;
+  return true;
+}
@@ -0,0 +1,44 @@
+#ifndef HITE_SHADER_COMPILER_H
+#define HITE_SHADER_COMPILER_H
+
+#include "../core/types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHADER_COMPILER_PATH_MAX 1024
+
+/* Compiles GLSL from the shader source tree at runtime. SPIR-V is cached on
+   disk under a hash of the source and everything it includes, so unchanged
+   shaders are never recompiled. Uses libshaderc when built with
+   HITE_HAVE_SHADERC and glslangValidator from PATH otherwise. */
+typedef struct
+{
+  char source_dir[SHADER_COMPILER_PATH_MAX];
+  char cache_dir[SHADER_COMPILER_PATH_MAX];
+  bool available;
+
+  void *backend;
+  uint64_t sources_stamp;
+  /* Backend, its version and the compile options; seeds every source
+     hash so a toolchain change misses the cache. */
+  uint64_t toolchain_hash;
+} shader_compiler_t;
+
+result_t shader_compiler_init (shader_compiler_t *compiler,
+                               const char *cache_dir);
+void shader_compiler_shutdown (shader_compiler_t *compiler);
+
+uint64_t shader_compiler_source_hash (const shader_compiler_t *compiler,
+                                      const char *file_name);
+
+/* Resolves file_name (e.g. "raymarch.comp") to cached SPIR-V, compiling it
+   on a cache miss. */
+result_t shader_compiler_build (shader_compiler_t *compiler,
+                                const char *file_name, char *out_path,
+                                size_t out_size);
+
+/* True once per batch of edits anywhere under the source tree. */
+bool shader_compiler_poll (shader_compiler_t *compiler);
+
+#endif
@@ -1,4 +1,6 @@
 #include "swapchain.h"
+#include "../core/allocator.h"
+#include "../core/logger.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -47,7 +49,8 @@ swapchain_create (vulkan_context_t *context, GLFWwindow *window,
   vkGetPhysicalDeviceSurfaceFormatsKHR (
       context->physical_device, swapchain->surface, &format_count, NULL);
   VkSurfaceFormatKHR *formats
-      = malloc (format_count * sizeof (VkSurfaceFormatKHR));
+      = mem_alloc (MEM_TAG_RENDERER,
+                   format_count * sizeof (VkSurfaceFormatKHR));
   vkGetPhysicalDeviceSurfaceFormatsKHR (
       context->physical_device, swapchain->surface, &format_count, formats);
 
@@ -75,7 +78,7 @@ swapchain_create (vulkan_context_t *context, GLFWwindow *window,
             }
         }
     }
-  free (formats);
+  mem_free (formats);
 
   VkSwapchainCreateInfoKHR create_info = { 0 };
   create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -113,12 +116,15 @@ swapchain_create (vulkan_context_t *context, GLFWwindow *window,
 
   vkGetSwapchainImagesKHR (context->device, swapchain->swapchain,
                            &swapchain->image_count, NULL);
-  swapchain->images = malloc (swapchain->image_count * sizeof (VkImage));
+  swapchain->images
+      = mem_alloc (MEM_TAG_RENDERER,
+                   swapchain->image_count * sizeof (VkImage));
   vkGetSwapchainImagesKHR (context->device, swapchain->swapchain,
                            &swapchain->image_count, swapchain->images);
 
   swapchain->image_views
-      = malloc (swapchain->image_count * sizeof (VkImageView));
+      = mem_alloc (MEM_TAG_RENDERER,
+                   swapchain->image_count * sizeof (VkImageView));
   for (uint32_t i = 0; i < swapchain->image_count; i++)
     {
       VkImageViewCreateInfo view_info = { 0 };
@@ -140,9 +146,11 @@ swapchain_create (vulkan_context_t *context, GLFWwindow *window,
   semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
   swapchain->image_available_semaphores
-      = malloc (swapchain->image_count * sizeof (VkSemaphore));
+      = mem_alloc (MEM_TAG_RENDERER,
+                   swapchain->image_count * sizeof (VkSemaphore));
   swapchain->render_finished_semaphores
-      = malloc (swapchain->image_count * sizeof (VkSemaphore));
+      = mem_alloc (MEM_TAG_RENDERER,
+                   swapchain->image_count * sizeof (VkSemaphore));
 
   for (uint32_t i = 0; i < swapchain->image_count; i++)
     {
@@ -157,8 +165,8 @@ swapchain_create (vulkan_context_t *context, GLFWwindow *window,
                                   swapchain->image_available_semaphores[j],
                                   NULL);
             }
-          free (swapchain->image_available_semaphores);
-          free (swapchain->render_finished_semaphores);
+          mem_free (swapchain->image_available_semaphores);
+          mem_free (swapchain->render_finished_semaphores);
           return RESULT_ERROR (RESULT_ERROR_VULKAN,
                                "Failed to create image_available semaphore");
         }
@@ -180,32 +188,38 @@ swapchain_create (vulkan_context_t *context, GLFWwindow *window,
                                   swapchain->render_finished_semaphores[j],
                                   NULL);
             }
-          free (swapchain->image_available_semaphores);
-          free (swapchain->render_finished_semaphores);
+          mem_free (swapchain->image_available_semaphores);
+          mem_free (swapchain->render_finished_semaphores);
           return RESULT_ERROR (RESULT_ERROR_VULKAN,
                                "Failed to create render_finished semaphore");
         }
     }
 
-  VkFenceCreateInfo fence_info = { 0 };
-  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-  if (vkCreateFence (context->device, &fence_info, NULL,
-                     &swapchain->command_fence)
-      != VK_SUCCESS)
+  uint32_t blit_count = swapchain->image_count * MAX_FRAMES_IN_FLIGHT;
+  swapchain->blits
+      = mem_alloc (MEM_TAG_RENDERER, blit_count * sizeof (swapchain_blit_t));
+  memset (swapchain->blits, 0, blit_count * sizeof (swapchain_blit_t));
+
+  VkCommandBuffer *blit_buffers
+      = mem_alloc (MEM_TAG_RENDERER, blit_count * sizeof (VkCommandBuffer));
+  VkCommandBufferAllocateInfo alloc_info = { 0 };
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.commandPool = context->command_pool;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  alloc_info.commandBufferCount = blit_count;
+
+  /* Without secondaries the blit is recorded inline every frame. */
+  if (vkAllocateCommandBuffers (context->device, &alloc_info, blit_buffers)
+      == VK_SUCCESS)
     {
-
-      for (uint32_t i = 0; i < swapchain->image_count; i++)
-        {
-          vkDestroySemaphore (context->device,
-                              swapchain->image_available_semaphores[i], NULL);
-          vkDestroySemaphore (context->device,
-                              swapchain->render_finished_semaphores[i], NULL);
-        }
-      free (swapchain->image_available_semaphores);
-      free (swapchain->render_finished_semaphores);
-      return RESULT_ERROR (RESULT_ERROR_VULKAN, "Failed to create fence");
+      for (uint32_t i = 0; i < blit_count; i++)
+        swapchain->blits[i].command_buffer = blit_buffers[i];
     }
+  else
+    {
+      LOG_WARNING ("Swapchain", "Failed to allocate blit command buffers");
+    }
+  mem_free (blit_buffers);
 
   return RESULT_SUCCESS;
 }
@@ -221,6 +235,18 @@ swapchain_destroy (vulkan_context_t *context, swapchain_t *swapchain)
       vkDeviceWaitIdle (context->device);
     }
 
+  if (swapchain->blits)
+    {
+      uint32_t blit_count = swapchain->image_count * MAX_FRAMES_IN_FLIGHT;
+      for (uint32_t i = 0; i < blit_count; i++)
+        {
+          if (swapchain->blits[i].command_buffer != VK_NULL_HANDLE)
+            vkFreeCommandBuffers (context->device, context->command_pool, 1,
+                                  &swapchain->blits[i].command_buffer);
+        }
+      mem_free (swapchain->blits);
+    }
+
   if (swapchain->image_available_semaphores)
     {
       for (uint32_t i = 0; i < swapchain->image_count; i++)
@@ -228,7 +254,7 @@ swapchain_destroy (vulkan_context_t *context, swapchain_t *swapchain)
           vkDestroySemaphore (context->device,
                               swapchain->image_available_semaphores[i], NULL);
         }
-      free (swapchain->image_available_semaphores);
+      mem_free (swapchain->image_available_semaphores);
     }
 
   if (swapchain->render_finished_semaphores)
@@ -238,12 +264,7 @@ swapchain_destroy (vulkan_context_t *context, swapchain_t *swapchain)
           vkDestroySemaphore (context->device,
                               swapchain->render_finished_semaphores[i], NULL);
         }
-      free (swapchain->render_finished_semaphores);
-    }
-
-  if (swapchain->command_fence != VK_NULL_HANDLE)
-    {
-      vkDestroyFence (context->device, swapchain->command_fence, NULL);
+      mem_free (swapchain->render_finished_semaphores);
     }
 
   for (uint32_t i = 0; i < swapchain->image_count; i++)
@@ -251,8 +272,8 @@ swapchain_destroy (vulkan_context_t *context, swapchain_t *swapchain)
       vkDestroyImageView (context->device, swapchain->image_views[i], NULL);
     }
 
-  free (swapchain->images);
-  free (swapchain->image_views);
+  mem_free (swapchain->images);
+  mem_free (swapchain->image_views);
 
   if (swapchain->swapchain != VK_NULL_HANDLE)
     {
@@ -266,50 +287,59 @@ swapchain_destroy (vulkan_context_t *context, swapchain_t *swapchain)
 }
 
 result_t
-swapchain_present (vulkan_context_t *context, swapchain_t *swapchain,
-                   const gpu_image_t *source_image)
+swapchain_acquire (vulkan_context_t *context, swapchain_t *swapchain,
+                   uint32_t frame_index, uint32_t *out_image_index)
 {
-
-  uint32_t image_index;
-
-  vkQueueWaitIdle (context->graphics_queue);
-
   VkResult result = vkAcquireNextImageKHR (
       context->device, swapchain->swapchain, UINT64_MAX,
-      swapchain->image_available_semaphores[0], VK_NULL_HANDLE, &image_index);
-
-  VkSemaphore image_available_sem = swapchain->image_available_semaphores[0];
+      swapchain->image_available_semaphores[frame_index], VK_NULL_HANDLE,
+      out_image_index);
 
-  if (result != VK_SUCCESS)
+  if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
     {
       return RESULT_ERROR (RESULT_ERROR_VULKAN,
                            "Failed to acquire swapchain image");
     }
 
-  VkCommandBuffer cmd = vulkan_begin_single_time_commands (context);
-
-  VkImageMemoryBarrier barrier = { 0 };
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = swapchain->images[image_index];
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.layerCount = 1;
-  barrier.srcAccessMask = 0;
-  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
-                        &barrier);
+  return RESULT_SUCCESS;
+}
+
+static void
+swapchain_record_blit (swapchain_t *swapchain, VkCommandBuffer cmd,
+                       uint32_t image_index, VkImage source_image,
+                       uint32_t source_width, uint32_t source_height)
+{
+  VkImageMemoryBarrier barriers[2] = { 0 };
+  barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].image = swapchain->images[image_index];
+  barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barriers[0].subresourceRange.levelCount = 1;
+  barriers[0].subresourceRange.layerCount = 1;
+  barriers[0].srcAccessMask = 0;
+  barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  /* The source was written by the compute passes earlier in the same
+     command buffer. */
+  barriers[1] = barriers[0];
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[1].image = source_image;
+  barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 2,
+                        barriers);
 
   VkImageBlit blit = { 0 };
   blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   blit.srcSubresource.layerCount = 1;
-  blit.srcOffsets[1].x = source_image->width;
-  blit.srcOffsets[1].y = source_image->height;
+  blit.srcOffsets[1].x = (int32_t)source_width;
+  blit.srcOffsets[1].y = (int32_t)source_height;
   blit.srcOffsets[1].z = 1;
   blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   blit.dstSubresource.layerCount = 1;
@@ -317,50 +347,87 @@ swapchain_present (vulkan_context_t *context, swapchain_t *swapchain,
   blit.dstOffsets[1].y = swapchain->extent.height;
   blit.dstOffsets[1].z = 1;
 
-  vkCmdBlitImage (cmd, source_image->image, VK_IMAGE_LAYOUT_GENERAL,
+  vkCmdBlitImage (cmd, source_image, VK_IMAGE_LAYOUT_GENERAL,
                   swapchain->images[image_index],
                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
                   VK_FILTER_LINEAR);
 
-  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  barrier.dstAccessMask = 0;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[0].dstAccessMask = 0;
 
   vkCmdPipelineBarrier (cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0,
-                        NULL, 1, &barrier);
+                        NULL, 1, barriers);
+}
 
-  vkEndCommandBuffer (cmd);
+static bool
+swapchain_prepare_blit (swapchain_t *swapchain, swapchain_blit_t *blit,
+                        uint32_t image_index, VkImage source_image,
+                        uint32_t source_width, uint32_t source_height)
+{
+  if (blit->command_buffer == VK_NULL_HANDLE)
+    return false;
 
-  vkWaitForFences (context->device, 1, &swapchain->command_fence, VK_TRUE,
-                   UINT64_MAX);
-  vkResetFences (context->device, 1, &swapchain->command_fence);
+  if (blit->source == source_image && blit->source_width == source_width
+      && blit->source_height == source_height)
+    return true;
 
-  VkSubmitInfo submit_info = { 0 };
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  /* The frame slot's fence has been waited on, so no submission that
+     executed this buffer is still pending. */
+  VkCommandBufferInheritanceInfo inheritance = { 0 };
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
 
-  VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_TRANSFER_BIT };
-  submit_info.waitSemaphoreCount = 1;
-  submit_info.pWaitSemaphores = &image_available_sem;
-  submit_info.pWaitDstStageMask = wait_stages;
+  VkCommandBufferBeginInfo begin_info = { 0 };
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.pInheritanceInfo = &inheritance;
 
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &cmd;
+  blit->source = VK_NULL_HANDLE;
+  if (vkBeginCommandBuffer (blit->command_buffer, &begin_info) != VK_SUCCESS)
+    return false;
 
-  submit_info.signalSemaphoreCount = 1;
-  submit_info.pSignalSemaphores
-      = &swapchain->render_finished_semaphores[image_index];
+  swapchain_record_blit (swapchain, blit->command_buffer, image_index,
+                         source_image, source_width, source_height);
 
-  if (vkQueueSubmit (context->graphics_queue, 1, &submit_info,
-                     swapchain->command_fence)
-      != VK_SUCCESS)
+  if (vkEndCommandBuffer (blit->command_buffer) != VK_SUCCESS)
+    return false;
+
+  blit->source = source_image;
+  blit->source_width = source_width;
+  blit->source_height = source_height;
+  return true;
+}
+
+void
+swapchain_cmd_blit (swapchain_t *swapchain, VkCommandBuffer cmd,
+                    uint32_t frame_index, uint32_t image_index,
+                    const gpu_image_t *source_image,
+                    uint32_t source_width, uint32_t source_height)
+{
+  gpu_timer_cmd_begin (swapchain->gpu_timer, cmd, GPU_TIMER_PASS_PRESENT);
+
+  swapchain_blit_t *blit
+      = &swapchain->blits[frame_index * swapchain->image_count + image_index];
+  if (swapchain_prepare_blit (swapchain, blit, image_index,
+                              source_image->image, source_width,
+                              source_height))
     {
-      vkFreeCommandBuffers (context->device, context->command_pool, 1, &cmd);
-      return RESULT_ERROR (RESULT_ERROR_VULKAN,
-                           "Failed to submit command buffer");
+      vkCmdExecuteCommands (cmd, 1, &blit->command_buffer);
+    }
+  else
+    {
+      swapchain_record_blit (swapchain, cmd, image_index, source_image->image,
+                             source_width, source_height);
     }
 
+  gpu_timer_cmd_end (swapchain->gpu_timer, cmd, GPU_TIMER_PASS_PRESENT);
+}
+
+result_t
+swapchain_present (vulkan_context_t *context, swapchain_t *swapchain,
+                   uint32_t image_index)
+{
   VkPresentInfoKHR present_info = { 0 };
   present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -372,11 +439,7 @@ swapchain_present (vulkan_context_t *context, swapchain_t *swapchain,
   present_info.pSwapchains = &swapchain->swapchain;
   present_info.pImageIndices = &image_index;
 
-  result = vkQueuePresentKHR (context->graphics_queue, &present_info);
-
-  vkWaitForFences (context->device, 1, &swapchain->command_fence, VK_TRUE,
-                   UINT64_MAX);
-  vkFreeCommandBuffers (context->device, context->command_pool, 1, &cmd);
+  VkResult result = vkQueuePresentKHR (context->graphics_queue, &present_info);
 
   if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
     {
@@ -1,8 +1,20 @@
 #ifndef HITE_SWAPCHAIN_H
 #define HITE_SWAPCHAIN_H
 
+#include "gpu_timer.h"
 #include "vulkan_core.h"
 
+/* Secondary command buffer holding the barriers and blit that copy one
+   source image into one swapchain image.  Recorded once and replayed
+   until the source or its size changes. */
+typedef struct
+{
+  VkCommandBuffer command_buffer;
+  VkImage source;
+  uint32_t source_width;
+  uint32_t source_height;
+} swapchain_blit_t;
+
 typedef struct
 {
   VkSwapchainKHR swapchain;
@@ -23,7 +35,12 @@ typedef struct
 
   VkSemaphore *image_available_semaphores;
   VkSemaphore *render_finished_semaphores;
-  VkFence command_fence;
+
+  /* image_count * MAX_FRAMES_IN_FLIGHT entries, indexed by
+     frame_index * image_count + image_index. */
+  swapchain_blit_t *blits;
+
+  gpu_timer_t *gpu_timer;
 } swapchain_t;
 
 result_t swapchain_create (vulkan_context_t *context, GLFWwindow *window,
@@ -31,7 +48,13 @@ result_t swapchain_create (vulkan_context_t *context, GLFWwindow *window,
                            swapchain_t *swapchain);
 void swapchain_destroy (vulkan_context_t *context, swapchain_t *swapchain);
 
+result_t swapchain_acquire (vulkan_context_t *context, swapchain_t *swapchain,
+                            uint32_t frame_index, uint32_t *out_image_index);
+void swapchain_cmd_blit (swapchain_t *swapchain, VkCommandBuffer cmd,
+                         uint32_t frame_index, uint32_t image_index,
+                         const gpu_image_t *source_image,
+                         uint32_t source_width, uint32_t source_height);
 result_t swapchain_present (vulkan_context_t *context, swapchain_t *swapchain,
-                            const gpu_image_t *source_image);
+                            uint32_t image_index);
 
 #endif
@@ -1,8 +1,26 @@
 #include "vulkan_core.h"
+#include "../core/allocator.h"
 #include "../core/logger.h"
+#include "../core/metrics.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define PIPELINE_CACHE_MAGIC 0x43505448u /* "HTPC" */
+
+/* Prefix of the on-disk pipeline cache. The driver's own header carries
+   the vendor, device and cache UUID but not the driver version, which
+   is checked here as well before the blob is handed back to the driver. */
+typedef struct
+{
+  uint32_t magic;
+  uint32_t data_size;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint8_t cache_uuid[VK_UUID_SIZE];
+} pipeline_cache_header_t;
+
 static const char *validation_layers[] = { "VK_LAYER_KHRONOS_validation" };
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL
@@ -25,11 +43,42 @@ debug_callback (VkDebugUtilsMessageSeverityFlagBitsEXT severity,
   return VK_FALSE;
 }
 
+static bool
+validation_layers_available (void)
+{
+  uint32_t layer_count = 0;
+  vkEnumerateInstanceLayerProperties (&layer_count, NULL);
+  if (layer_count == 0)
+    return false;
+
+  VkLayerProperties *layers
+      = mem_alloc (MEM_TAG_RENDERER, layer_count * sizeof (VkLayerProperties));
+  if (!layers)
+    return false;
+  vkEnumerateInstanceLayerProperties (&layer_count, layers);
+
+  bool found = false;
+  for (uint32_t i = 0; i < layer_count && !found; i++)
+    found = strcmp (layers[i].layerName, validation_layers[0]) == 0;
+
+  mem_free (layers);
+  return found;
+}
+
 result_t
-vulkan_init (vulkan_context_t *context, bool enable_validation)
+vulkan_init (vulkan_context_t *context, bool enable_validation,
+             bool headless)
 {
   memset (context, 0, sizeof (vulkan_context_t));
 
+  /* CI containers and render nodes rarely ship the SDK layers. */
+  if (enable_validation && !validation_layers_available ())
+    {
+      LOG_WARNING ("Vulkan", "%s not installed, validation disabled",
+                   validation_layers[0]);
+      enable_validation = false;
+    }
+
   VkApplicationInfo app_info = { 0 };
   app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
   app_info.pApplicationName = "Hite Engine";
@@ -42,12 +91,15 @@ vulkan_init (vulkan_context_t *context, bool enable_validation)
   create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
   create_info.pApplicationInfo = &app_info;
 
+  /* Headless runs never create a surface, so GLFW is not initialized. */
   uint32_t glfw_extension_count = 0;
   const char **glfw_extensions
-      = glfwGetRequiredInstanceExtensions (&glfw_extension_count);
+      = headless ? NULL
+                 : glfwGetRequiredInstanceExtensions (&glfw_extension_count);
 
   const char **extensions
-      = malloc ((glfw_extension_count + 1) * sizeof (char *));
+      = mem_alloc (MEM_TAG_RENDERER,
+                   (glfw_extension_count + 1) * sizeof (char *));
   if (extensions == NULL)
     {
       LOG_ERROR ("Vulkan", "malloc (); for devices failed!");
@@ -70,7 +122,7 @@ vulkan_init (vulkan_context_t *context, bool enable_validation)
     }
 
   VkResult result = vkCreateInstance (&create_info, NULL, &context->instance);
-  free ((void *)extensions);
+  mem_free ((void *)extensions);
 
   if (result != VK_SUCCESS)
     {
@@ -110,7 +162,7 @@ vulkan_init (vulkan_context_t *context, bool enable_validation)
     }
 
   VkPhysicalDevice *devices
-      = malloc (device_count * sizeof (VkPhysicalDevice));
+      = mem_alloc (MEM_TAG_RENDERER, device_count * sizeof (VkPhysicalDevice));
   if (devices == NULL)
     {
       LOG_ERROR ("Vulkan", "malloc (); for devices failed!");
@@ -118,7 +170,7 @@ vulkan_init (vulkan_context_t *context, bool enable_validation)
     }
   vkEnumeratePhysicalDevices (context->instance, &device_count, devices);
   context->physical_device = devices[0];
-  free (devices);
+  mem_free (devices);
 
   vkGetPhysicalDeviceProperties (context->physical_device,
                                  &context->device_properties);
@@ -133,7 +185,8 @@ vulkan_init (vulkan_context_t *context, bool enable_validation)
                                             &queue_family_count, NULL);
 
   VkQueueFamilyProperties *queue_families
-      = malloc (queue_family_count * sizeof (VkQueueFamilyProperties));
+      = mem_alloc (MEM_TAG_RENDERER,
+                   queue_family_count * sizeof (VkQueueFamilyProperties));
   if (queue_families == NULL)
     {
       LOG_ERROR ("Vulkan", "malloc (); for device families failed!");
@@ -146,18 +199,28 @@ vulkan_init (vulkan_context_t *context, bool enable_validation)
   context->graphics_family = UINT32_MAX;
   context->compute_family = UINT32_MAX;
 
+  /* The raymarch dispatches and the present blit share the graphics
+     queue, so the graphics family must also support compute. */
+  VkQueueFlags graphics_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+
   for (uint32_t i = 0; i < queue_family_count; i++)
     {
-      if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+      VkQueueFlags flags = queue_families[i].queueFlags;
+      if ((flags & graphics_flags) == graphics_flags)
         {
           context->graphics_family = i;
         }
-      if (queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
+      if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
         {
           context->compute_family = i;
         }
     }
-  free (queue_families);
+  mem_free (queue_families);
+
+  /* Without a dedicated compute family everything runs on one queue. */
+  if (context->compute_family == UINT32_MAX)
+    context->compute_family = context->graphics_family;
+  context->async_compute = context->compute_family != context->graphics_family;
 
   if (context->graphics_family == UINT32_MAX
       || context->compute_family == UINT32_MAX)
@@ -194,7 +257,7 @@ vulkan_init (vulkan_context_t *context, bool enable_validation)
   device_create_info.queueCreateInfoCount = queue_create_count;
   device_create_info.pQueueCreateInfos = queue_create_infos;
   device_create_info.pEnabledFeatures = &device_features;
-  device_create_info.enabledExtensionCount = 1;
+  device_create_info.enabledExtensionCount = headless ? 0 : 1;
   device_create_info.ppEnabledExtensionNames = device_extensions;
 
   if (vkCreateDevice (context->physical_device, &device_create_info, NULL,
@@ -210,6 +273,10 @@ vulkan_init (vulkan_context_t *context, bool enable_validation)
   vkGetDeviceQueue (context->device, context->compute_family, 0,
                     &context->compute_queue);
 
+  if (context->async_compute)
+    LOG_INFO ("Vulkan", "Async compute on queue family %u",
+              context->compute_family);
+
   VkCommandPoolCreateInfo pool_info = { 0 };
   pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
@@ -243,6 +310,9 @@ vulkan_cleanup (vulkan_context_t *context)
 
   if (context->device)
     {
+      if (context->pipeline_cache)
+        vkDestroyPipelineCache (context->device, context->pipeline_cache,
+                                NULL);
       vkDestroyCommandPool (context->device, context->command_pool, NULL);
       vkDestroyCommandPool (context->device, context->compute_command_pool,
                             NULL);
@@ -266,6 +336,147 @@ vulkan_cleanup (vulkan_context_t *context)
     }
 }
 
+static void
+pipeline_cache_header_init (const vulkan_context_t *context,
+                            pipeline_cache_header_t *header)
+{
+  const VkPhysicalDeviceProperties *properties = &context->device_properties;
+
+  memset (header, 0, sizeof (*header));
+  header->magic = PIPELINE_CACHE_MAGIC;
+  header->vendor_id = properties->vendorID;
+  header->device_id = properties->deviceID;
+  header->driver_version = properties->driverVersion;
+  memcpy (header->cache_uuid, properties->pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+static void *
+pipeline_cache_read (const vulkan_context_t *context, const char *path,
+                     size_t *out_size)
+{
+  FILE *file = fopen (path, "rb");
+  if (!file)
+    return NULL;
+
+  pipeline_cache_header_t expected;
+  pipeline_cache_header_init (context, &expected);
+
+  pipeline_cache_header_t header;
+  void *data = NULL;
+  if (fread (&header, sizeof (header), 1, file) != 1)
+    goto done;
+
+  uint32_t data_size = header.data_size;
+  header.data_size = 0;
+  if (memcmp (&header, &expected, sizeof (header)) != 0 || data_size == 0)
+    {
+      LOG_INFO ("Vulkan", "Ignoring pipeline cache from another device or "
+                          "driver");
+      goto done;
+    }
+
+  data = mem_alloc (MEM_TAG_RENDERER, data_size);
+  if (data && fread (data, 1, data_size, file) != data_size)
+    {
+      mem_free (data);
+      data = NULL;
+    }
+  *out_size = data_size;
+
+done:
+  fclose (file);
+  return data;
+}
+
+void
+vulkan_pipeline_cache_load (vulkan_context_t *context, const char *path)
+{
+  size_t data_size = 0;
+  void *data = path ? pipeline_cache_read (context, path, &data_size) : NULL;
+
+  VkPipelineCacheCreateInfo cache_info = { 0 };
+  cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cache_info.initialDataSize = data ? data_size : 0;
+  cache_info.pInitialData = data;
+
+  VkResult result = vkCreatePipelineCache (context->device, &cache_info, NULL,
+                                           &context->pipeline_cache);
+  if (result != VK_SUCCESS && data)
+    {
+      cache_info.initialDataSize = 0;
+      cache_info.pInitialData = NULL;
+      result = vkCreatePipelineCache (context->device, &cache_info, NULL,
+                                      &context->pipeline_cache);
+    }
+  else if (data)
+    {
+      LOG_INFO ("Vulkan", "Loaded pipeline cache (%zu bytes)", data_size);
+    }
+  mem_free (data);
+
+  /* Pipelines are still created without a cache, just more slowly. */
+  if (result != VK_SUCCESS)
+    {
+      context->pipeline_cache = VK_NULL_HANDLE;
+      LOG_WARNING ("Vulkan", "Failed to create pipeline cache");
+    }
+}
+
+void
+vulkan_pipeline_cache_save (vulkan_context_t *context, const char *path)
+{
+  if (!context->pipeline_cache || !path)
+    return;
+
+  size_t data_size = 0;
+  if (vkGetPipelineCacheData (context->device, context->pipeline_cache,
+                              &data_size, NULL)
+          != VK_SUCCESS
+      || data_size == 0 || data_size > UINT32_MAX)
+    return;
+
+  void *data = mem_alloc (MEM_TAG_RENDERER, data_size);
+  if (!data)
+    return;
+
+  if (vkGetPipelineCacheData (context->device, context->pipeline_cache,
+                              &data_size, data)
+      != VK_SUCCESS)
+    {
+      mem_free (data);
+      return;
+    }
+
+  pipeline_cache_header_t header;
+  pipeline_cache_header_init (context, &header);
+  header.data_size = (uint32_t)data_size;
+
+  /* Write beside the target and rename, so an interrupted save never
+     leaves a truncated cache behind. */
+  char temp_path[1280];
+  int written = snprintf (temp_path, sizeof (temp_path), "%s.tmp", path);
+  FILE *file = written > 0 && (size_t)written < sizeof (temp_path)
+                   ? fopen (temp_path, "wb")
+                   : NULL;
+  if (!file)
+    {
+      LOG_WARNING ("Vulkan", "Failed to write pipeline cache to %s", path);
+      mem_free (data);
+      return;
+    }
+
+  bool ok = fwrite (&header, sizeof (header), 1, file) == 1
+            && fwrite (data, 1, data_size, file) == data_size;
+  ok = fclose (file) == 0 && ok;
+  mem_free (data);
+
+  if (!ok || rename (temp_path, path) != 0)
+    {
+      remove (temp_path);
+      LOG_WARNING ("Vulkan", "Failed to write pipeline cache to %s", path);
+    }
+}
+
 uint32_t
 vulkan_find_memory_type (vulkan_context_t *context, uint32_t type_filter,
                          VkMemoryPropertyFlags properties)
@@ -283,16 +494,25 @@ vulkan_find_memory_type (vulkan_context_t *context, uint32_t type_filter,
   return UINT32_MAX;
 }
 
-result_t
-gpu_buffer_create (vulkan_context_t *context, VkDeviceSize size,
-                   VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                   gpu_buffer_t *buffer)
+static result_t
+gpu_buffer_create_with_sharing (vulkan_context_t *context, VkDeviceSize size,
+                                VkBufferUsageFlags usage,
+                                VkMemoryPropertyFlags properties, bool shared,
+                                gpu_buffer_t *buffer)
 {
+  uint32_t families[2] = { context->graphics_family, context->compute_family };
+
   VkBufferCreateInfo buffer_info = { 0 };
   buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   buffer_info.size = size;
   buffer_info.usage = usage;
   buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (shared && context->async_compute)
+    {
+      buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+      buffer_info.queueFamilyIndexCount = 2;
+      buffer_info.pQueueFamilyIndices = families;
+    }
 
   if (vkCreateBuffer (context->device, &buffer_info, NULL, &buffer->buffer)
       != VK_SUCCESS)
@@ -310,10 +530,13 @@ gpu_buffer_create (vulkan_context_t *context, VkDeviceSize size,
   alloc_info.memoryTypeIndex = vulkan_find_memory_type (
       context, mem_requirements.memoryTypeBits, properties);
 
-  if (vkAllocateMemory (context->device, &alloc_info, NULL, &buffer->memory)
-      != VK_SUCCESS)
+  if (alloc_info.memoryTypeIndex == UINT32_MAX
+      || vkAllocateMemory (context->device, &alloc_info, NULL,
+                           &buffer->memory)
+             != VK_SUCCESS)
     {
       vkDestroyBuffer (context->device, buffer->buffer, NULL);
+      buffer->buffer = VK_NULL_HANDLE;
       return RESULT_ERROR (RESULT_ERROR_VULKAN,
                            "Failed to allocate buffer memory");
     }
@@ -326,6 +549,25 @@ gpu_buffer_create (vulkan_context_t *context, VkDeviceSize size,
   return RESULT_SUCCESS;
 }
 
+result_t
+gpu_buffer_create (vulkan_context_t *context, VkDeviceSize size,
+                   VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                   gpu_buffer_t *buffer)
+{
+  return gpu_buffer_create_with_sharing (context, size, usage, properties,
+                                         false, buffer);
+}
+
+result_t
+gpu_buffer_create_shared (vulkan_context_t *context, VkDeviceSize size,
+                          VkBufferUsageFlags usage,
+                          VkMemoryPropertyFlags properties,
+                          gpu_buffer_t *buffer)
+{
+  return gpu_buffer_create_with_sharing (context, size, usage, properties,
+                                         true, buffer);
+}
+
 void
 gpu_buffer_destroy (vulkan_context_t *context, gpu_buffer_t *buffer)
 {
@@ -345,6 +587,12 @@ result_t
 gpu_buffer_upload (vulkan_context_t *context, gpu_buffer_t *buffer,
                    const void *data, VkDeviceSize size)
 {
+  if (buffer->mapped)
+    {
+      gpu_buffer_write (buffer, 0, data, size);
+      return RESULT_SUCCESS;
+    }
+
   void *mapped;
   if (vkMapMemory (context->device, buffer->memory, 0, size, 0, &mapped)
       != VK_SUCCESS)
@@ -355,13 +603,48 @@ gpu_buffer_upload (vulkan_context_t *context, gpu_buffer_t *buffer,
   memcpy (mapped, data, size);
   vkUnmapMemory (context->device, buffer->memory);
 
+  metrics_counter_add (METRIC_COUNTER_RENDER_UPLOAD_BYTES, (uint64_t)size);
+
   return RESULT_SUCCESS;
 }
 
 result_t
-gpu_image_create (vulkan_context_t *context, uint32_t width, uint32_t height,
-                  VkFormat format, VkImageUsageFlags usage, gpu_image_t *image)
+gpu_buffer_map (vulkan_context_t *context, gpu_buffer_t *buffer)
 {
+  if (buffer->mapped)
+    return RESULT_SUCCESS;
+
+  if (vkMapMemory (context->device, buffer->memory, 0, VK_WHOLE_SIZE, 0,
+                   &buffer->mapped)
+      != VK_SUCCESS)
+    {
+      buffer->mapped = NULL;
+      return RESULT_ERROR (RESULT_ERROR_VULKAN, "Failed to map buffer memory");
+    }
+
+  return RESULT_SUCCESS;
+}
+
+void
+gpu_buffer_write (gpu_buffer_t *buffer, VkDeviceSize offset, const void *data,
+                  VkDeviceSize size)
+{
+  if (!buffer->mapped || size == 0 || offset + size > buffer->size)
+    return;
+
+  memcpy ((char *)buffer->mapped + offset, data, size);
+
+  metrics_counter_add (METRIC_COUNTER_RENDER_UPLOAD_BYTES, (uint64_t)size);
+}
+
+static result_t
+gpu_image_create_with_sharing (vulkan_context_t *context, uint32_t width,
+                               uint32_t height, VkFormat format,
+                               VkImageUsageFlags usage, bool shared,
+                               gpu_image_t *image)
+{
+  uint32_t families[2] = { context->graphics_family, context->compute_family };
+
   VkImageCreateInfo image_info = { 0 };
   image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   image_info.imageType = VK_IMAGE_TYPE_2D;
@@ -376,6 +659,12 @@ gpu_image_create (vulkan_context_t *context, uint32_t width, uint32_t height,
   image_info.usage = usage;
   image_info.samples = VK_SAMPLE_COUNT_1_BIT;
   image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (shared && context->async_compute)
+    {
+      image_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+      image_info.queueFamilyIndexCount = 2;
+      image_info.pQueueFamilyIndices = families;
+    }
 
   if (vkCreateImage (context->device, &image_info, NULL, &image->image)
       != VK_SUCCESS)
@@ -430,6 +719,23 @@ gpu_image_create (vulkan_context_t *context, uint32_t width, uint32_t height,
   return RESULT_SUCCESS;
 }
 
+result_t
+gpu_image_create (vulkan_context_t *context, uint32_t width, uint32_t height,
+                  VkFormat format, VkImageUsageFlags usage, gpu_image_t *image)
+{
+  return gpu_image_create_with_sharing (context, width, height, format, usage,
+                                        false, image);
+}
+
+result_t
+gpu_image_create_shared (vulkan_context_t *context, uint32_t width,
+                         uint32_t height, VkFormat format,
+                         VkImageUsageFlags usage, gpu_image_t *image)
+{
+  return gpu_image_create_with_sharing (context, width, height, format, usage,
+                                        true, image);
+}
+
 void
 gpu_image_destroy (vulkan_context_t *context, gpu_image_t *image)
 {
@@ -18,9 +18,12 @@ typedef struct
   VkQueue compute_queue;
   VkCommandPool command_pool;
   VkCommandPool compute_command_pool;
+  VkPipelineCache pipeline_cache;
 
   uint32_t graphics_family;
   uint32_t compute_family;
+  /* compute_family is a dedicated family distinct from graphics_family. */
+  bool async_compute;
 
   VkPhysicalDeviceProperties device_properties;
   VkPhysicalDeviceMemoryProperties memory_properties;
@@ -45,20 +48,40 @@ typedef struct
   VkFormat format;
 } gpu_image_t;
 
-result_t vulkan_init (vulkan_context_t *context, bool enable_validation);
+/* A headless context enables no surface or swapchain extensions. */
+result_t vulkan_init (vulkan_context_t *context, bool enable_validation,
+                      bool headless);
 void vulkan_cleanup (vulkan_context_t *context);
 
+/* Creates context->pipeline_cache, seeded from path when the file was
+   written by the same device and driver. Falls back to an empty cache. */
+void vulkan_pipeline_cache_load (vulkan_context_t *context, const char *path);
+void vulkan_pipeline_cache_save (vulkan_context_t *context, const char *path);
+
 result_t gpu_buffer_create (vulkan_context_t *context, VkDeviceSize size,
                             VkBufferUsageFlags usage,
                             VkMemoryPropertyFlags properties,
                             gpu_buffer_t *buffer);
+/* Usable from both the graphics and compute queues without ownership
+   transfers.  Identical to gpu_buffer_create on a single queue family. */
+result_t gpu_buffer_create_shared (vulkan_context_t *context,
+                                   VkDeviceSize size, VkBufferUsageFlags usage,
+                                   VkMemoryPropertyFlags properties,
+                                   gpu_buffer_t *buffer);
 void gpu_buffer_destroy (vulkan_context_t *context, gpu_buffer_t *buffer);
 result_t gpu_buffer_upload (vulkan_context_t *context, gpu_buffer_t *buffer,
                             const void *data, VkDeviceSize size);
+result_t gpu_buffer_map (vulkan_context_t *context, gpu_buffer_t *buffer);
+void gpu_buffer_write (gpu_buffer_t *buffer, VkDeviceSize offset,
+                       const void *data, VkDeviceSize size);
 
 result_t gpu_image_create (vulkan_context_t *context, uint32_t width,
                            uint32_t height, VkFormat format,
                            VkImageUsageFlags usage, gpu_image_t *image);
+result_t gpu_image_create_shared (vulkan_context_t *context, uint32_t width,
+                                  uint32_t height, VkFormat format,
+                                  VkImageUsageFlags usage,
+                                  gpu_image_t *image);
 void gpu_image_destroy (vulkan_context_t *context, gpu_image_t *image);
 
 VkCommandBuffer vulkan_begin_single_time_commands (vulkan_context_t *context);
@@ -0,0 +1,47 @@
+#include "core/allocator.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static int
+check_realloc_alignment (size_t alignment)
+{
+  unsigned char *ptr = mem_aligned_alloc (MEM_TAG_GENERAL, alignment, 24);
+  if (!ptr)
+    return 1;
+  memset (ptr, 0xab, 24);
+
+  for (size_t size = 40; size <= 40000; size *= 3)
+    {
+      ptr = mem_realloc (ptr, size);
+      if (!ptr || ((uintptr_t)ptr & (alignment - 1)) != 0 || ptr[23] != 0xab)
+        {
+          fprintf (stderr, "realloc to %zu lost %zu-byte alignment\n", size,
+                   alignment);
+          return 1;
+        }
+    }
+
+  mem_free (ptr);
+  return 0;
+}
+
+int
+main (void)
+{
+  int failures = 0;
+  for (size_t alignment = 16; alignment <= 4096; alignment *= 2)
+    failures += check_realloc_alignment (alignment);
+
+  mem_tag_stats_t stats;
+  mem_get_tag_stats (MEM_TAG_GENERAL, &stats);
+  if (stats.live_bytes != 0)
+    {
+      fprintf (stderr, "%lld bytes still live\n",
+               (long long)stats.live_bytes);
+      failures++;
+    }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include "renderer/dynamic_resolution.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#define TARGET_MS 10.0f
+
+static int failures = 0;
+
+static void
+check (bool condition, const char *what)
+{
+  if (!condition)
+    {
+      fprintf (stderr, "FAIL: %s\n", what);
+      failures++;
+    }
+}
+
+static bool
+on_quantum (float scale)
+{
+  float steps = scale / DYNAMIC_RESOLUTION_SCALE_STEP;
+  return fabsf (steps - roundf (steps)) < 1e-3f;
+}
+
+/* Feeds gpu_ms until the scale changes; returns the number of updates it
+   took, or 0 if it did not change within limit. */
+static uint32_t
+run_until_change (dynamic_resolution_t *controller, double gpu_ms,
+                  uint32_t limit)
+{
+  for (uint32_t i = 1; i <= limit; i++)
+    {
+      if (dynamic_resolution_update (controller, gpu_ms))
+        return i;
+    }
+  return 0;
+}
+
+static void
+test_over_budget (void)
+{
+  dynamic_resolution_t controller;
+  dynamic_resolution_init (&controller, TARGET_MS);
+  check (controller.enabled && controller.scale == 1.0f, "initial state");
+
+  /* Nothing may change while the initial settle window runs. */
+  uint32_t frames = run_until_change (&controller, TARGET_MS * 2.0, 64);
+  check (frames == DYNAMIC_RESOLUTION_SETTLE_FRAMES + 1,
+         "first drop waits for the settle window");
+
+  /* sqrt step wants 1 - 1/sqrt(1.87), capped at 0.15. */
+  check (fabsf (controller.scale - 0.85f) < 1e-4f, "drop capped at 0.15");
+  check (on_quantum (controller.scale), "drop lands on the 2.5% quantum");
+
+  frames = run_until_change (&controller, TARGET_MS * 2.0, 64);
+  check (frames == DYNAMIC_RESOLUTION_SETTLE_FRAMES + 1,
+         "settles again after a change");
+
+  for (int i = 0; i < 200; i++)
+    dynamic_resolution_update (&controller, TARGET_MS * 4.0);
+  check (controller.scale == DYNAMIC_RESOLUTION_MIN_SCALE,
+         "clamps at the minimum scale");
+  check (run_until_change (&controller, TARGET_MS * 4.0, 64) == 0,
+         "stays at the minimum scale");
+}
+
+static void
+test_small_overshoot (void)
+{
+  dynamic_resolution_t controller;
+  dynamic_resolution_init (&controller, TARGET_MS);
+
+  /* Cost follows pixel count; 10% over budget at full scale should come
+     down in one small step and then hold. */
+  uint32_t changes = 0;
+  for (int i = 0; i < 200; i++)
+    {
+      double gpu_ms = TARGET_MS * 1.1 * controller.scale * controller.scale;
+      if (dynamic_resolution_update (&controller, gpu_ms))
+        changes++;
+    }
+  check (changes == 1, "small overshoot settles after one change");
+  check (controller.scale < 1.0f && controller.scale >= 0.9f,
+         "small overshoot drops by a small step");
+  check (on_quantum (controller.scale), "small drop lands on the quantum");
+}
+
+static void
+test_under_budget (void)
+{
+  dynamic_resolution_t controller;
+  dynamic_resolution_init (&controller, TARGET_MS);
+  for (int i = 0; i < 200; i++)
+    dynamic_resolution_update (&controller, TARGET_MS * 4.0);
+  check (controller.scale == DYNAMIC_RESOLUTION_MIN_SCALE,
+         "reaches the minimum before recovering");
+
+  /* Allow the smoothed time to come down before the first step up. */
+  float previous = controller.scale;
+  uint32_t frames = run_until_change (&controller, TARGET_MS * 0.5, 64);
+  check (frames > 0, "recovers when under budget");
+  check (fabsf (controller.scale - previous - DYNAMIC_RESOLUTION_SCALE_STEP)
+             < 1e-4f,
+         "recovers one quantum at a time");
+
+  for (int i = 0; i < 1000; i++)
+    dynamic_resolution_update (&controller, TARGET_MS * 0.5);
+  check (controller.scale == DYNAMIC_RESOLUTION_MAX_SCALE,
+         "clamps at the maximum scale");
+  check (run_until_change (&controller, TARGET_MS * 0.5, 64) == 0,
+         "stays at the maximum scale");
+}
+
+static void
+test_in_band (void)
+{
+  dynamic_resolution_t controller;
+  dynamic_resolution_init (&controller, TARGET_MS);
+  for (int i = 0; i < 4; i++)
+    run_until_change (&controller, TARGET_MS * 2.0, 64);
+
+  /* Between the headroom and the budget nothing moves. */
+  float scale = controller.scale;
+  check (run_until_change (&controller, TARGET_MS * 0.9, 500) == 0,
+         "holds inside the headroom band");
+  check (controller.scale == scale, "scale unchanged inside the band");
+}
+
+static void
+test_ignored_input (void)
+{
+  dynamic_resolution_t controller;
+  dynamic_resolution_init (&controller, 0.0f);
+  check (!controller.enabled, "a zero target disables the controller");
+  check (run_until_change (&controller, 100.0, 64) == 0,
+         "a disabled controller never changes");
+
+  dynamic_resolution_init (&controller, TARGET_MS);
+  check (run_until_change (&controller, 0.0, 64) == 0,
+         "missing timings are ignored");
+  check (controller.smoothed_ms == TARGET_MS,
+         "missing timings do not move the average");
+}
+
+int
+main (void)
+{
+  test_over_budget ();
+  test_small_overshoot ();
+  test_under_budget ();
+  test_in_band ();
+  test_ignored_input ();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+#include "renderer/image_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH 2
+#define HEIGHT 2
+/* Rows are padded past width * 4 to exercise the stride. */
+#define STRIDE 12
+
+static int failures = 0;
+
+static void
+check (bool condition, const char *what)
+{
+  if (!condition)
+    {
+      fprintf (stderr, "FAIL: %s\n", what);
+      failures++;
+    }
+}
+
+/* 0 and 255 only, so the EXR gamma mapping is exact. */
+static const uint8_t pixels[HEIGHT * STRIDE] = {
+  255, 0,   0,   255, 0,   255, 0,   255, 7, 7, 7, 7,
+  0,   0,   255, 0,   255, 255, 255, 255, 7, 7, 7, 7,
+};
+
+static uint8_t *
+read_file (const char *path, size_t *out_size)
+{
+  FILE *file = fopen (path, "rb");
+  if (!file)
+    return NULL;
+
+  static uint8_t data[4096];
+  *out_size = fread (data, 1, sizeof (data), file);
+  fclose (file);
+  remove (path);
+  return data;
+}
+
+static uint32_t
+load_be32 (const uint8_t *in)
+{
+  return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8
+         | in[3];
+}
+
+static uint32_t
+load_le32 (const uint8_t *in)
+{
+  return (uint32_t)in[3] << 24 | (uint32_t)in[2] << 16 | (uint32_t)in[1] << 8
+         | in[0];
+}
+
+/* Bitwise reference, independent of the writer's table. */
+static uint32_t
+reference_crc32 (const uint8_t *data, size_t size)
+{
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < size; i++)
+    {
+      crc ^= data[i];
+      for (int k = 0; k < 8; k++)
+        crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1u));
+    }
+  return ~crc;
+}
+
+static uint32_t
+reference_adler32 (const uint8_t *data, size_t size)
+{
+  uint32_t a = 1, b = 0;
+  for (size_t i = 0; i < size; i++)
+    {
+      a = (a + data[i]) % 65521u;
+      b = (b + a) % 65521u;
+    }
+  return b << 16 | a;
+}
+
+static void
+test_ppm (void)
+{
+  const char *path = "image_writer_test.ppm";
+  check (image_format_from_path (path) == IMAGE_FORMAT_PPM, "ppm format");
+  check (image_write (path, IMAGE_FORMAT_PPM, pixels, WIDTH, HEIGHT, STRIDE)
+                 .code
+             == RESULT_OK,
+         "ppm write");
+
+  static const uint8_t expected[] = { 'P', '6', '\n', '2', ' ', '2', '\n',
+                                      '2', '5', '5', '\n', 255, 0,   0,
+                                      0,   255, 0,   0,   0,   255, 255,
+                                      255, 255 };
+  size_t size = 0;
+  const uint8_t *data = read_file (path, &size);
+  check (data && size == sizeof (expected)
+             && memcmp (data, expected, size) == 0,
+         "ppm bytes");
+}
+
+static void
+test_png (void)
+{
+  const char *path = "image_writer_test.png";
+  check (image_format_from_path (path) == IMAGE_FORMAT_PNG, "png format");
+  check (image_write (path, IMAGE_FORMAT_PNG, pixels, WIDTH, HEIGHT, STRIDE)
+                 .code
+             == RESULT_OK,
+         "png write");
+
+  size_t size = 0;
+  const uint8_t *data = read_file (path, &size);
+  static const uint8_t signature[8]
+      = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  if (!data || size < 8 + 25 + 12 + 12)
+    {
+      check (false, "png size");
+      return;
+    }
+  check (memcmp (data, signature, 8) == 0, "png signature");
+
+  const uint8_t *ihdr = data + 8;
+  check (load_be32 (ihdr) == 13 && memcmp (ihdr + 4, "IHDR", 4) == 0,
+         "png IHDR chunk");
+  check (load_be32 (ihdr + 8) == WIDTH && load_be32 (ihdr + 12) == HEIGHT
+             && ihdr[16] == 8 && ihdr[17] == 2,
+         "png IHDR contents");
+  check (load_be32 (ihdr + 21) == reference_crc32 (ihdr + 4, 17),
+         "png IHDR crc");
+
+  const uint8_t *idat = ihdr + 25;
+  uint32_t idat_size = load_be32 (idat);
+  check (memcmp (idat + 4, "IDAT", 4) == 0, "png IDAT chunk");
+  if (8 + 25 + 12 + (size_t)idat_size + 12 != size)
+    {
+      check (false, "png IDAT size");
+      return;
+    }
+  check (load_be32 (idat + 8 + idat_size)
+             == reference_crc32 (idat + 4, 4 + idat_size),
+         "png IDAT crc");
+
+  /* One stored block holding filter byte 0 plus RGB per row. */
+  static const uint8_t raw[] = { 0, 255, 0, 0, 0, 255, 0,
+                                 0, 0,   0, 255, 255, 255, 255 };
+  const uint8_t *zlib = idat + 8;
+  check (zlib[0] == 0x78 && (zlib[0] * 256 + zlib[1]) % 31 == 0,
+         "png zlib header");
+  check (zlib[2] == 1 && zlib[3] == sizeof (raw) && zlib[4] == 0
+             && zlib[5] == (uint8_t)~sizeof (raw) && zlib[6] == 0xff,
+         "png stored block header");
+  check (idat_size == 2 + 5 + sizeof (raw) + 4
+             && memcmp (zlib + 7, raw, sizeof (raw)) == 0,
+         "png stored block payload");
+  check (load_be32 (zlib + 7 + sizeof (raw))
+             == reference_adler32 (raw, sizeof (raw)),
+         "png adler32");
+
+  const uint8_t *iend = idat + 12 + idat_size;
+  check (load_be32 (iend) == 0 && memcmp (iend + 4, "IEND", 4) == 0
+             && load_be32 (iend + 8) == reference_crc32 (iend + 4, 4),
+         "png IEND chunk");
+}
+
+static void
+test_exr (void)
+{
+  const char *path = "image_writer_test.exr";
+  check (image_format_from_path (path) == IMAGE_FORMAT_EXR, "exr format");
+  check (image_write (path, IMAGE_FORMAT_EXR, pixels, WIDTH, HEIGHT, STRIDE)
+                 .code
+             == RESULT_OK,
+         "exr write");
+
+  size_t size = 0;
+  const uint8_t *data = read_file (path, &size);
+  if (!data || size < 8)
+    {
+      check (false, "exr size");
+      return;
+    }
+  check (data[0] == 0x76 && data[1] == 0x2f && data[2] == 0x31
+             && data[3] == 0x01,
+         "exr magic");
+  check (load_le32 (data + 4) == 2, "exr version");
+
+  /* Walk the attributes up to the terminating empty name. */
+  const uint8_t *chlist = NULL, *data_window = NULL, *compression = NULL;
+  size_t at = 8;
+  while (at < size && data[at] != 0)
+    {
+      const char *name = (const char *)data + at;
+      at += strlen (name) + 1;
+      at += strlen ((const char *)data + at) + 1;
+      uint32_t attribute_size = load_le32 (data + at);
+      at += 4;
+      if (strcmp (name, "channels") == 0)
+        chlist = data + at;
+      else if (strcmp (name, "dataWindow") == 0)
+        data_window = data + at;
+      else if (strcmp (name, "compression") == 0)
+        compression = data + at;
+      at += attribute_size;
+    }
+  at++;
+
+  check (chlist && compression && data_window, "exr required attributes");
+  if (!chlist || !compression || !data_window)
+    return;
+
+  for (int c = 0; c < 3; c++)
+    {
+      const uint8_t *entry = chlist + c * 18;
+      check (entry[0] == (uint8_t)"BGR"[c] && entry[1] == 0
+                 && load_le32 (entry + 2) == 1,
+             "exr half channel in alphabetical order");
+    }
+  check (chlist[3 * 18] == 0, "exr chlist terminator");
+  check (*compression == 0, "exr uncompressed");
+  check (load_le32 (data_window) == 0 && load_le32 (data_window + 4) == 0
+             && load_le32 (data_window + 8) == WIDTH - 1
+             && load_le32 (data_window + 12) == HEIGHT - 1,
+         "exr data window");
+
+  const size_t line_size = 8 + WIDTH * 3 * 2;
+  if (at + HEIGHT * 8 + HEIGHT * line_size != size)
+    {
+      check (false, "exr file size");
+      return;
+    }
+
+  /* B, G, R planes; 255 is 1.0 (0x3c00) and 0 is 0.0 as half. */
+  static const uint16_t expected[HEIGHT][3][WIDTH]
+      = { { { 0, 0 }, { 0, 0x3c00 }, { 0x3c00, 0 } },
+          { { 0x3c00, 0x3c00 }, { 0, 0x3c00 }, { 0, 0x3c00 } } };
+
+  for (uint32_t y = 0; y < HEIGHT; y++)
+    {
+      uint64_t offset = load_le32 (data + at + y * 8)
+                        | (uint64_t)load_le32 (data + at + y * 8 + 4) << 32;
+      check (offset == at + HEIGHT * 8 + y * line_size, "exr line offset");
+      if (offset + line_size > size)
+        return;
+
+      const uint8_t *line = data + offset;
+      check (load_le32 (line) == y
+                 && load_le32 (line + 4) == line_size - 8,
+             "exr line header");
+
+      const uint8_t *half = line + 8;
+      for (int c = 0; c < 3; c++)
+        for (int x = 0; x < WIDTH; x++, half += 2)
+          check ((uint16_t)(half[0] | half[1] << 8) == expected[y][c][x],
+                 "exr pixel");
+    }
+}
+
+int
+main (void)
+{
+  check (image_format_from_path ("frame.bmp") == IMAGE_FORMAT_COUNT,
+         "unknown extension");
+
+  test_ppm ();
+  test_png ();
+  test_exr ();
+  return failures == 0 ? 0 : 1;
+}